@@ -0,0 +1,748 @@
+// Headless timings of the model and renderer hot paths.
+//
+//   chartbenchmark [--format text|json|csv] [--min-time ms] [--filter text]
+//
+// Every case is run repeatedly for at least --min-time after one warm-up
+// call. Allocations are counted by interposing malloc on glibc, which also
+// sees Qt's containers; elsewhere only operator new is counted.
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QPainter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QThread>
+#include <QTextStream>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QRandomGenerator>
+#include <QHostAddress>
+#include <QUdpSocket>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+#include "chartdatamodel.h"
+#include "chartrenderer.h"
+#include "densitymap.h"
+#include "enginesimulator.h"
+#include "nmeaparser.h"
+#include "nmeasimulator.h"
+#include "samplecodec.h"
+#include "statisticsengine.h"
+#include "telemetryingestor.h"
+#include "telemetrysource.h"
+#include "vesselmodel.h"
+
+namespace {
+
+std::atomic<qint64> allocationCount { 0 };
+std::atomic<qint64> allocationBytes { 0 };
+
+void countAllocation(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(qint64(size), std::memory_order_relaxed);
+}
+
+} // namespace
+
+#if defined(__GLIBC__)
+#  define CHARTBENCHMARK_COUNTS_MALLOC 1
+
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *pointer, std::size_t size);
+
+void *malloc(std::size_t size) noexcept
+{
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size) noexcept
+{
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, std::size_t size) noexcept
+{
+    countAllocation(size);
+    return __libc_realloc(pointer, size);
+}
+}
+
+#else
+#  define CHARTBENCHMARK_COUNTS_MALLOC 0
+
+void *operator new(std::size_t size)
+{
+    countAllocation(size);
+    if (void *pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+namespace {
+
+struct Result {
+    QString name;
+    qint64 iterations = 0;
+    double nsPerOp = 0.0;
+    double allocationsPerOp = 0.0;
+    double bytesPerOp = 0.0;
+    double itemsPerSecond = 0.0;    // 0 when the case has no natural item count
+};
+
+class Benchmark
+{
+public:
+    Benchmark(qint64 minTimeMs, const QString &filter)
+        : m_minTimeNs(minTimeMs * 1000000)
+        , m_filter(filter)
+    {
+    }
+
+    // Whether the case called name passes --filter. Setup and checks that
+    // only serve particular cases are skipped when none of them will run.
+    bool wants(const QString &name) const
+    {
+        return m_filter.isEmpty() || name.contains(m_filter);
+    }
+
+    bool wantsAny(const QStringList &names) const
+    {
+        return std::any_of(names.cbegin(), names.cend(), [this](const QString &name) { return wants(name); });
+    }
+
+    // Times op, which processes itemsPerOp items (samples, lookups, ...)
+    template <typename Op>
+    void run(const QString &name, Op &&op, qint64 itemsPerOp = 0)
+    {
+        if (!wants(name))
+            return;
+
+        op();
+
+        // Grow the batch until one timed batch is long enough to measure
+        qint64 batch = 1;
+        for (;;) {
+            QElapsedTimer timer;
+            timer.start();
+            for (qint64 i = 0; i < batch; ++i)
+                op();
+            if (timer.nsecsElapsed() >= m_minTimeNs / 10 || batch >= (qint64(1) << 30))
+                break;
+            batch *= 2;
+        }
+
+        Result result;
+        result.name = name;
+        qint64 elapsedNs = 0;
+        const qint64 allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+        const qint64 bytesBefore = allocationBytes.load(std::memory_order_relaxed);
+        while (elapsedNs < m_minTimeNs) {
+            QElapsedTimer timer;
+            timer.start();
+            for (qint64 i = 0; i < batch; ++i)
+                op();
+            elapsedNs += timer.nsecsElapsed();
+            result.iterations += batch;
+        }
+
+        finish(result, elapsedNs, allocationCount.load(std::memory_order_relaxed) - allocationsBefore,
+               allocationBytes.load(std::memory_order_relaxed) - bytesBefore, itemsPerOp);
+    }
+
+    // Like run(), but calls settle after every op, outside the timing and
+    // allocation counts, e.g. to let another thread finish what op queued.
+    // Each op is timed on its own, so it should take microseconds at least.
+    template <typename Op, typename Settle>
+    void runSettled(const QString &name, Op &&op, Settle &&settle, qint64 itemsPerOp = 0)
+    {
+        if (!wants(name))
+            return;
+
+        op();
+        settle();
+
+        Result result;
+        result.name = name;
+        qint64 elapsedNs = 0;
+        qint64 allocations = 0;
+        qint64 bytes = 0;
+        while (elapsedNs < m_minTimeNs) {
+            const qint64 allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+            const qint64 bytesBefore = allocationBytes.load(std::memory_order_relaxed);
+            QElapsedTimer timer;
+            timer.start();
+            op();
+            elapsedNs += timer.nsecsElapsed();
+            allocations += allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+            bytes += allocationBytes.load(std::memory_order_relaxed) - bytesBefore;
+            ++result.iterations;
+            settle();
+        }
+        finish(result, elapsedNs, allocations, bytes, itemsPerOp);
+    }
+
+    const QList<Result> &results() const { return m_results; }
+
+private:
+    void finish(Result &result, qint64 elapsedNs, qint64 allocations, qint64 bytes, qint64 itemsPerOp)
+    {
+        const double iterations = double(result.iterations);
+        result.nsPerOp = elapsedNs / iterations;
+        result.allocationsPerOp = allocations / iterations;
+        result.bytesPerOp = bytes / iterations;
+        if (itemsPerOp > 0)
+            result.itemsPerSecond = itemsPerOp * 1e9 / result.nsPerOp;
+        m_results.append(result);
+    }
+
+    const qint64 m_minTimeNs;
+    const QString m_filter;
+    QList<Result> m_results;
+};
+
+// Keeps the optimizer from discarding a result
+template <typename T>
+void doNotOptimize(const T &value)
+{
+    static volatile T sink;
+    sink = value;
+}
+
+void benchmarkModel(Benchmark &benchmark, const QList<double> &binWidths)
+{
+    for (double binWidth : binWidths) {
+        BinLayout layout;
+        layout.binWidth = binWidth;
+        const QString suffix = QStringLiteral("/bins:%1").arg(layout.binCount());
+        if (!benchmark.wantsAny({ "model/generateSampleData" + suffix, "model/getDataPoints" + suffix,
+                                  "model/layoutReset" + suffix, "model/interpolateFuelFlow" + suffix,
+                                  "model/interpolateFuelFlowBatch4096" + suffix })) {
+            continue;
+        }
+
+        ChartDataModel model;
+        model.setLayout(layout);
+        model.generateSampleData();
+        model.waitForStatistics();
+
+        // Both resets hand a rebuild to the statistics thread as well. It
+        // is waited for between calls, so the rebuilds neither pile up nor
+        // run alongside the timed model-side reset.
+        auto settle = [&] { model.waitForStatistics(); };
+
+        benchmark.runSettled("model/generateSampleData" + suffix, [&] {
+            model.generateSampleData();
+        }, settle);
+
+        benchmark.run("model/getDataPoints" + suffix, [&] {
+            doNotOptimize(model.getDataPoints().size());
+        });
+
+        // Alternates between two layouts so every call is a full reset
+        BinLayout other = layout;
+        other.maxRpm = layout.maxRpm - binWidth;
+        bool toggle = false;
+        benchmark.runSettled("model/layoutReset" + suffix, [&] {
+            model.setLayout((toggle = !toggle) ? other : layout);
+        }, settle);
+        model.setLayout(layout);
+        model.waitForStatistics();
+
+        // Same pseudo-random RPMs for every run, so results are comparable
+        std::vector<double> rpms(4096);
+        QRandomGenerator generator(42);
+        for (double &rpm : rpms)
+            rpm = generator.bounded(layout.maxRpm);
+        std::vector<double> out(rpms.size());
+
+        qsizetype next = 0;
+        benchmark.run("model/interpolateFuelFlow" + suffix, [&] {
+            doNotOptimize(model.interpolateFuelFlow(rpms[next++ & 4095]));
+        }, 1);
+
+        benchmark.run("model/interpolateFuelFlowBatch4096" + suffix, [&] {
+            model.interpolateFuelFlow(rpms.data(), out.data(), qsizetype(rpms.size()));
+            doNotOptimize(out[0]);
+        }, qint64(rpms.size()));
+    }
+}
+
+void benchmarkRenderer(Benchmark &benchmark, const QList<double> &binWidths, const QList<QSize> &sizes)
+{
+    for (double binWidth : binWidths) {
+        BinLayout layout;
+        layout.binWidth = binWidth;
+        auto caseNames = [&layout](const QSize &size) {
+            const QString suffix = QStringLiteral("/%1x%2/bins:%3")
+                                       .arg(size.width()).arg(size.height()).arg(layout.binCount());
+            return QStringList { "renderer/paintMarker" + suffix, "renderer/paintFull" + suffix,
+                                 "renderer/paintZoomed" + suffix };
+        };
+        QStringList names;
+        for (const QSize &size : sizes)
+            names += caseNames(size);
+        if (!benchmark.wantsAny(names))
+            continue;
+
+        ChartDataModel model;
+        model.setLayout(layout);
+        model.generateSampleData();
+
+        for (const QSize &size : sizes) {
+            const QStringList sizeNames = caseNames(size);
+            if (!benchmark.wantsAny(sizeNames))
+                continue;
+
+            ChartRenderer renderer;
+            renderer.setSize(size);
+            renderer.setModel(&model);
+
+            QImage image(size, QImage::Format_ARGB32_Premultiplied);
+
+            // Only the marker moves, the static layer comes from the cache
+            double rpm = 0.0;
+            benchmark.run(sizeNames.at(0), [&] {
+                renderer.setCurrentRpm(rpm = rpm >= 6000.0 ? 0.0 : rpm + 10.0);
+                QPainter painter(&image);
+                renderer.paint(&painter);
+            });
+
+            // Changing an axis invalidates the cache, so every frame is a full render
+            bool toggle = false;
+            benchmark.run(sizeNames.at(1), [&] {
+                renderer.setMaxFuelFlow((toggle = !toggle) ? 80.5 : 80.0);
+                QPainter painter(&image);
+                renderer.paint(&painter);
+            });
+
+            // Zoomed in on a tenth of the axis, only the bins in view are drawn
+            renderer.setViewRange(1500.0, 2100.0);
+            benchmark.run(sizeNames.at(2), [&] {
+                renderer.setMaxFuelFlow((toggle = !toggle) ? 80.5 : 80.0);
+                QPainter painter(&image);
+                renderer.paint(&painter);
+            });
+            renderer.resetView();
+        }
+    }
+}
+
+void benchmarkDensity(Benchmark &benchmark, const QList<double> &binWidths)
+{
+    for (double binWidth : binWidths) {
+        BinLayout layout;
+        layout.binWidth = binWidth;
+        DensityGrid grid;
+        grid.reset(layout);
+        QRandomGenerator generator(42);
+        for (QList<quint32> &row : grid.rows) {
+            row.resize(DensityGrid::BUCKETS);
+            for (quint32 &count : row)
+                count = generator.bounded(100000);
+        }
+
+        DensityMap map;
+        map.reset(grid);
+        const QString suffix = QStringLiteral("/bins:%1").arg(grid.size());
+
+        // A batch of live samples typically changes a single row
+        int row = 0;
+        benchmark.run("density/updateRow" + suffix, [&] {
+            ++grid.rows[row][DensityGrid::BUCKETS / 2];
+            map.update(grid, row, row);
+            row = (row + 1) % grid.size();
+        });
+
+        // The painted fallback colour-maps every row in view
+        benchmark.run("density/toImage" + suffix, [&] {
+            doNotOptimize(map.toImage(0, map.rows() - 1).width());
+        }, qint64(grid.size()) * DensityGrid::BUCKETS);
+    }
+}
+
+void benchmarkVessel(Benchmark &benchmark, const QSize &size)
+{
+    for (int engineCount : { 1, 2, 3 }) {
+        const QString suffix = QStringLiteral("/%1x%2/engines:%3")
+                                   .arg(size.width()).arg(size.height()).arg(engineCount);
+        if (!benchmark.wantsAny({ "vessel/paintMarker" + suffix, "vessel/paintFull" + suffix }))
+            continue;
+
+        VesselModel vessel(engineCount);
+        for (ChartDataModel *engine : vessel.engines())
+            engine->generateSampleData();
+
+        ChartRenderer renderer;
+        renderer.setSize(size);
+        renderer.setVessel(&vessel);
+
+        QImage image(size, QImage::Format_ARGB32_Premultiplied);
+
+        // The total's marker moves; every series shares the cached layer
+        double rpm = 0.0;
+        benchmark.run("vessel/paintMarker" + suffix, [&] {
+            renderer.setCurrentRpm(rpm = rpm >= 6000.0 ? 0.0 : rpm + 10.0);
+            QPainter painter(&image);
+            renderer.paint(&painter);
+        });
+
+        bool toggle = false;
+        benchmark.run("vessel/paintFull" + suffix, [&] {
+            renderer.setMaxFuelFlow((toggle = !toggle) ? 80.5 : 80.0);
+            QPainter painter(&image);
+            renderer.paint(&painter);
+        });
+    }
+}
+
+void benchmarkCodec(Benchmark &benchmark)
+{
+    constexpr int count = 4096;
+    std::vector<qint64> timestamps(count);
+    std::vector<double> rpm(count);
+    std::vector<double> fuelFlow(count);
+
+    // A plausible trace: 50 Hz with jitter, slowly varying engine speed
+    QRandomGenerator generator(7);
+    qint64 timestamp = 1700000000000;
+    double engineRpm = 1500.0;
+    for (int i = 0; i < count; ++i) {
+        timestamp += 20 + generator.bounded(3) - 1;
+        engineRpm += (generator.generateDouble() - 0.5) * 20.0;
+        timestamps[i] = timestamp;
+        rpm[i] = engineRpm;
+        fuelFlow[i] = ChartDataModel::baseFuelFlow(engineRpm) * (0.85 + generator.generateDouble() * 0.3);
+    }
+
+    // Encoded once up front, so the decode cases do not depend on the
+    // encode case having run. Correctness is covered by tst_samplecodec.
+    QByteArray block;
+    SampleCodec::encodeBlock(block, 0, timestamps.data(), rpm.data(), fuelFlow.data(), count);
+    const auto *header = SampleCodec::blockHeader(reinterpret_cast<const uchar *>(block.constData()),
+                                                  block.size());
+
+    std::vector<qint64> decodedTimestamps(count);
+    std::vector<double> decodedRpm(count);
+    std::vector<double> decodedFuelFlow(count);
+
+    QByteArray scratch;
+    benchmark.run("codec/encode4096", [&] {
+        scratch.clear();
+        SampleCodec::encodeBlock(scratch, 0, timestamps.data(), rpm.data(), fuelFlow.data(), count);
+    }, count);
+
+    benchmark.run("codec/decode4096", [&] {
+        SampleCodec::decodeBlock(header, decodedTimestamps.data(), decodedRpm.data(), decodedFuelFlow.data());
+        doNotOptimize(decodedRpm[count - 1]);
+    }, count);
+
+    benchmark.run("codec/decodeRpmOnly4096", [&] {
+        SampleCodec::decodeBlock(header, nullptr, decodedRpm.data(), nullptr);
+        doNotOptimize(decodedRpm[count - 1]);
+    }, count);
+
+    benchmark.run("codec/roundTrip4096", [&] {
+        scratch.clear();
+        SampleCodec::encodeBlock(scratch, 0, timestamps.data(), rpm.data(), fuelFlow.data(), count);
+        SampleCodec::decodeBlock(SampleCodec::blockHeader(reinterpret_cast<const uchar *>(scratch.constData()),
+                                                          scratch.size()),
+                                 decodedTimestamps.data(), decodedRpm.data(), decodedFuelFlow.data());
+    }, count);
+}
+
+// Digest of a simulator run, combined in stream order so that it does not
+// depend on how the streams were spread over threads. The fields are hashed
+// one by one, as the padding of a TelemetrySample is undefined.
+QByteArray simulationDigest(const SimulationProfile &profile, int streamCount, qint64 samplesPerStream,
+                            int threadCount)
+{
+    std::vector<std::unique_ptr<QCryptographicHash>> hashes;
+    for (int i = 0; i < streamCount; ++i)
+        hashes.push_back(std::make_unique<QCryptographicHash>(QCryptographicHash::Sha256));
+
+    EngineSimulator::run(1234, profile, streamCount, samplesPerStream, threadCount,
+                         [&](int stream, const TelemetrySample *samples, int count) {
+        for (int i = 0; i < count; ++i) {
+            const TelemetrySample &sample = samples[i];
+            const double fields[] = { double(sample.timestampMs), sample.rpm, sample.fuelFlow, sample.speed,
+                                      double(sample.engine) };
+            hashes[stream]->addData(QByteArrayView(reinterpret_cast<const char *>(fields), sizeof(fields)));
+        }
+    });
+
+    QCryptographicHash digest(QCryptographicHash::Sha256);
+    for (const auto &hash : hashes)
+        digest.addData(hash->result());
+    return digest.result();
+}
+
+void benchmarkSimulator(Benchmark &benchmark)
+{
+    constexpr int count = 4096;
+    constexpr int streamCount = 8;
+    constexpr qint64 samplesPerStream = 64 * 1024;
+    const SimulationProfile profile = SimulationProfile::drive();
+
+    // Every stream has its own seed, so spreading the streams over more
+    // threads must not change a single sample
+    const int threadCount = qMax(2, QThread::idealThreadCount());
+    const QString runPrefix = QStringLiteral("simulator/run/threads:");
+    if ((benchmark.wants(runPrefix + '1') || benchmark.wants(runPrefix + QString::number(threadCount)))
+        && simulationDigest(profile, streamCount, samplesPerStream, 1)
+               != simulationDigest(profile, streamCount, samplesPerStream, threadCount))
+        qFatal("chartbenchmark: simulator output depends on the thread count");
+
+    EngineSimulator simulator(1234, profile);
+    std::vector<TelemetrySample> samples(count);
+    benchmark.run("simulator/generate4096", [&] {
+        doNotOptimize(simulator.generate(samples.data(), count));
+    }, count);
+
+    for (int threads : { 1, threadCount }) {
+        std::atomic<qint64> generated { 0 };
+        benchmark.run(runPrefix + QString::number(threads), [&] {
+            EngineSimulator::run(1234, profile, streamCount, samplesPerStream, threads,
+                                 [&](int, const TelemetrySample *, int chunkCount) {
+                generated.fetch_add(chunkCount, std::memory_order_relaxed);
+            });
+        }, streamCount * samplesPerStream);
+        doNotOptimize(generated.load());
+    }
+
+    // The statistics engine lives on this thread here, so ingest() is
+    // timed without the queued call
+    ChartDataModel model;
+    model.generateSampleData();
+    StatisticsEngine statistics(model.lowerPercentile(), model.upperPercentile());
+    statistics.setBaseline(model.bins());
+    EngineSimulator feed(99, profile);
+    std::vector<TelemetrySample> batch(count);
+    benchmark.run("simulator/statistics4096", [&] {
+        batch.resize(feed.generate(batch.data(), count));
+        statistics.ingest(batch);
+        batch.resize(count);
+    }, count);
+}
+
+void benchmarkNmea(Benchmark &benchmark)
+{
+    constexpr int count = 4096;
+    const SimulationProfile profile = SimulationProfile::drive();
+    std::vector<TelemetrySample> samples(count);
+
+    const std::pair<const char *, NmeaSimulator::Format> formats[] = {
+        { "nmea/parse0183", NmeaSimulator::Nmea0183 },
+        { "nmea/parse2000Raw", NmeaSimulator::Nmea2000Raw },
+    };
+    for (const auto &[name, format] : formats) {
+        if (!benchmark.wants(QLatin1String(name)))
+            continue;
+
+        NmeaSimulator traffic;
+        traffic.setCapture(NmeaSimulator::synthesize(profile, 1234, 1, count, format));
+        const QByteArray &capture = traffic.capture();
+
+        NmeaParser parser;
+        if (parser.parse(capture.constData(), capture.size(), 0, samples.data(), count).samples != count)
+            qFatal("chartbenchmark: %s does not parse a sample per RPM reading", name);
+        benchmark.run(QLatin1String(name), [&] {
+            doNotOptimize(parser.parse(capture.constData(), capture.size(), 0, samples.data(), count).samples);
+        }, traffic.lineCount());
+    }
+
+    // From a datagram leaving the socket to every engine's current fuel
+    // flow, including the wait for the next drain of the telemetry rings.
+    // The engines share the gateway, as with --engines.
+    for (const int engineCount : { 1, 2 }) {
+        const QString name = engineCount == 1 ? QStringLiteral("nmea/latencyUdp")
+                                              : QStringLiteral("nmea/latencyUdp%1Engines").arg(engineCount);
+        if (!benchmark.wants(name))
+            continue;
+
+        QUdpSocket probe;
+        probe.bind(QHostAddress(QHostAddress::LocalHost), 0);
+        const quint16 port = probe.localPort();
+        probe.close();
+
+        std::vector<std::unique_ptr<ChartDataModel>> models;
+        QList<ChartDataModel *> engines;
+        for (int engine = 0; engine < engineCount; ++engine) {
+            models.push_back(std::make_unique<ChartDataModel>());
+            models.back()->generateSampleData();
+            engines.append(models.back().get());
+        }
+        TelemetryIngestor ingestor(engines);
+        ingestor.start(std::make_unique<NmeaTelemetrySource>(
+            QUrl(QStringLiteral("udp://127.0.0.1:%1").arg(port)), 0, engineCount));
+
+        QUdpSocket gateway;
+        QByteArray sentences;
+        int reading = 0;
+        benchmark.run(name, [&] {
+            // Alternating readings, so that every one changes the fuel flow
+            const double fuelFlow = 10.0 + (++reading % 2);
+            sentences.clear();
+            for (int engine = 0; engine < engineCount; ++engine) {
+                NmeaSimulator::appendSentence(sentences, "ERXDR,R," + QByteArray::number(fuelFlow / 3600.0, 'f', 7)
+                                                         + ",l,FUELRATE#" + QByteArray::number(engine));
+                NmeaSimulator::appendSentence(sentences, "ERRPM,E," + QByteArray::number(engine) + ",1500.0,,A");
+            }
+            auto arrived = [&] {
+                for (const auto &model : models) {
+                    if (qAbs(model->currentFuelFlow() - fuelFlow) > 0.01)
+                        return false;
+                }
+                return true;
+            };
+
+            // Resent while the source may not have bound its socket yet
+            QElapsedTimer timer;
+            timer.start();
+            qint64 sentAtMs = -1;
+            while (!arrived()) {
+                if (sentAtMs < 0 || timer.elapsed() - sentAtMs > 250) {
+                    gateway.writeDatagram(sentences, QHostAddress(QHostAddress::LocalHost), port);
+                    sentAtMs = timer.elapsed();
+                }
+                if (timer.elapsed() > 10000)
+                    qFatal("chartbenchmark: no NMEA reading arrived over UDP for every engine");
+                QCoreApplication::processEvents(QEventLoop::AllEvents, 1);
+            }
+        });
+        ingestor.stop();
+    }
+}
+
+void writeText(QTextStream &out, const QList<Result> &results)
+{
+    out << QStringLiteral("%1 %2 %3 %4 %5 %6\n")
+               .arg(QStringLiteral("benchmark"), -52).arg(QStringLiteral("iterations"), 12)
+               .arg(QStringLiteral("ns/op"), 14).arg(QStringLiteral("allocs/op"), 10)
+               .arg(QStringLiteral("bytes/op"), 12).arg(QStringLiteral("items/s"), 14);
+    for (const Result &result : results) {
+        out << QStringLiteral("%1 %2 %3 %4 %5 %6\n")
+                   .arg(result.name, -52)
+                   .arg(result.iterations, 12)
+                   .arg(result.nsPerOp, 14, 'f', 1)
+                   .arg(result.allocationsPerOp, 10, 'f', 2)
+                   .arg(result.bytesPerOp, 12, 'f', 0)
+                   .arg(result.itemsPerSecond > 0 ? QString::number(result.itemsPerSecond, 'g', 4) : QStringLiteral("-"), 14);
+    }
+}
+
+void writeCsv(QTextStream &out, const QList<Result> &results)
+{
+    out << "benchmark,iterations,ns_per_op,allocations_per_op,bytes_per_op,items_per_second\n";
+    for (const Result &result : results) {
+        out << result.name << ',' << result.iterations << ','
+            << QString::number(result.nsPerOp, 'f', 3) << ','
+            << QString::number(result.allocationsPerOp, 'f', 3) << ','
+            << QString::number(result.bytesPerOp, 'f', 1) << ','
+            << QString::number(result.itemsPerSecond, 'f', 0) << '\n';
+    }
+}
+
+void writeJson(QTextStream &out, const QList<Result> &results)
+{
+    QJsonArray benchmarks;
+    for (const Result &result : results) {
+        benchmarks.append(QJsonObject {
+            { "name", result.name },
+            { "iterations", result.iterations },
+            { "ns_per_op", result.nsPerOp },
+            { "allocations_per_op", result.allocationsPerOp },
+            { "bytes_per_op", result.bytesPerOp },
+            { "items_per_second", result.itemsPerSecond },
+        });
+    }
+
+    const QJsonObject context {
+        { "version", QCoreApplication::applicationVersion() },
+        { "qt_version", QString::fromLatin1(qVersion()) },
+        { "cpu_architecture", QSysInfo::currentCpuArchitecture() },
+        { "kernel", QSysInfo::kernelType() + ' ' + QSysInfo::kernelVersion() },
+        { "timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODate) },
+        { "allocation_counter", CHARTBENCHMARK_COUNTS_MALLOC ? "malloc" : "operator new" },
+    };
+
+    out << QJsonDocument(QJsonObject { { "context", context }, { "benchmarks", benchmarks } })
+               .toJson(QJsonDocument::Indented);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // Painting needs a QGuiApplication, but never a display
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName("chartbenchmark");
+    QCoreApplication::setApplicationVersion(QStringLiteral("1.0.0"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless benchmarks of the chart model and renderer.");
+    parser.addHelpOption();
+    QCommandLineOption formatOption("format", "Output format: text, json or csv.", "format", "text");
+    QCommandLineOption minTimeOption("min-time", "Minimum measured time per case in ms (default 200).",
+                                     "ms", "200");
+    QCommandLineOption filterOption("filter", "Only run cases whose name contains text.", "text");
+    parser.addOption(formatOption);
+    parser.addOption(minTimeOption);
+    parser.addOption(filterOption);
+    parser.process(app);
+
+    const QString format = parser.value(formatOption);
+    if (format != "text" && format != "json" && format != "csv") {
+        qCritical("chartbenchmark: unknown format %s", qPrintable(format));
+        return 1;
+    }
+
+    Benchmark benchmark(qMax(1, parser.value(minTimeOption).toInt()), parser.value(filterOption));
+
+    // 61, 121, 601 and 6001 bins on the default 0-6000 RPM axis
+    const QList<double> binWidths { 100.0, 50.0, 10.0, 1.0 };
+    const QList<QSize> sizes { QSize(400, 300), QSize(800, 600), QSize(1920, 1080) };
+
+    benchmarkModel(benchmark, binWidths);
+    benchmarkRenderer(benchmark, binWidths, sizes);
+    benchmarkDensity(benchmark, binWidths);
+    benchmarkVessel(benchmark, sizes.value(1, sizes.first()));
+    benchmarkCodec(benchmark);
+    benchmarkSimulator(benchmark);
+    benchmarkNmea(benchmark);
+
+    QTextStream out(stdout);
+    if (format == "json")
+        writeJson(out, benchmark.results());
+    else if (format == "csv")
+        writeCsv(out, benchmark.results());
+    else
+        writeText(out, benchmark.results());
+    return 0;
+}
@@ -4,24 +4,23 @@ import BoatPerformanceChart 1.0
 Item {
     id: root
 
+    property alias showDensity: chartRenderer.showDensity
+
     ChartRenderer {
         id: chartRenderer
         anchors.fill: parent
         
-        dataPoints: chartDataModel ? chartDataModel.getDataPoints() : []
-        currentRpm: chartDataModel ? chartDataModel.currentRpm : 0
-        currentFuelFlow: chartDataModel ? chartDataModel.currentFuelFlow : 0
-        isEcoMode: chartDataModel ? chartDataModel.isEcoMode : false
+        // The live readings are taken from the models once per frame. The
+        // vessel overlays every engine and their total, so the fuel flow
+        // axis has to fit the total.
+        model: chartDataModel
+        vessel: vesselModel
+        reference: fleetModel
         minRpm: chartDataModel ? chartDataModel.minRpm : 0
         maxRpm: chartDataModel ? chartDataModel.maxRpm : 6000
         minFuelFlow: chartDataModel ? chartDataModel.minFuelFlow : 0
-        maxFuelFlow: chartDataModel ? chartDataModel.maxFuelFlow : 50
-
-        Connections {
-            target: chartDataModel
-            function onDataChanged() {
-                chartRenderer.dataPoints = chartDataModel.getDataPoints()
-            }
-        }
+        maxFuelFlow: (chartDataModel ? chartDataModel.maxFuelFlow : 80) * (vesselModel ? vesselModel.engineCount : 1)
+        showMetrics: showMetricsOverlay
+        maxFps: chartMaxFps
     }
 }
@@ -36,6 +36,7 @@ ApplicationWindow {
             radius: 8
 
             PerformanceChart {
+                id: performanceChart
                 anchors.fill: parent
                 anchors.margins: 10
             }
@@ -58,13 +59,21 @@ ApplicationWindow {
                     Slider {
                         id: rpmSlider
                         Layout.fillWidth: true
-                        from: 0
-                        to: 6000
+                        // A replayed trip drives the engines itself
+                        enabled: !tripReplay
+                        from: chartDataModel.minRpm
+                        to: chartDataModel.maxRpm
                         value: 1500
-                        stepSize: 50
+                        stepSize: chartDataModel.binWidth
 
                         onValueChanged: {
-                            chartDataModel.currentRpm = value
+                            // With live telemetry the slider acts as the throttle
+                            if (telemetryIngestor) {
+                                telemetryIngestor.targetRpm = value
+                            } else {
+                                for (var i = 0; i < vesselModel.engineCount; ++i)
+                                    vesselModel.engine(i).currentRpm = value
+                            }
                         }
                     }
 
@@ -73,22 +82,119 @@ ApplicationWindow {
                         font.pixelSize: 16
                         font.bold: true
                     }
+
+                    // Speed over ground, for when no telemetry reports it
+                    Slider {
+                        id: speedSlider
+                        Layout.fillWidth: true
+                        enabled: !telemetryIngestor && !tripReplay
+                        from: 0
+                        to: 40
+                        stepSize: 0.5
+
+                        onValueChanged: {
+                            for (var i = 0; i < vesselModel.engineCount; ++i)
+                                vesselModel.engine(i).currentSpeed = value
+                        }
+                    }
+
+                    Text {
+                        text: "Speed: " + chartDataModel.currentSpeed.toFixed(1) + " kn"
+                        font.pixelSize: 14
+                    }
+
+                    RowLayout {
+                        Layout.fillWidth: true
+                        spacing: 8
+
+                        Text {
+                            text: "Fuel on board (L):"
+                            font.pixelSize: 14
+                        }
+
+                        // The vessel's range is taken on the whole tank
+                        SpinBox {
+                            Layout.fillWidth: true
+                            from: 0
+                            to: 20000
+                            stepSize: 10
+                            editable: true
+                            onValueModified: vesselModel.remainingFuel = value
+                        }
+                    }
                     
                     // Compact current fuel flow display
                     Rectangle {
                         Layout.fillWidth: true
                         Layout.preferredHeight: 35
-                        color: chartDataModel.isEcoMode ? "#d5f4e6" : "#fdeaa7"
-                        border.color: chartDataModel.isEcoMode ? "#27ae60" : "#f39c12"
+                        color: vesselModel.isTotalEcoMode ? "#d5f4e6" : "#fdeaa7"
+                        border.color: vesselModel.isTotalEcoMode ? "#27ae60" : "#f39c12"
                         border.width: 1
                         radius: 6
                         
                         Text {
                             anchors.centerIn: parent
-                            text: "Fuel: " + chartDataModel.currentFuelFlow.toFixed(1) + " L/h"
+                            text: "Fuel: " + vesselModel.totalFuelFlow.toFixed(1) + " L/h"
                             font.pixelSize: 14
                             font.bold: true
-                            color: chartDataModel.isEcoMode ? "#27ae60" : "#f39c12"
+                            color: vesselModel.isTotalEcoMode ? "#27ae60" : "#f39c12"
+                        }
+                    }
+                }
+            }
+
+            // Trip Replay
+            GroupBox {
+                title: "Trip Replay"
+                Layout.preferredWidth: 360
+                visible: tripReplay !== null
+
+                ColumnLayout {
+                    anchors.fill: parent
+                    spacing: 8
+
+                    Slider {
+                        id: replaySlider
+                        Layout.fillWidth: true
+                        from: tripReplay ? tripReplay.startTime : 0
+                        to: tripReplay ? tripReplay.endTime : 1
+
+                        // Seek once the handle is released, not on every step
+                        onPressedChanged: {
+                            if (!pressed)
+                                tripReplay.seek(value)
+                        }
+                    }
+
+                    // Follow playback unless the handle is being dragged
+                    Connections {
+                        target: tripReplay
+                        function onPositionChanged() {
+                            if (!replaySlider.pressed)
+                                replaySlider.value = tripReplay.position
+                        }
+                    }
+
+                    Text {
+                        text: Qt.formatDateTime(new Date(replaySlider.value), "yyyy-MM-dd hh:mm:ss")
+                        font.pixelSize: 16
+                        font.bold: true
+                    }
+
+                    RowLayout {
+                        Layout.fillWidth: true
+                        spacing: 8
+
+                        Button {
+                            Layout.fillWidth: true
+                            text: tripReplay && tripReplay.playing ? "Pause" : "Play"
+                            onClicked: tripReplay.playing ? tripReplay.pause() : tripReplay.play()
+                        }
+
+                        ComboBox {
+                            Layout.preferredWidth: 90
+                            model: ["1x", "2x", "5x", "10x", "25x", "50x", "100x"]
+                            onActivated: function(index) { tripReplay.speed = parseInt(model[index]) }
                         }
                     }
                 }
@@ -110,10 +216,10 @@ ApplicationWindow {
                         font.pixelSize: 14
                     }
                     Text {
-                        text: chartDataModel.currentFuelFlow.toFixed(1) + " L/h"
+                        text: vesselModel.totalFuelFlow.toFixed(1) + " L/h"
                         font.pixelSize: 14
                         font.bold: true
-                        color: chartDataModel.isEcoMode ? "#27ae60" : "#f39c12"
+                        color: vesselModel.isTotalEcoMode ? "#27ae60" : "#f39c12"
                     }
 
                     Text {
@@ -121,10 +227,10 @@ ApplicationWindow {
                         font.pixelSize: 14
                     }
                     Text {
-                        text: chartDataModel.isEcoMode ? "ECO" : "NORMAL"
+                        text: vesselModel.isTotalEcoMode ? "ECO" : "NORMAL"
                         font.pixelSize: 14
                         font.bold: true
-                        color: chartDataModel.isEcoMode ? "#27ae60" : "#f39c12"
+                        color: vesselModel.isTotalEcoMode ? "#27ae60" : "#f39c12"
                     }
 
                     Text {
@@ -132,10 +238,38 @@ ApplicationWindow {
                         font.pixelSize: 14
                     }
                     Text {
-                        text: chartDataModel.isEcoMode ? "Above Average" : "Below Average"
+                        text: vesselModel.isTotalEcoMode ? "Above Average" : "Below Average"
                         font.pixelSize: 14
                         font.bold: true
-                        color: chartDataModel.isEcoMode ? "#27ae60" : "#e74c3c"
+                        color: vesselModel.isTotalEcoMode ? "#27ae60" : "#e74c3c"
+                    }
+
+                    Text {
+                        text: "Economy:"
+                        font.pixelSize: 14
+                    }
+                    Text {
+                        text: vesselModel.fuelPerNauticalMile > 0
+                              ? vesselModel.fuelPerNauticalMile.toFixed(2) + " L/NM, "
+                                + Math.round(vesselModel.range) + " NM range"
+                              : "-"
+                        font.pixelSize: 14
+                        font.bold: true
+                    }
+
+                    Text {
+                        text: "Best Cruise:"
+                        font.pixelSize: 14
+                    }
+                    Text {
+                        text: vesselModel.optimalRpm > 0
+                              ? Math.round(vesselModel.optimalRpm) + " RPM, "
+                                + vesselModel.optimalFuelPerNauticalMile.toFixed(2) + " L/NM, "
+                                + Math.round(vesselModel.optimalRange) + " NM range"
+                              : "-"
+                        font.pixelSize: 14
+                        font.bold: true
+                        color: "#27ae60"
                     }
                 }
             }
@@ -148,7 +282,10 @@ ApplicationWindow {
                 Button {
                     Layout.fillWidth: true
                     text: "Generate New Data"
-                    onClicked: chartDataModel.generateSampleData()
+                    onClicked: {
+                        for (var i = 0; i < vesselModel.engineCount; ++i)
+                            vesselModel.engine(i).generateSampleData()
+                    }
                 }
 
                 Button {
@@ -156,6 +293,24 @@ ApplicationWindow {
                     text: "Reset RPM"
                     onClicked: rpmSlider.value = 1500
                 }
+
+                // Envelope and eco mode over all of the history or a recent window
+                ComboBox {
+                    Layout.fillWidth: true
+                    model: ["All time", "Last hour", "Last day", "Season"]
+                    currentIndex: chartDataModel.statisticsWindow
+                    onActivated: function(index) {
+                        for (var i = 0; i < vesselModel.engineCount; ++i)
+                            vesselModel.engine(i).statisticsWindow = index
+                    }
+                }
+
+                // Where the samples of each bin cluster, instead of their range
+                CheckBox {
+                    text: "Sample density"
+                    checked: performanceChart.showDensity
+                    onToggled: performanceChart.showDensity = checked
+                }
             }
         }
 
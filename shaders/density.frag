@@ -0,0 +1,29 @@
+#version 440
+
+layout(location = 0) in vec2 levelCoord;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 qt_Matrix;
+    float qt_Opacity;
+    float maxLevel;
+};
+
+layout(binding = 1) uniform sampler2D levels;
+layout(binding = 2) uniform sampler2D palette;
+
+// Same stretch as DensityMap: level 1 takes the first colour, maxLevel the
+// last one, and level 0 stays transparent
+void main()
+{
+    float level = floor(texture(levels, levelCoord).r * 255.0 + 0.5);
+    if (level < 1.0) {
+        fragColor = vec4(0.0);
+        return;
+    }
+
+    float t = maxLevel > 1.0 ? clamp((level - 1.0) / (maxLevel - 1.0), 0.0, 1.0) : 1.0;
+    float index = 1.0 + floor(t * 254.0 + 0.5);
+    fragColor = texture(palette, vec2((index + 0.5) / 256.0, 0.5)) * qt_Opacity;
+}
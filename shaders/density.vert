@@ -0,0 +1,18 @@
+#version 440
+
+layout(location = 0) in vec4 vertex;
+layout(location = 1) in vec2 cellCoord;
+
+layout(location = 0) out vec2 levelCoord;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 qt_Matrix;
+    float qt_Opacity;
+    float maxLevel;
+};
+
+void main()
+{
+    levelCoord = cellCoord;
+    gl_Position = qt_Matrix * vertex;
+}
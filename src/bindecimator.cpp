@@ -0,0 +1,116 @@
+#include "bindecimator.h"
+
+bool BinDecimator::isNeeded(const BinLayout &layout, double viewMinRpm, double viewMaxRpm, int columns)
+{
+    return columns > 0 && viewMaxRpm > viewMinRpm && layout.binWidth < (viewMaxRpm - viewMinRpm) / columns;
+}
+
+void BinDecimator::update(const BinStore &bins, int first, int last, quint64 version,
+                          double viewMinRpm, double viewMaxRpm, int columns)
+{
+    last = qMin(last, bins.size() - 1);
+    first = qMax(0, first);
+    if (m_columns == columns && m_version == version && m_viewMinRpm == viewMinRpm
+        && m_viewMaxRpm == viewMaxRpm && m_first == first && m_last == last) {
+        return;
+    }
+
+    clear();
+    m_version = version;
+    m_viewMinRpm = viewMinRpm;
+    m_viewMaxRpm = viewMaxRpm;
+    m_columns = columns;
+    m_first = first;
+    m_last = last;
+    if (columns <= 0 || last < first || !(viewMaxRpm > viewMinRpm))
+        return;
+
+    m_columnWidth = (viewMaxRpm - viewMinRpm) / columns;
+    const double *rpms = bins.rpm.constData();
+    const double *minFlows = bins.minFuelFlow.constData();
+    const double *maxFlows = bins.maxFuelFlow.constData();
+
+    // Rows are in RPM order, so each column's bins are consecutive. Bins
+    // just outside the view are merged into the outermost columns.
+    int column = -1;
+    for (int i = first; i <= last; ++i) {
+        const int binColumn = qBound(0, int(std::floor((rpms[i] - viewMinRpm) / m_columnWidth)), columns - 1);
+        if (binColumn != column) {
+            column = binColumn;
+            m_rpm.append(viewMinRpm + (column + 0.5) * m_columnWidth);
+            m_minFuelFlow.append(minFlows[i]);
+            m_maxFuelFlow.append(maxFlows[i]);
+            continue;
+        }
+        m_minFuelFlow.last() = qMin(m_minFuelFlow.last(), minFlows[i]);
+        m_maxFuelFlow.last() = qMax(m_maxFuelFlow.last(), maxFlows[i]);
+    }
+
+    decimateMedian(rpms + first, bins.medianFuelFlow.constData() + first, last - first + 1, columns);
+}
+
+void BinDecimator::clear()
+{
+    m_columns = 0;
+    m_columnWidth = 0.0;
+    m_rpm.clear();
+    m_minFuelFlow.clear();
+    m_maxFuelFlow.clear();
+    m_medianRpm.clear();
+    m_medianFuelFlow.clear();
+}
+
+void BinDecimator::decimateMedian(const double *rpms, const double *medians, int count, int threshold)
+{
+    if (threshold < 3 || count <= threshold) {
+        m_medianRpm = QList<double>(rpms, rpms + count);
+        m_medianFuelFlow = QList<double>(medians, medians + count);
+        return;
+    }
+
+    m_medianRpm.reserve(threshold);
+    m_medianFuelFlow.reserve(threshold);
+
+    // The end points are kept; the points in between are split into
+    // threshold - 2 buckets, and each bucket keeps the point that spans
+    // the largest triangle with the point kept before it and the average
+    // of the next bucket
+    const double bucketSize = double(count - 2) / (threshold - 2);
+    int previous = 0;
+    m_medianRpm.append(rpms[0]);
+    m_medianFuelFlow.append(medians[0]);
+
+    for (int bucket = 0; bucket < threshold - 2; ++bucket) {
+        const int start = int(bucket * bucketSize) + 1;
+        const int end = qMin(int((bucket + 1) * bucketSize) + 1, count - 1);
+        const int nextEnd = qMin(int((bucket + 2) * bucketSize) + 1, count);
+
+        double averageRpm = 0.0;
+        double averageMedian = 0.0;
+        for (int i = end; i < nextEnd; ++i) {
+            averageRpm += rpms[i];
+            averageMedian += medians[i];
+        }
+        const int nextCount = qMax(1, nextEnd - end);
+        averageRpm /= nextCount;
+        averageMedian /= nextCount;
+
+        int chosen = start;
+        double largestArea = -1.0;
+        for (int i = start; i < end; ++i) {
+            const double area = std::abs((rpms[previous] - averageRpm) * (medians[i] - medians[previous])
+                                         - (rpms[previous] - rpms[i]) * (averageMedian - medians[previous]));
+            if (area > largestArea) {
+                largestArea = area;
+                chosen = i;
+            }
+        }
+
+        m_medianRpm.append(rpms[chosen]);
+        m_medianFuelFlow.append(medians[chosen]);
+        previous = chosen;
+    }
+
+    m_medianRpm.append(rpms[count - 1]);
+    m_medianFuelFlow.append(medians[count - 1]);
+}
@@ -0,0 +1,59 @@
+#ifndef BINDECIMATOR_H
+#define BINDECIMATOR_H
+
+#include <QList>
+#include "binstore.h"
+
+// Level of detail for drawing more bins than there are pixel columns. The
+// envelopes of the bins that fall into one column are merged into
+// min-of-min and max-of-max, so no extreme is lost, and the median is
+// thinned to one point per column with Largest-Triangle-Three-Buckets
+// (Steinarsson, 2013), which keeps its peaks and dips. Drawing the result
+// is bounded by the chart width instead of the bin count.
+//
+// The result is cached for one view range, width and version of the bins;
+// update() with the same arguments is free.
+class BinDecimator
+{
+public:
+    // True when the bins are narrower than a column, so decimating pays off
+    static bool isNeeded(const BinLayout &layout, double viewMinRpm, double viewMaxRpm, int columns);
+
+    // Reduces rows first..last of bins to columns equal parts of
+    // viewMinRpm..viewMaxRpm. version identifies the contents of bins.
+    void update(const BinStore &bins, int first, int last, quint64 version,
+                double viewMinRpm, double viewMaxRpm, int columns);
+    void clear();
+
+    // One merged envelope per column that holds bins, centred on rpm and
+    // columnWidth() RPM wide
+    int envelopeCount() const { return int(m_rpm.size()); }
+    double columnWidth() const { return m_columnWidth; }
+    const QList<double> &rpm() const { return m_rpm; }
+    const QList<double> &minFuelFlow() const { return m_minFuelFlow; }
+    const QList<double> &maxFuelFlow() const { return m_maxFuelFlow; }
+
+    // Points of the decimated median line, a subset of the bins' own
+    int medianCount() const { return int(m_medianRpm.size()); }
+    const QList<double> &medianRpm() const { return m_medianRpm; }
+    const QList<double> &medianFuelFlow() const { return m_medianFuelFlow; }
+
+private:
+    void decimateMedian(const double *rpms, const double *medians, int count, int threshold);
+
+    quint64 m_version = 0;
+    double m_viewMinRpm = 0.0;
+    double m_viewMaxRpm = 0.0;
+    int m_columns = 0;                  // 0 while nothing is cached
+    int m_first = 0;
+    int m_last = -1;
+
+    double m_columnWidth = 0.0;
+    QList<double> m_rpm;
+    QList<double> m_minFuelFlow;
+    QList<double> m_maxFuelFlow;
+    QList<double> m_medianRpm;
+    QList<double> m_medianFuelFlow;
+};
+
+#endif // BINDECIMATOR_H
@@ -0,0 +1,67 @@
+#include "bininterpolator.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define BININTERPOLATOR_SSE2
+#endif
+
+BinInterpolator::BinInterpolator(const BinLayout &layout, const QList<double> &values)
+    : m_origin(layout.minRpm)
+    , m_scale(layout.binWidth > 0.0 ? 1.0 / layout.binWidth : 0.0)
+    , m_values(values.constData())
+    , m_count(values.size())
+{
+}
+
+double BinInterpolator::value(double rpm) const
+{
+    if (m_count < 2)
+        return m_count == 1 ? m_values[0] : 0.0;
+
+    // qBound maps NaN to 0, so the index is always in range. The last bin
+    // is reached as index count - 2 with a fraction of 1.
+    const double position = qBound(0.0, (rpm - m_origin) * m_scale, double(m_count - 1));
+    const qsizetype index = qMin(qsizetype(position), m_count - 2);
+    const double fraction = position - double(index);
+    return m_values[index] + fraction * (m_values[index + 1] - m_values[index]);
+}
+
+void BinInterpolator::values(const double *rpms, double *out, qsizetype count) const
+{
+    if (m_count < 2) {
+        std::fill(out, out + count, m_count == 1 ? m_values[0] : 0.0);
+        return;
+    }
+
+    qsizetype i = 0;
+
+#ifdef BININTERPOLATOR_SSE2
+    const __m128d origin = _mm_set1_pd(m_origin);
+    const __m128d scale = _mm_set1_pd(m_scale);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d last = _mm_set1_pd(double(m_count - 1));
+    const __m128d lastIndex = _mm_set1_pd(double(m_count - 2));
+
+    for (; i + 2 <= count; i += 2) {
+        // maxpd returns its second operand for NaN, which keeps the
+        // indices in range just like the scalar path
+        __m128d position = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(rpms + i), origin), scale);
+        position = _mm_min_pd(_mm_max_pd(position, zero), last);
+
+        const __m128i index = _mm_cvttpd_epi32(_mm_min_pd(position, lastIndex));
+        const __m128d fraction = _mm_sub_pd(position, _mm_cvtepi32_pd(index));
+
+        // SSE2 has no gather; the four neighbours are loaded individually
+        const int i0 = _mm_cvtsi128_si32(index);
+        const int i1 = _mm_cvtsi128_si32(_mm_shuffle_epi32(index, _MM_SHUFFLE(1, 1, 1, 1)));
+        const __m128d lower = _mm_set_pd(m_values[i1], m_values[i0]);
+        const __m128d upper = _mm_set_pd(m_values[i1 + 1], m_values[i0 + 1]);
+
+        _mm_storeu_pd(out + i, _mm_add_pd(lower, _mm_mul_pd(fraction, _mm_sub_pd(upper, lower))));
+    }
+#endif
+
+    for (; i < count; ++i)
+        out[i] = value(rpms[i]);
+}
@@ -0,0 +1,35 @@
+#ifndef BININTERPOLATOR_H
+#define BININTERPOLATOR_H
+
+#include <QList>
+#include "binstore.h"
+
+// Piecewise-linear lookup into one column of a BinStore. Bins sit on the
+// layout's uniform grid, so a lookup is a direct index instead of a search.
+// RPM values outside the layout clamp to the first or last bin.
+//
+// The interpolator only points at the column's data; it must not outlive
+// the QList it was built from, nor be used after that list is modified.
+class BinInterpolator
+{
+public:
+    BinInterpolator() = default;
+    BinInterpolator(const BinLayout &layout, const QList<double> &values);
+
+    bool isEmpty() const { return m_count == 0; }
+
+    // O(1) scalar lookup; 0 when there are no bins
+    double value(double rpm) const;
+
+    // Evaluates count RPM values at once, two per SSE2 instruction where
+    // available. out may alias rpms.
+    void values(const double *rpms, double *out, qsizetype count) const;
+
+private:
+    double m_origin = 0.0;      // RPM of the first bin
+    double m_scale = 0.0;       // Bins per RPM
+    const double *m_values = nullptr;
+    qsizetype m_count = 0;
+};
+
+#endif // BININTERPOLATOR_H
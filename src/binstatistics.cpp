@@ -0,0 +1,115 @@
+#include "binstatistics.h"
+#include "histogramquantile.h"
+#include <QDataStream>
+
+static_assert(WindowedQuantiles::BUCKETS == DensityGrid::BUCKETS,
+              "window histograms are published as density rows");
+
+BinStatistics::BinStatistics(double lowerPercentile, double upperPercentile,
+                             double minFuelFlow, double maxFuelFlow)
+    : m_lowerPercentile(lowerPercentile)
+    , m_upperPercentile(upperPercentile)
+    , m_minFuelFlow(minFuelFlow)
+    , m_maxFuelFlow(qMax(maxFuelFlow, minFuelFlow + 1e-9))
+    , m_lower(lowerPercentile)
+    , m_median(0.5)
+    , m_upper(upperPercentile)
+    , m_windows { WindowedQuantiles(windowMs(LastHourWindow), minFuelFlow, maxFuelFlow),
+                  WindowedQuantiles(windowMs(LastDayWindow), minFuelFlow, maxFuelFlow),
+                  WindowedQuantiles(windowMs(SeasonWindow), minFuelFlow, maxFuelFlow) }
+{
+}
+
+void BinStatistics::add(qint64 timestampMs, double fuelFlow)
+{
+    m_lower.add(fuelFlow);
+    m_median.add(fuelFlow);
+    m_upper.add(fuelFlow);
+    for (WindowedQuantiles &window : m_windows)
+        window.add(timestampMs, fuelFlow);
+
+    if (!qIsFinite(fuelFlow))
+        return;
+    if (m_histogram.isEmpty())
+        m_histogram.fill(0, DensityGrid::BUCKETS);
+    ++m_histogram[HistogramQuantile::bucket(fuelFlow, m_minFuelFlow, m_maxFuelFlow, DensityGrid::BUCKETS)];
+}
+
+void BinStatistics::advance(qint64 timestampMs)
+{
+    for (WindowedQuantiles &window : m_windows)
+        window.advance(timestampMs);
+}
+
+void BinStatistics::reset()
+{
+    m_lower.reset();
+    m_median.reset();
+    m_upper.reset();
+    for (WindowedQuantiles &window : m_windows)
+        window.reset();
+    m_histogram.clear();
+}
+
+qint64 BinStatistics::count(StatisticsWindow window) const
+{
+    return window == AllTimeWindow ? m_median.count() : m_windows[window - 1].count();
+}
+
+double BinStatistics::lower(StatisticsWindow window) const
+{
+    return window == AllTimeWindow ? m_lower.value() : m_windows[window - 1].quantile(m_lowerPercentile);
+}
+
+double BinStatistics::median(StatisticsWindow window) const
+{
+    return window == AllTimeWindow ? m_median.value() : m_windows[window - 1].quantile(0.5);
+}
+
+double BinStatistics::upper(StatisticsWindow window) const
+{
+    return window == AllTimeWindow ? m_upper.value() : m_windows[window - 1].quantile(m_upperPercentile);
+}
+
+const QList<quint32> &BinStatistics::histogram(StatisticsWindow window) const
+{
+    return window == AllTimeWindow ? m_histogram : m_windows[window - 1].histogram();
+}
+
+qint64 BinStatistics::windowMs(StatisticsWindow window)
+{
+    constexpr qint64 hour = 3600 * 1000;
+    switch (window) {
+    case LastHourWindow:
+        return hour;
+    case LastDayWindow:
+        return 24 * hour;
+    case SeasonWindow:
+        return 90 * 24 * hour;
+    default:
+        return 0;
+    }
+}
+
+QDataStream &operator<<(QDataStream &stream, const BinStatistics &statistics)
+{
+    stream << statistics.m_lower << statistics.m_median << statistics.m_upper;
+    for (const WindowedQuantiles &window : statistics.m_windows)
+        stream << window;
+    return stream << statistics.m_minFuelFlow << statistics.m_maxFuelFlow << statistics.m_histogram;
+}
+
+QDataStream &operator>>(QDataStream &stream, BinStatistics &statistics)
+{
+    stream >> statistics.m_lower >> statistics.m_median >> statistics.m_upper;
+    for (WindowedQuantiles &window : statistics.m_windows)
+        stream >> window;
+    stream >> statistics.m_minFuelFlow >> statistics.m_maxFuelFlow >> statistics.m_histogram;
+    if (!(statistics.m_maxFuelFlow > statistics.m_minFuelFlow)
+        || (!statistics.m_histogram.isEmpty() && statistics.m_histogram.size() != DensityGrid::BUCKETS)) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+    }
+    statistics.m_lowerPercentile = statistics.m_lower.probability();
+    statistics.m_upperPercentile = statistics.m_upper.probability();
+    return stream;
+}
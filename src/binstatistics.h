@@ -0,0 +1,52 @@
+#ifndef BINSTATISTICS_H
+#define BINSTATISTICS_H
+
+#include <array>
+#include "binstore.h"
+#include "p2quantile.h"
+#include "windowedquantiles.h"
+
+// Fuel-flow envelope of one RPM bin, learned from observed samples in
+// constant time and memory per sample. The all-time envelope is estimated
+// with P²; the sliding windows keep fixed-resolution histograms over the
+// fuel flow axis, so old samples can expire. An all-time histogram of the
+// same resolution completes the sample density of every window.
+class BinStatistics
+{
+public:
+    explicit BinStatistics(double lowerPercentile = 0.05, double upperPercentile = 0.95,
+                           double minFuelFlow = 0.0, double maxFuelFlow = 80.0);
+
+    void add(qint64 timestampMs, double fuelFlow);
+
+    // Lets the windows drop what has expired by timestampMs
+    void advance(qint64 timestampMs);
+    void reset();
+
+    qint64 count(StatisticsWindow window = AllTimeWindow) const;
+    double lower(StatisticsWindow window = AllTimeWindow) const;
+    double median(StatisticsWindow window = AllTimeWindow) const;
+    double upper(StatisticsWindow window = AllTimeWindow) const;
+
+    // DensityGrid::BUCKETS sample counts over [minFuelFlow, maxFuelFlow];
+    // empty until the window's first sample
+    const QList<quint32> &histogram(StatisticsWindow window = AllTimeWindow) const;
+
+    static qint64 windowMs(StatisticsWindow window);
+
+    friend QDataStream &operator<<(QDataStream &stream, const BinStatistics &statistics);
+    friend QDataStream &operator>>(QDataStream &stream, BinStatistics &statistics);
+
+private:
+    double m_lowerPercentile;
+    double m_upperPercentile;
+    double m_minFuelFlow;
+    double m_maxFuelFlow;
+    P2Quantile m_lower;
+    P2Quantile m_median;
+    P2Quantile m_upper;
+    std::array<WindowedQuantiles, StatisticsWindowCount - 1> m_windows;   // From LastHourWindow on
+    QList<quint32> m_histogram;                                         // All time
+};
+
+#endif // BINSTATISTICS_H
@@ -0,0 +1,124 @@
+#ifndef BINSTORE_H
+#define BINSTORE_H
+
+#include <QList>
+#include <QtMath>
+
+struct DataPoint {
+    double rpm;
+    double minFuelFlow;         // Lower percentile once learned from samples
+    double maxFuelFlow;         // Upper percentile once learned from samples
+    double medianFuelFlow;
+    double currentFuelFlow;
+};
+
+// RPM binning and axis ranges of a chart. Bins are centred on
+// minRpm + i * binWidth and cover [minRpm, maxRpm] inclusive.
+struct BinLayout {
+    double minRpm = 0.0;
+    double maxRpm = 6000.0;
+    double binWidth = 50.0;
+    double minFuelFlow = 0.0;
+    double maxFuelFlow = 80.0;
+
+    int binCount() const
+    {
+        if (!(binWidth > 0.0) || maxRpm < minRpm)
+            return 0;
+        return int(std::floor((maxRpm - minRpm) / binWidth + 1e-9)) + 1;
+    }
+
+    double binRpm(int index) const { return minRpm + index * binWidth; }
+
+    // Index of the bin whose centre is nearest to rpm, or -1 outside the layout
+    int binIndex(double rpm) const
+    {
+        const double position = (rpm - minRpm) / binWidth + 0.5;
+        if (!(position >= 0.0) || position >= binCount())
+            return -1;
+        return int(position);
+    }
+
+    bool operator==(const BinLayout &other) const
+    {
+        return minRpm == other.minRpm && maxRpm == other.maxRpm && binWidth == other.binWidth
+            && minFuelFlow == other.minFuelFlow && maxFuelFlow == other.maxFuelFlow;
+    }
+    bool operator!=(const BinLayout &other) const { return !(*this == other); }
+};
+
+// Time spans the statistics are learned over. Each has its own bin table,
+// so switching between them needs no recomputation.
+enum StatisticsWindow {
+    AllTimeWindow,
+    LastHourWindow,
+    LastDayWindow,
+    SeasonWindow,
+    StatisticsWindowCount
+};
+
+// Bin table stored as structure-of-arrays: each field is its own contiguous
+// column, so scans touch only the doubles they need. Columns are implicitly
+// shared QLists, so copying a BinStore is a cheap immutable snapshot and the
+// owner detaches on its next write.
+struct BinStore {
+    BinLayout layout;
+    QList<double> rpm;
+    QList<double> minFuelFlow;
+    QList<double> maxFuelFlow;
+    QList<double> medianFuelFlow;
+    QList<double> currentFuelFlow;
+
+    int size() const { return int(rpm.size()); }
+    bool isEmpty() const { return rpm.isEmpty(); }
+
+    // Sizes every column for newLayout and fills in the bin centres
+    void reset(const BinLayout &newLayout)
+    {
+        layout = newLayout;
+        const int count = layout.binCount();
+        rpm.resize(count);
+        for (int i = 0; i < count; ++i)
+            rpm[i] = layout.binRpm(i);
+        minFuelFlow.fill(0.0, count);
+        maxFuelFlow.fill(0.0, count);
+        medianFuelFlow.fill(0.0, count);
+        currentFuelFlow.fill(0.0, count);
+    }
+
+    DataPoint point(int row) const
+    {
+        return { rpm.at(row), minFuelFlow.at(row), maxFuelFlow.at(row),
+                 medianFuelFlow.at(row), currentFuelFlow.at(row) };
+    }
+
+    void setPoint(int row, const DataPoint &point)
+    {
+        rpm[row] = point.rpm;
+        minFuelFlow[row] = point.minFuelFlow;
+        maxFuelFlow[row] = point.maxFuelFlow;
+        medianFuelFlow[row] = point.medianFuelFlow;
+        currentFuelFlow[row] = point.currentFuelFlow;
+    }
+};
+
+// Sample counts of every bin over BUCKETS equal fuel flow buckets spanning
+// the layout's fuel flow axis. Rows are implicitly shared one by one, so a
+// copy only duplicates the rows its owner writes to afterwards.
+struct DensityGrid {
+    static constexpr int BUCKETS = 128;
+
+    BinLayout layout;
+    QList<QList<quint32>> rows;         // BUCKETS counts per bin, empty while the bin has none
+
+    int size() const { return int(rows.size()); }
+    bool isEmpty() const { return rows.isEmpty(); }
+
+    void reset(const BinLayout &newLayout)
+    {
+        layout = newLayout;
+        rows = QList<QList<quint32>>(layout.binCount());
+    }
+};
+
+#endif // BINSTORE_H
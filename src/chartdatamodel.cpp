@@ -1,5 +1,10 @@
 #include "chartdatamodel.h"
+#include "bininterpolator.h"
+#include "metrics.h"
+#include "statisticsengine.h"
+#include <QCoreApplication>
 #include <QRandomGenerator>
+#include <QThread>
 #include <QtMath>
 #include <algorithm>
 
@@ -8,33 +13,59 @@ ChartDataModel::ChartDataModel(QObject *parent)
     , m_currentRpm(1500.0)
     , m_currentFuelFlow(0.0)
     , m_isEcoMode(false)
+    , m_currentSpeed(0.0)
+    , m_remainingFuel(0.0)
+    , m_fuelPerNauticalMile(0.0)
+    , m_optimalRow(-1)
+    , m_optimalFuelPerNauticalMile(0.0)
+    , m_lowerPercentile(0.05)
+    , m_upperPercentile(0.95)
+    , m_statisticsWindow(AllTimeWindow)
+    , m_dataVersion(0)
+    , m_generator(QRandomGenerator::global()->generate())
+    , m_statisticsThread(new QThread(this))
+    , m_statisticsEngine(new StatisticsEngine(m_lowerPercentile, m_upperPercentile))
 {
+    // Learning and history replay never run on the GUI thread; results are
+    // picked up as snapshots
+    m_statisticsThread->setObjectName(QStringLiteral("StatisticsEngine"));
+    m_statisticsEngine->moveToThread(m_statisticsThread);
+    connect(m_statisticsEngine, &StatisticsEngine::snapshotReady,
+            this, &ChartDataModel::acquireStatistics);
+    m_statisticsThread->start();
+}
+
+ChartDataModel::~ChartDataModel()
+{
+    m_statisticsThread->quit();
+    m_statisticsThread->wait();
+    delete m_statisticsEngine;
 }
 
 int ChartDataModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
-    return m_dataPoints.size();
+    return m_bins.size();
 }
 
 QVariant ChartDataModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid() || index.row() >= m_dataPoints.size())
+    if (!index.isValid() || index.row() >= m_bins.size())
         return QVariant();
 
-    const DataPoint &point = m_dataPoints.at(index.row());
+    const int row = index.row();
 
     switch (role) {
     case RpmRole:
-        return point.rpm;
+        return m_bins.rpm.at(row);
     case MinFuelFlowRole:
-        return point.minFuelFlow;
+        return m_bins.minFuelFlow.at(row);
     case MaxFuelFlowRole:
-        return point.maxFuelFlow;
+        return m_bins.maxFuelFlow.at(row);
     case MedianFuelFlowRole:
-        return point.medianFuelFlow;
+        return m_bins.medianFuelFlow.at(row);
     case CurrentFuelFlowRole:
-        return point.currentFuelFlow;
+        return m_bins.currentFuelFlow.at(row);
     default:
         return QVariant();
     }
@@ -56,31 +87,220 @@ void ChartDataModel::setCurrentRpm(double rpm)
     if (qFuzzyCompare(m_currentRpm, rpm))
         return;
 
-    m_currentRpm = qBound(0.0, rpm, 6000.0);
+    m_currentRpm = qBound(minRpm(), rpm, maxRpm());
     updateCurrentFuelFlow();
     emit currentRpmChanged();
 }
 
+void ChartDataModel::setLowerPercentile(double percentile)
+{
+    percentile = qBound(0.0, percentile, 0.5);
+    if (qFuzzyCompare(m_lowerPercentile, percentile))
+        return;
+
+    m_lowerPercentile = percentile;
+    QMetaObject::invokeMethod(m_statisticsEngine, [engine = m_statisticsEngine,
+                              lower = m_lowerPercentile, upper = m_upperPercentile]() {
+        engine->setPercentiles(lower, upper);
+    }, Qt::QueuedConnection);
+
+    // The fleet envelope is taken at the model's percentiles too
+    if (!m_fleetSketch.isEmpty())
+        generateSampleData();
+    emit percentilesChanged();
+}
+
+void ChartDataModel::setStatisticsWindow(int window)
+{
+    window = qBound(0, window, StatisticsWindowCount - 1);
+    if (m_statisticsWindow == window)
+        return;
+
+    m_statisticsWindow = window;
+    m_bins = m_windowBins[window];
+    m_density = m_windowDensity[window];
+    ++m_dataVersion;
+    if (!m_bins.isEmpty()) {
+        emit dataChanged(index(0), index(m_bins.size() - 1),
+                         { MinFuelFlowRole, MaxFuelFlowRole, MedianFuelFlowRole });
+    }
+    if (!m_density.isEmpty())
+        emit densityChanged(0, m_density.size() - 1);
+    updateCruiseFuelFlow(0, m_bins.size() - 1);
+    updateEcoMode();
+    updateEconomy();
+    emit statisticsWindowChanged();
+}
+
+void ChartDataModel::setCurrentSpeed(double knots)
+{
+    knots = qMax(0.0, knots);
+    if (qFuzzyCompare(m_currentSpeed, knots))
+        return;
+
+    m_currentSpeed = knots;
+    m_cruise.addSpeed(m_currentRpm, knots);
+    emit currentSpeedChanged();
+    updateEconomy();
+}
+
+void ChartDataModel::setRemainingFuel(double litres)
+{
+    litres = qMax(0.0, litres);
+    if (qFuzzyCompare(m_remainingFuel, litres))
+        return;
+
+    m_remainingFuel = litres;
+    emit remainingFuelChanged();
+    emit economyChanged();
+}
+
+double ChartDataModel::range() const
+{
+    return m_fuelPerNauticalMile > 0.0 ? m_remainingFuel / m_fuelPerNauticalMile : 0.0;
+}
+
+double ChartDataModel::optimalRpm() const
+{
+    return m_optimalRow >= 0 ? m_bins.rpm.at(m_optimalRow) : 0.0;
+}
+
+double ChartDataModel::optimalRange() const
+{
+    return m_optimalFuelPerNauticalMile > 0.0 ? m_remainingFuel / m_optimalFuelPerNauticalMile : 0.0;
+}
+
+void ChartDataModel::setUpperPercentile(double percentile)
+{
+    percentile = qBound(0.5, percentile, 1.0);
+    if (qFuzzyCompare(m_upperPercentile, percentile))
+        return;
+
+    m_upperPercentile = percentile;
+    QMetaObject::invokeMethod(m_statisticsEngine, [engine = m_statisticsEngine,
+                              lower = m_lowerPercentile, upper = m_upperPercentile]() {
+        engine->setPercentiles(lower, upper);
+    }, Qt::QueuedConnection);
+
+    if (!m_fleetSketch.isEmpty())
+        generateSampleData();
+    emit percentilesChanged();
+}
+
+void ChartDataModel::setLayout(const BinLayout &layout)
+{
+    if (layout == m_layout || layout.binCount() <= 0
+        || !(layout.maxFuelFlow > layout.minFuelFlow)) {
+        return;
+    }
+
+    m_layout = layout;
+    generateSampleData();
+
+    m_currentRpm = qBound(minRpm(), m_currentRpm, maxRpm());
+    emit binLayoutChanged();
+    updateCurrentFuelFlow();
+}
+
+void ChartDataModel::setMinRpm(double rpm)
+{
+    BinLayout layout = m_layout;
+    layout.minRpm = rpm;
+    setLayout(layout);
+}
+
+void ChartDataModel::setMaxRpm(double rpm)
+{
+    BinLayout layout = m_layout;
+    layout.maxRpm = rpm;
+    setLayout(layout);
+}
+
+void ChartDataModel::setBinWidth(double width)
+{
+    BinLayout layout = m_layout;
+    layout.binWidth = width;
+    setLayout(layout);
+}
+
+void ChartDataModel::setMinFuelFlow(double fuelFlow)
+{
+    BinLayout layout = m_layout;
+    layout.minFuelFlow = fuelFlow;
+    setLayout(layout);
+}
+
+void ChartDataModel::setMaxFuelFlow(double fuelFlow)
+{
+    BinLayout layout = m_layout;
+    layout.maxFuelFlow = fuelFlow;
+    setLayout(layout);
+}
+
 void ChartDataModel::generateSampleData()
 {
-    beginResetModel();
-    m_dataPoints.clear();
+    ScopedTimer timer(Metrics::ModelReset);
+
+    const BinLayout layout = m_layout;
+    BinStore baseline = sampleBaseline(layout, &m_generator);
+    if (!m_fleetSketch.isEmpty())
+        baseline = m_fleetSketch.envelope(m_lowerPercentile, m_upperPercentile, baseline);
+
+    // Bins already learned from real samples keep their learned envelope,
+    // which the engine lays over the new baseline. A new layout has nothing
+    // learned yet, so its baseline is shown right away; only a different
+    // bin count changes the model's structure.
+    if (m_bins.layout != layout || m_bins.size() != baseline.size()) {
+        const bool resized = m_bins.size() != baseline.size();
+        if (resized)
+            beginResetModel();
+        m_windowBins.fill(baseline);
+        m_bins = baseline;
+        m_density.reset(layout);
+        m_windowDensity.fill(m_density);
+        ++m_dataVersion;
+        if (resized)
+            endResetModel();
+        else if (!m_bins.isEmpty())
+            emit dataChanged(index(0), index(m_bins.size() - 1));
+        if (!resized && !m_density.isEmpty())
+            emit densityChanged(0, m_density.size() - 1);
+
+        // Speeds were measured against the old bins
+        m_cruise.reset(layout);
+        updateCruiseFuelFlow(0, m_bins.size() - 1);
+        updateEconomy();
+    }
+
+    QMetaObject::invokeMethod(m_statisticsEngine, [engine = m_statisticsEngine, baseline]() {
+        engine->setBaseline(baseline);
+    }, Qt::QueuedConnection);
+    updateCurrentFuelFlow();
+}
+
+BinStore ChartDataModel::sampleBaseline(const BinLayout &layout, QRandomGenerator *generator)
+{
+    BinStore baseline;
+    baseline.reset(layout);
 
-    // Initialize random number generator for realistic variations
-    auto *generator = QRandomGenerator::global();
+    // The synthetic curve is shaped relative to the rated speed, and the
+    // envelope is kept inside the fuel flow axis
+    const double rpmSpan = layout.maxRpm - layout.minRpm;
+    const double fuelFlowCap = layout.minFuelFlow + (layout.maxFuelFlow - layout.minFuelFlow) * 0.9375;
     
-    // Generate data points every 50 RPM for finer granularity
-    for (int rpm = 0; rpm <= 6000; rpm += 50) {
+    // Generate one data point per bin
+    for (int row = 0; row < baseline.size(); ++row) {
+        const double rpm = baseline.rpm.at(row);
         DataPoint point;
         point.rpm = rpm;
 
         // Base fuel flow calculation (quadratic relationship with RPM) - further reduced to ensure max stays below 80
         // Even more conservative scaling to guarantee we stay under 80 with all variations and penalties
-        double baseFuelFlow = 0.5 + (rpm / 6000.0) * 25.0 + qPow(rpm / 6000.0, 2) * 10.0; // Max ~36 at 6000 RPM
+        double baseFuelFlow = ChartDataModel::baseFuelFlow(rpm, layout.maxRpm); // Max ~36 at rated speed
         
         // Create more realistic, non-uniform variations - further reduced ranges
         // Lower RPM has smaller absolute variations, higher RPM has larger variations
-        double rpmFactor = rpm / 6000.0; // 0 to 1
+        double rpmFactor = rpmSpan > 0.0 ? (rpm - layout.minRpm) / rpmSpan : 0.0; // 0 to 1
         
         // Much more conservative variation ranges
         double minVariationPercent = 0.05 + (rpmFactor * 0.15) + (generator->generateDouble() - 0.5) * 0.1; // 5-20% + random
@@ -99,18 +319,18 @@ void ChartDataModel::generateSampleData()
         point.maxFuelFlow = adjustedBase * (1.0 + maxVariationPercent);
         
         // Add some non-linearity to the engine efficiency curve at certain RPM ranges - very conservative
-        if (rpm > 1500 && rpm < 3000) {
+        if (rpmFactor > 0.25 && rpmFactor < 0.5) {
             // Sweet spot - tighter efficiency range
             double efficiencyBonus = 0.95 + generator->generateDouble() * 0.05; // 95-100% efficiency
             point.minFuelFlow *= efficiencyBonus;
-        } else if (rpm > 4500) {
+        } else if (rpmFactor > 0.75) {
             // High RPM - less efficient, wider spread - very conservative penalty
             double inefficiencyPenalty = 1.02 + generator->generateDouble() * 0.08; // 102-110% penalty (much reduced)
             point.maxFuelFlow *= inefficiencyPenalty;
         }
         
-        // Final safety check - absolutely ensure max value is below 80
-        point.maxFuelFlow = qMin(75.0, point.maxFuelFlow); // Cap at 75 for extra safety margin
+        // Final safety check - absolutely ensure max value stays below the axis maximum
+        point.maxFuelFlow = qMin(fuelFlowCap, point.maxFuelFlow); // 75 on the default 0-80 axis
         
         // Set median to be positioned realistically (not always at 40%)
         double medianPosition = 0.3 + generator->generateDouble() * 0.4; // 30-70% between min and max
@@ -119,17 +339,16 @@ void ChartDataModel::generateSampleData()
         // Current fuel flow will be updated based on current RPM
         point.currentFuelFlow = baseFuelFlow;
 
-        m_dataPoints.append(point);
+        baseline.setPoint(row, point);
     }
-
-    endResetModel();
-    updateCurrentFuelFlow();
+    return baseline;
 }
 
 QVariantList ChartDataModel::getDataPoints() const
 {
     QVariantList result;
-    for (const auto &point : m_dataPoints) {
+    for (int row = 0; row < m_bins.size(); ++row) {
+        const DataPoint point = m_bins.point(row);
         QVariantMap pointMap;
         pointMap["rpm"] = point.rpm;
         pointMap["minFuelFlow"] = point.minFuelFlow;
@@ -143,64 +362,201 @@ QVariantList ChartDataModel::getDataPoints() const
 
 double ChartDataModel::getCurrentFuelFlowAtRpm(double rpm) const
 {
-    return interpolateFuelFlow(rpm, false);
+    return interpolateFuelFlow(rpm);
+}
+
+void ChartDataModel::ingestSamples(const TelemetrySample *samples, int count)
+{
+    if (count <= 0)
+        return;
+
+    Metrics::add(Metrics::SamplesIngested, count);
+
+    // The batch is learned and logged on the statistics thread
+    std::vector<TelemetrySample> batch(samples, samples + count);
+    QMetaObject::invokeMethod(m_statisticsEngine, [engine = m_statisticsEngine, batch = std::move(batch)]() {
+        engine->ingest(batch);
+    }, Qt::QueuedConnection);
+
+    // Every speed reading counts towards its bin's speed, cheaply enough to
+    // keep up with the ring
+    double speed = m_currentSpeed;
+    for (int i = 0; i < count; ++i) {
+        if (qIsFinite(samples[i].speed)) {
+            m_cruise.addSpeed(samples[i].rpm, samples[i].speed);
+            speed = samples[i].speed;
+        }
+    }
+
+    // Only the latest reading of a frame is displayed
+    const TelemetrySample &latest = samples[count - 1];
+    const double rpm = qBound(minRpm(), latest.rpm, maxRpm());
+
+    if (!qFuzzyCompare(m_currentRpm, rpm)) {
+        m_currentRpm = rpm;
+        emit currentRpmChanged();
+    }
+    if (!qFuzzyCompare(m_currentSpeed, speed)) {
+        m_currentSpeed = speed;
+        emit currentSpeedChanged();
+    }
+
+    applyCurrentFuelFlow(latest.fuelFlow);
+}
+
+void ChartDataModel::attachHistory(SampleLog *log)
+{
+    QMetaObject::invokeMethod(m_statisticsEngine, [engine = m_statisticsEngine, log]() {
+        engine->attachHistory(log);
+    }, Qt::QueuedConnection);
+}
+
+void ChartDataModel::attachReplay(SampleLog *log)
+{
+    QMetaObject::invokeMethod(m_statisticsEngine, [engine = m_statisticsEngine, log]() {
+        engine->attachReplay(log);
+    }, Qt::QueuedConnection);
+}
+
+void ChartDataModel::seekReplay(qint64 sample)
+{
+    // Queued behind the samples ingested before the seek
+    QMetaObject::invokeMethod(m_statisticsEngine, [engine = m_statisticsEngine, sample]() {
+        engine->seekReplay(sample);
+    }, Qt::QueuedConnection);
+}
+
+bool ChartDataModel::saveCheckpoint()
+{
+    // Queued behind any batch still in flight, so the checkpoint covers it
+    bool saved = false;
+    QMetaObject::invokeMethod(m_statisticsEngine, [engine = m_statisticsEngine, &saved]() {
+        saved = engine->saveCheckpoint();
+    }, Qt::BlockingQueuedConnection);
+    return saved;
+}
+
+void ChartDataModel::waitForStatistics()
+{
+    QMetaObject::invokeMethod(m_statisticsEngine, []() {}, Qt::BlockingQueuedConnection);
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+}
+
+double ChartDataModel::baseFuelFlow(double rpm, double maxRpm)
+{
+    return 0.5 + (rpm / maxRpm) * 25.0 + qPow(rpm / maxRpm, 2) * 10.0;
+}
+
+void ChartDataModel::setFleetSketch(const FleetSketch &sketch)
+{
+    m_fleetSketch = sketch;
+    generateSampleData();
+}
+
+void ChartDataModel::setRandomSeed(quint64 seed)
+{
+    const quint32 seedBuffer[] = { quint32(seed), quint32(seed >> 32) };
+    m_generator = QRandomGenerator(seedBuffer);
 }
 
 void ChartDataModel::updateCurrentFuelFlow()
 {
-    double newFuelFlow = interpolateFuelFlow(m_currentRpm, false);
+    ScopedTimer timer(Metrics::CurrentFuelFlowUpdate);
+
+    double newFuelFlow = interpolateFuelFlow(m_currentRpm);
     
     // Add some random variation to simulate real conditions
-    auto *generator = QRandomGenerator::global();
+    auto *generator = &m_generator;
     double variation = (generator->generateDouble() - 0.5) * 0.3; // ±15% variation
     newFuelFlow *= (1.0 + variation);
-    
-    if (!qFuzzyCompare(m_currentFuelFlow, newFuelFlow)) {
-        m_currentFuelFlow = newFuelFlow;
-        
-        // Determine if we're in eco mode (below median)
-        double medianAtCurrentRpm = interpolateFuelFlow(m_currentRpm, true);
-        bool newEcoMode = m_currentFuelFlow < medianAtCurrentRpm;
-        
-        if (m_isEcoMode != newEcoMode) {
-            m_isEcoMode = newEcoMode;
-            emit ecoModeChanged();
-        }
-        
+
+    applyCurrentFuelFlow(newFuelFlow);
+}
+
+void ChartDataModel::applyCurrentFuelFlow(double fuelFlow)
+{
+    if (!qFuzzyCompare(m_currentFuelFlow, fuelFlow)) {
+        m_currentFuelFlow = fuelFlow;
+        updateEcoMode();
         emit currentFuelFlowChanged();
     }
+    updateEconomy();
 }
 
-double ChartDataModel::interpolateFuelFlow(double rpm, bool useMedian) const
+void ChartDataModel::updateEcoMode()
 {
-    if (m_dataPoints.isEmpty())
-        return 0.0;
+    // Eco mode means below the median of the selected window
+    double medianAtCurrentRpm = interpolateFuelFlow(m_currentRpm);
+    bool newEcoMode = m_currentFuelFlow < medianAtCurrentRpm;
 
-    // Find the two nearest points for interpolation
-    auto it = std::lower_bound(m_dataPoints.begin(), m_dataPoints.end(), rpm,
-                               [](const DataPoint &point, double value) {
-                                   return point.rpm < value;
-                               });
-
-    if (it == m_dataPoints.begin()) {
-        return useMedian ? it->medianFuelFlow : it->medianFuelFlow;
+    if (m_isEcoMode != newEcoMode) {
+        m_isEcoMode = newEcoMode;
+        emit ecoModeChanged();
     }
-    
-    if (it == m_dataPoints.end()) {
-        return useMedian ? (it - 1)->medianFuelFlow : (it - 1)->medianFuelFlow;
+}
+
+void ChartDataModel::updateEconomy()
+{
+    const double fuelPerNauticalMile = m_currentSpeed >= CruiseEstimator::MIN_SPEED
+        ? m_currentFuelFlow / m_currentSpeed : 0.0;
+    const int optimalRow = m_cruise.optimalRow();
+    const double optimalFuelPerNauticalMile = optimalRow >= 0
+        ? m_cruise.fuelPerNauticalMile(optimalRow) : 0.0;
+
+    if (qFuzzyCompare(m_fuelPerNauticalMile, fuelPerNauticalMile) && m_optimalRow == optimalRow
+        && qFuzzyCompare(m_optimalFuelPerNauticalMile, optimalFuelPerNauticalMile)) {
+        return;
     }
 
-    // Linear interpolation between two points
-    const DataPoint &p1 = *(it - 1);
-    const DataPoint &p2 = *it;
-    
-    double ratio = (rpm - p1.rpm) / (p2.rpm - p1.rpm);
-    
-    if (useMedian) {
-        return p1.medianFuelFlow + ratio * (p2.medianFuelFlow - p1.medianFuelFlow);
-    } else {
-        // For current fuel flow, interpolate the median but add some variation
-        double baseFuelFlow = p1.medianFuelFlow + ratio * (p2.medianFuelFlow - p1.medianFuelFlow);
-        return baseFuelFlow;
+    m_fuelPerNauticalMile = fuelPerNauticalMile;
+    m_optimalRow = optimalRow;
+    m_optimalFuelPerNauticalMile = optimalFuelPerNauticalMile;
+    emit economyChanged();
+}
+
+void ChartDataModel::updateCruiseFuelFlow(int firstRow, int lastRow)
+{
+    if (m_cruise.layout() != m_bins.layout)
+        return;
+
+    for (int row = qMax(0, firstRow); row <= lastRow && row < m_bins.size(); ++row)
+        m_cruise.setFuelFlow(row, m_bins.medianFuelFlow.at(row));
+}
+
+double ChartDataModel::interpolateFuelFlow(double rpm) const
+{
+    return BinInterpolator(m_bins.layout, m_bins.medianFuelFlow).value(rpm);
+}
+
+void ChartDataModel::interpolateFuelFlow(const double *rpms, double *out, qsizetype count) const
+{
+    BinInterpolator(m_bins.layout, m_bins.medianFuelFlow).values(rpms, out, count);
+}
+
+void ChartDataModel::acquireStatistics()
+{
+    const StatisticsSnapshot snapshot = m_statisticsEngine->acquire();
+
+    // A snapshot still computed for a previous layout is superseded by the
+    // one the engine is working on now
+    const BinStore &allTime = snapshot.bins[AllTimeWindow];
+    if (snapshot.version == 0 || allTime.layout != m_bins.layout || allTime.size() != m_bins.size())
+        return;
+
+    m_windowBins = snapshot.bins;
+    m_bins = m_windowBins[m_statisticsWindow];
+    m_windowDensity = snapshot.density;
+    m_density = m_windowDensity[m_statisticsWindow];
+    ++m_dataVersion;
+    for (const StatisticsSnapshot::RowRange &range : snapshot.changed) {
+        emit dataChanged(index(range.first), index(range.last),
+                         { MinFuelFlowRole, MaxFuelFlowRole, MedianFuelFlowRole });
+        emit densityChanged(range.first, range.last);
+        updateCruiseFuelFlow(range.first, range.last);
     }
+
+    // New medians move the line eco mode is judged against, even while the
+    // current reading stands still, e.g. with a replay paused
+    updateEcoMode();
+    updateEconomy();
 }
@@ -4,25 +4,38 @@
 #include <QObject>
 #include <QAbstractListModel>
 #include <QVariant>
+#include <QRandomGenerator>
+#include <array>
+#include "binstore.h"
+#include "cruiseestimator.h"
+#include "fleetsketch.h"
+#include "telemetrysample.h"
 
-struct DataPoint {
-    double rpm;
-    double minFuelFlow;
-    double maxFuelFlow;
-    double medianFuelFlow;
-    double currentFuelFlow;
-};
+class QThread;
+class SampleLog;
+class StatisticsEngine;
 
 class ChartDataModel : public QAbstractListModel
 {
     Q_OBJECT
-    Q_PROPERTY(double minRpm READ minRpm NOTIFY dataChanged)
-    Q_PROPERTY(double maxRpm READ maxRpm NOTIFY dataChanged)
-    Q_PROPERTY(double minFuelFlow READ minFuelFlow NOTIFY dataChanged)
-    Q_PROPERTY(double maxFuelFlow READ maxFuelFlow NOTIFY dataChanged)
+    Q_PROPERTY(double minRpm READ minRpm WRITE setMinRpm NOTIFY binLayoutChanged)
+    Q_PROPERTY(double maxRpm READ maxRpm WRITE setMaxRpm NOTIFY binLayoutChanged)
+    Q_PROPERTY(double binWidth READ binWidth WRITE setBinWidth NOTIFY binLayoutChanged)
+    Q_PROPERTY(double minFuelFlow READ minFuelFlow WRITE setMinFuelFlow NOTIFY binLayoutChanged)
+    Q_PROPERTY(double maxFuelFlow READ maxFuelFlow WRITE setMaxFuelFlow NOTIFY binLayoutChanged)
     Q_PROPERTY(double currentRpm READ currentRpm WRITE setCurrentRpm NOTIFY currentRpmChanged)
     Q_PROPERTY(double currentFuelFlow READ currentFuelFlow NOTIFY currentFuelFlowChanged)
     Q_PROPERTY(bool isEcoMode READ isEcoMode NOTIFY ecoModeChanged)
+    Q_PROPERTY(double lowerPercentile READ lowerPercentile WRITE setLowerPercentile NOTIFY percentilesChanged)
+    Q_PROPERTY(double upperPercentile READ upperPercentile WRITE setUpperPercentile NOTIFY percentilesChanged)
+    Q_PROPERTY(int statisticsWindow READ statisticsWindow WRITE setStatisticsWindow NOTIFY statisticsWindowChanged)
+    Q_PROPERTY(double currentSpeed READ currentSpeed WRITE setCurrentSpeed NOTIFY currentSpeedChanged)
+    Q_PROPERTY(double remainingFuel READ remainingFuel WRITE setRemainingFuel NOTIFY remainingFuelChanged)
+    Q_PROPERTY(double fuelPerNauticalMile READ fuelPerNauticalMile NOTIFY economyChanged)
+    Q_PROPERTY(double range READ range NOTIFY economyChanged)
+    Q_PROPERTY(double optimalRpm READ optimalRpm NOTIFY economyChanged)
+    Q_PROPERTY(double optimalFuelPerNauticalMile READ optimalFuelPerNauticalMile NOTIFY economyChanged)
+    Q_PROPERTY(double optimalRange READ optimalRange NOTIFY economyChanged)
 
 public:
     enum DataRoles {
@@ -34,6 +47,7 @@ public:
     };
 
     explicit ChartDataModel(QObject *parent = nullptr);
+    ~ChartDataModel() override;
 
     // QAbstractListModel interface
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -41,37 +55,166 @@ public:
     QHash<int, QByteArray> roleNames() const override;
 
     // Property getters
-    double minRpm() const { return 0.0; }
-    double maxRpm() const { return 6000.0; }
-    double minFuelFlow() const { return 0.0; }
-    double maxFuelFlow() const { return 50.0; }
+    const BinLayout &layout() const { return m_layout; }
+    double minRpm() const { return m_layout.minRpm; }
+    double maxRpm() const { return m_layout.maxRpm; }
+    double binWidth() const { return m_layout.binWidth; }
+    double minFuelFlow() const { return m_layout.minFuelFlow; }
+    double maxFuelFlow() const { return m_layout.maxFuelFlow; }
     double currentRpm() const { return m_currentRpm; }
     double currentFuelFlow() const { return m_currentFuelFlow; }
     bool isEcoMode() const { return m_isEcoMode; }
+    double lowerPercentile() const { return m_lowerPercentile; }
+    double upperPercentile() const { return m_upperPercentile; }
+    int statisticsWindow() const { return m_statisticsWindow; }
+    double currentSpeed() const { return m_currentSpeed; }
+    double remainingFuel() const { return m_remainingFuel; }
+
+    // Fuel economy in L/NM and range in NM on the remaining fuel, now and
+    // at optimalRpm(), the RPM whose bin burns the least per mile. The
+    // bins' economy combines their median fuel flow with the speed the
+    // boat made there, see CruiseEstimator. Each is 0 while unknown.
+    double fuelPerNauticalMile() const { return m_fuelPerNauticalMile; }
+    double range() const;
+    double optimalRpm() const;
+    double optimalFuelPerNauticalMile() const { return m_optimalFuelPerNauticalMile; }
+    double optimalRange() const;
 
     // Property setters
     void setCurrentRpm(double rpm);
 
+    // Changing the layout regenerates the bins and relearns them from the
+    // history, if one is attached
+    void setLayout(const BinLayout &layout);
+    void setMinRpm(double rpm);
+    void setMaxRpm(double rpm);
+    void setBinWidth(double width);
+    void setMinFuelFlow(double fuelFlow);
+    void setMaxFuelFlow(double fuelFlow);
+
+    // Percentiles learned into minFuelFlow/maxFuelFlow. Changing them
+    // relearns the bins from the history in the background.
+    void setLowerPercentile(double percentile);
+    void setUpperPercentile(double percentile);
+
+    // StatisticsWindow the bins, the median and isEcoMode refer to. Every
+    // window is kept up to date, so switching is immediate.
+    void setStatisticsWindow(int window);
+
+    // Speed over ground in knots, for setups without telemetry: it is also
+    // taken as the speed made at the current RPM. Telemetry samples carry
+    // their own speed.
+    void setCurrentSpeed(double knots);
+
+    // Litres left in the tank this engine draws from
+    void setRemainingFuel(double litres);
+
     // Public methods
     Q_INVOKABLE void generateSampleData();
     Q_INVOKABLE QVariantList getDataPoints() const;
     Q_INVOKABLE double getCurrentFuelFlowAtRpm(double rpm) const;
 
-    Q_SIGNAL void dataChanged();
+    // Median fuel flow at any RPM, interpolated between bins in O(1). The
+    // batch form evaluates a whole span, e.g. for curves or re-analysis.
+    double interpolateFuelFlow(double rpm) const;
+    void interpolateFuelFlow(const double *rpms, double *out, qsizetype count) const;
+
+    // Implicitly shared snapshot of the bin columns for C++ consumers;
+    // unlike getDataPoints() this neither copies nor boxes anything. Learned
+    // statistics arrive asynchronously, see StatisticsEngine.
+    BinStore bins() const { return m_bins; }
+
+    // Learned sample counts per bin and fuel flow bucket, of the selected
+    // window. Changed rows are announced with densityChanged().
+    DensityGrid density() const { return m_density; }
+
+    // Bumped whenever bin contents change, for consumers that cache
+    // anything derived from them
+    quint64 dataVersion() const { return m_dataVersion; }
+
+    // Applies a batch of live readings drained from the telemetry ring. The
+    // latest sample becomes the current reading at once; every sample is
+    // handed to the statistics engine, whose results show up as dataChanged.
+    void ingestSamples(const TelemetrySample *samples, int count);
+
+    // Restores the bin statistics from the log's last checkpoint and replays
+    // only the samples recorded after it. Ingested samples are then appended
+    // to the log and checkpointed periodically. From here on the log belongs
+    // to the statistics thread.
+    void attachHistory(SampleLog *log);
+
+    // Blocks until the statistics thread has written the checkpoint
+    bool saveCheckpoint();
+
+    // Blocks until the statistics thread has handled everything queued so
+    // far, then applies the snapshots it posted back
+    void waitForStatistics();
+
+    // Replays a recorded log instead: the statistics cover it up to the
+    // sample the playback has reached, see StatisticsEngine::attachReplay().
+    // Like attachHistory(), the log belongs to the statistics thread.
+    void attachReplay(SampleLog *log);
+    void seekReplay(qint64 sample);
+
+    // Shows the fleet's envelope, at this model's layout and percentiles,
+    // wherever no samples have been learned, instead of the synthetic
+    // baseline. A model without history thus becomes the fleet reference.
+    void setFleetSketch(const FleetSketch &sketch);
+
+    // Reseeds the variations of generateSampleData() and the current
+    // reading, so that a seeded run can be reproduced
+    void setRandomSeed(quint64 seed);
+
+    // Synthetic envelope generateSampleData() shows until samples are
+    // learned, drawn from generator
+    static BinStore sampleBaseline(const BinLayout &layout, QRandomGenerator *generator);
+
+    // Nominal fuel consumption curve of the sample engine, in L/h, for an
+    // engine whose rated speed is maxRpm
+    static double baseFuelFlow(double rpm, double maxRpm = 6000.0);
 
 signals:
     void currentRpmChanged();
     void currentFuelFlowChanged();
     void ecoModeChanged();
+    void binLayoutChanged();
+    void percentilesChanged();
+    void statisticsWindowChanged();
+    void densityChanged(int firstRow, int lastRow);
+    void currentSpeedChanged();
+    void remainingFuelChanged();
+    void economyChanged();
 
 private:
     void updateCurrentFuelFlow();
-    double interpolateFuelFlow(double rpm, bool useMedian = false) const;
+    void applyCurrentFuelFlow(double fuelFlow);
+    void updateEcoMode();
+    void updateEconomy();
+    void updateCruiseFuelFlow(int firstRow, int lastRow);
+    void acquireStatistics();
 
-    QList<DataPoint> m_dataPoints;
+    BinLayout m_layout;                     // Requested; m_bins.layout is what is shown
+    std::array<BinStore, StatisticsWindowCount> m_windowBins;
+    BinStore m_bins;                        // The selected window
+    std::array<DensityGrid, StatisticsWindowCount> m_windowDensity;
+    DensityGrid m_density;                  // The selected window
     double m_currentRpm;
     double m_currentFuelFlow;
     bool m_isEcoMode;
+    double m_currentSpeed;
+    double m_remainingFuel;
+    CruiseEstimator m_cruise;               // Follows the selected window's medians
+    double m_fuelPerNauticalMile;
+    int m_optimalRow;
+    double m_optimalFuelPerNauticalMile;
+    double m_lowerPercentile;
+    double m_upperPercentile;
+    int m_statisticsWindow;
+    quint64 m_dataVersion;
+    QRandomGenerator m_generator;
+    FleetSketch m_fleetSketch;
+    QThread *m_statisticsThread;
+    StatisticsEngine *m_statisticsEngine;
 };
 
 #endif // CHARTDATAMODEL_H
@@ -0,0 +1,356 @@
+#include "chartpainter.h"
+#include "metrics.h"
+#include <QBrush>
+#include <QLinearGradient>
+#include <QPainterPath>
+#include <QPen>
+#include <QtMath>
+
+namespace {
+
+// Round tick values covering [min, max] with roughly targetIntervals gaps,
+// stepping by 1, 2 or 5 times a power of ten
+QList<double> axisTicks(double min, double max, int targetIntervals)
+{
+    QList<double> ticks;
+    const double range = max - min;
+    if (!(range > 0.0))
+        return ticks;
+
+    const double rough = range / targetIntervals;
+    const double magnitude = qPow(10.0, qFloor(std::log10(rough)));
+    const double fraction = rough / magnitude;
+    const double step = (fraction < 1.5 ? 1.0 : fraction < 3.5 ? 2.0 : fraction < 7.5 ? 5.0 : 10.0) * magnitude;
+
+    for (double tick = qCeil(min / step - 1e-9) * step; tick <= max + step * 1e-9; tick += step)
+        ticks.append(tick);
+    return ticks;
+}
+
+// Enough decimals to tell ticks step apart, none for whole numbers
+QString tickLabel(double value, double step)
+{
+    const int decimals = step >= 1.0 ? 0 : qCeil(-std::log10(step) - 1e-9);
+    return QString::number(value, 'f', decimals);
+}
+
+} // namespace
+
+ChartPainter::ChartPainter()
+    : m_minRpm(0.0)
+    , m_maxRpm(6000.0)
+    , m_viewMinRpm(0.0)
+    , m_viewMaxRpm(6000.0)
+    , m_minFuelFlow(0.0)
+    , m_maxFuelFlow(80.0)
+    , m_font("Arial", 10)
+    , m_devicePixelRatio(1.0)
+    , m_dataVersion(0)
+{
+}
+
+void ChartPainter::setRpmRange(double minRpm, double maxRpm)
+{
+    m_minRpm = minRpm;
+    m_maxRpm = maxRpm;
+}
+
+void ChartPainter::setViewRange(double minRpm, double maxRpm)
+{
+    m_viewMinRpm = minRpm;
+    m_viewMaxRpm = maxRpm;
+}
+
+void ChartPainter::setFuelFlowRange(double minFuelFlow, double maxFuelFlow)
+{
+    m_minFuelFlow = minFuelFlow;
+    m_maxFuelFlow = maxFuelFlow;
+}
+
+QRectF ChartPainter::chartRect() const
+{
+    return QRectF(MARGIN, MARGIN,
+                  m_size.width() - 2 * MARGIN,
+                  m_size.height() - 2 * MARGIN);
+}
+
+QRectF ChartPainter::plotColumns(const QRectF &chartRect) const
+{
+    return QRectF(chartRect.left(), 0, chartRect.width(), m_size.height());
+}
+
+QPointF ChartPainter::mapToChart(double rpm, double fuelFlow, const QRectF &chartRect) const
+{
+    double x = chartRect.left() + ((rpm - m_viewMinRpm) / (m_viewMaxRpm - m_viewMinRpm)) * chartRect.width();
+    double y = chartRect.bottom() - ((fuelFlow - m_minFuelFlow) / (m_maxFuelFlow - m_minFuelFlow)) * chartRect.height();
+    return QPointF(x, y);
+}
+
+double ChartPainter::rpmAt(double x, const QRectF &chartRect) const
+{
+    return m_viewMinRpm + (x - chartRect.left()) / chartRect.width() * (m_viewMaxRpm - m_viewMinRpm);
+}
+
+double ChartPainter::binPixelWidth(const BinLayout &layout, const QRectF &chartRect) const
+{
+    return chartRect.width() * layout.binWidth / (m_viewMaxRpm - m_viewMinRpm);
+}
+
+ChartPainter::BinRange ChartPainter::visibleBins(const BinLayout &layout) const
+{
+    // Bin centres are evenly spaced, so the rows are found by direct index.
+    // Half a bin on either side takes in the envelopes cut by the edges and
+    // the median segments leading into the view.
+    BinRange range;
+    if (layout.binCount() == 0)
+        return range;
+
+    const double first = std::floor((m_viewMinRpm - layout.minRpm) / layout.binWidth - 0.5);
+    const double last = std::ceil((m_viewMaxRpm - layout.minRpm) / layout.binWidth + 0.5);
+    range.first = int(qBound(0.0, first, double(layout.binCount() - 1)));
+    range.last = int(qBound(0.0, last, double(layout.binCount() - 1)));
+    return range;
+}
+
+QList<double> ChartPainter::fuelFlowTicks() const
+{
+    return axisTicks(m_minFuelFlow, m_maxFuelFlow, FUEL_FLOW_INTERVALS);
+}
+
+const BinDecimator *ChartPainter::decimatedBins(Series &series, const QRectF &chartRect) const
+{
+    // One column per device pixel
+    const int columns = qCeil(chartRect.width() * m_devicePixelRatio);
+    if (series.bins.size() < 2
+        || !BinDecimator::isNeeded(series.bins.layout, m_viewMinRpm, m_viewMaxRpm, columns)) {
+        series.lod.clear();
+        return nullptr;
+    }
+
+    const BinRange visible = visibleBins(series.bins.layout);
+    series.lod.update(series.bins, visible.first, visible.last, m_dataVersion, m_viewMinRpm, m_viewMaxRpm, columns);
+    return &series.lod;
+}
+
+QColor ChartPainter::markerColor(const Series &series)
+{
+    // Engine markers are told apart by colour; the primary one shows eco mode
+    if (series.color.isValid())
+        return series.color;
+    return series.isEcoMode ? QColor(0, 200, 0) : QColor(255, 150, 0);
+}
+
+void ChartPainter::drawBackground(QPainter *painter) const
+{
+    painter->fillRect(QRectF(QPointF(0, 0), m_size), Qt::black);
+}
+
+void ChartPainter::drawGrid(QPainter *painter, const QRectF &chartRect) const
+{
+    ScopedTimer timer(Metrics::DrawGrid);
+
+    painter->setPen(QPen(QColor(100, 100, 100), 1, Qt::SolidLine));
+
+    // Only draw horizontal grid lines (Fuel Flow) at round values of the axis range
+    for (double flow : fuelFlowTicks()) {
+        double y = mapToChart(m_minRpm, flow, chartRect).y();
+        painter->drawLine(QPointF(chartRect.left(), y),
+                         QPointF(chartRect.right(), y));
+    }
+}
+
+void ChartPainter::drawAxes(QPainter *painter, const QRectF &chartRect) const
+{
+    ScopedTimer timer(Metrics::DrawAxes);
+
+    painter->setFont(m_font);
+
+    // X-axis in dark grey
+    painter->setPen(QPen(QColor(80, 80, 80), 2));
+    painter->drawLine(chartRect.bottomLeft(), chartRect.bottomRight());
+
+    // X-axis labels (RPM) - white color, at round values of the view so
+    // that the step follows the zoom level
+    painter->setPen(QPen(Qt::white, 1));
+    const QList<double> rpmTicks = axisTicks(m_viewMinRpm, m_viewMaxRpm, RPM_INTERVALS);
+    const double rpmStep = rpmTicks.size() > 1 ? rpmTicks.at(1) - rpmTicks.at(0) : 1.0;
+    for (double rpm : rpmTicks) {
+        double x = mapToChart(rpm, m_minFuelFlow, chartRect).x();
+        painter->drawText(QPointF(x - 15, chartRect.bottom() + 20),
+                         tickLabel(rpm, rpmStep));
+    }
+
+    // Y-axis labels (Fuel Flow) - moved to right side with white color, same values as the grid
+    for (double flow : fuelFlowTicks()) {
+        double y = mapToChart(m_minRpm, flow, chartRect).y();
+        painter->drawText(QPointF(chartRect.right() + 10, y + 5),
+                         QString::number(flow));
+    }
+
+    // Axis titles - dark grey color
+    painter->setPen(QPen(QColor(80, 80, 80), 1));
+
+    // Move Fuel Flow title to right side
+    painter->save();
+    painter->translate(chartRect.right() + 60, chartRect.center().y());
+    painter->rotate(-90);
+    painter->drawText(QPointF(-50, 0), "Fuel Flow (L/h)");
+    painter->restore();
+
+    painter->drawText(QPointF(chartRect.center().x() - 30, chartRect.bottom() + 50),
+                     "RPM");
+}
+
+void ChartPainter::drawDensity(QPainter *painter, const QRectF &chartRect, const DensityMap &density) const
+{
+    // One pixel per cell in view, stretched over the bins and the fuel flow
+    // range the grid covers
+    const BinLayout &layout = density.layout();
+    const BinRange visible = visibleBins(layout);
+    const int last = qMin(visible.last, density.rows() - 1);
+    const QImage image = density.toImage(visible.first, last);
+    if (image.isNull())
+        return;
+
+    const double halfBin = layout.binWidth / 2;
+    const QPointF topLeft = mapToChart(layout.binRpm(visible.first) - halfBin, layout.maxFuelFlow, chartRect);
+    const QPointF bottomRight = mapToChart(layout.binRpm(last) + halfBin, layout.minFuelFlow, chartRect);
+    painter->save();
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+    painter->drawImage(QRectF(topLeft, bottomRight), image);
+    painter->restore();
+}
+
+void ChartPainter::drawData(QPainter *painter, const QRectF &chartRect, Series &series) const
+{
+    const BinStore &bins = series.bins;
+    const QColor &color = series.color;
+    if (bins.size() < 2)
+        return;
+
+    // Enable antialiasing for smooth rounded corners
+    painter->setRenderHint(QPainter::Antialiasing, true);
+
+    // Bins narrower than a pixel are merged per column and filled as
+    // plain rectangles in a single call
+    if (const BinDecimator *lod = decimatedBins(series, chartRect)) {
+        const double columnWidth = chartRect.width() * lod->columnWidth() / (m_viewMaxRpm - m_viewMinRpm);
+        QList<QRectF> columns;
+        columns.reserve(lod->envelopeCount());
+        for (int i = 0; i < lod->envelopeCount(); ++i) {
+            const QPointF topCentre = mapToChart(lod->rpm().at(i), lod->maxFuelFlow().at(i), chartRect);
+            const double minY = mapToChart(lod->rpm().at(i), lod->minFuelFlow().at(i), chartRect).y();
+            columns.append(QRectF(topCentre.x() - columnWidth / 2, topCentre.y(), columnWidth, minY - topCentre.y()));
+        }
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(color.isValid() ? QColor(color.red(), color.green(), color.blue(), 48)
+                                          : QColor(70, 70, 70, 128));
+        painter->drawRects(columns.constData(), int(columns.size()));
+        painter->setBrush(Qt::NoBrush);
+        return;
+    }
+
+    // Each rectangle spans one bin of the layout; only the bins in view are drawn
+    const double rectWidth = binPixelWidth(bins.layout, chartRect);
+    const BinRange visible = visibleBins(bins.layout);
+    const double *rpms = bins.rpm.constData();
+    const double *minFlows = bins.minFuelFlow.constData();
+    const double *maxFlows = bins.maxFuelFlow.constData();
+    const int last = qMin(visible.last, bins.size() - 1);
+
+    for (int i = visible.first; i <= last; ++i) {
+        // Calculate rectangle position and dimensions
+        const QPointF topCentre = mapToChart(rpms[i], maxFlows[i], chartRect);
+        double x = topCentre.x() - rectWidth / 2;
+        double minY = mapToChart(rpms[i], minFlows[i], chartRect).y();
+        double maxY = topCentre.y();
+        double rectHeight = minY - maxY;
+
+        // Create the rectangle with 1.5 pixel gap on each side (3 pixels total gap between rectangles)
+        double gap = 1.5; // 1.5 pixels gap on each side
+        QRectF rect(x + gap, maxY, rectWidth - (gap * 2), rectHeight);
+
+        // Engine envelopes are a faint wash of their colour, without a border
+        if (color.isValid()) {
+            painter->setBrush(QColor(color.red(), color.green(), color.blue(), 48));
+            painter->setPen(Qt::NoPen);
+            painter->drawRoundedRect(rect, 2, 2);
+            continue;
+        }
+
+        // Create gradient for modern look - dark grey with 50% transparency
+        QLinearGradient gradient(rect.topLeft(), rect.bottomLeft());
+        gradient.setColorAt(0, QColor(80, 80, 80, 128));   // 50% transparent dark grey
+        gradient.setColorAt(0.5, QColor(70, 70, 70, 128)); // 50% transparent darker grey
+        gradient.setColorAt(1, QColor(60, 60, 60, 128));   // 50% transparent darkest grey
+
+        // Draw rectangle with gradient and rounded corners (smaller radius for smaller rectangles)
+        painter->setBrush(QBrush(gradient));
+        painter->setPen(QPen(QColor(50, 50, 50, 128), 1)); // 50% transparent dark border
+        painter->drawRoundedRect(rect, 2, 2); // 2px rounded corners for smaller rectangles
+    }
+
+    // Reset brush for other elements
+    painter->setBrush(Qt::NoBrush);
+}
+
+void ChartPainter::drawMedianLine(QPainter *painter, const QRectF &chartRect, Series &series) const
+{
+    const BinStore &bins = series.bins;
+    if (bins.size() < 2)
+        return;
+
+    // Through the bins in view, or their decimated median when there
+    // are more of them than pixels
+    const BinRange visible = visibleBins(bins.layout);
+    const BinDecimator *lod = decimatedBins(series, chartRect);
+    const double *rpms = lod ? lod->medianRpm().constData() : bins.rpm.constData();
+    const double *medians = lod ? lod->medianFuelFlow().constData() : bins.medianFuelFlow.constData();
+    const int first = lod ? 0 : visible.first;
+    const int last = lod ? lod->medianCount() - 1 : qMin(visible.last, bins.size() - 1);
+    if (last <= first)
+        return;
+
+    // Create median path
+    QPainterPath medianPath;
+    medianPath.moveTo(mapToChart(rpms[first], medians[first], chartRect));
+    for (int i = first + 1; i <= last; ++i)
+        medianPath.lineTo(mapToChart(rpms[i], medians[i], chartRect));
+
+    // Median line in white, or in the series' colour - made thinner
+    const QColor &color = series.color;
+    painter->setBrush(Qt::NoBrush);
+    painter->setPen(QPen(color.isValid() ? color : QColor(Qt::white), 1, Qt::SolidLine));
+    painter->drawPath(medianPath);
+}
+
+void ChartPainter::drawCurrentPoint(QPainter *painter, const QRectF &chartRect, const Series &series) const
+{
+    if (!hasMarker(series))
+        return;
+
+    // The marker sits at the ACTUAL current fuel flow
+    QPointF actualCurrentPoint = mapToChart(series.currentRpm, series.currentFuelFlow, chartRect);
+
+    // Smaller dot without white border
+    QColor pointColor = markerColor(series);
+    painter->setBrush(QBrush(pointColor));
+    painter->setPen(QPen(pointColor, 1)); // Use same color for border
+    painter->drawEllipse(actualCurrentPoint, MARKER_RADIUS, MARKER_RADIUS);
+}
+
+void ChartPainter::render(QPainter *painter, Series &series) const
+{
+    const QRectF rect = chartRect();
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    drawBackground(painter);
+    drawGrid(painter, rect);
+    drawAxes(painter, rect);
+
+    painter->setClipRect(plotColumns(rect), Qt::IntersectClip);
+    drawData(painter, rect, series);
+    drawMedianLine(painter, rect, series);
+    drawCurrentPoint(painter, rect, series);
+    painter->restore();
+}
@@ -0,0 +1,123 @@
+#ifndef CHARTPAINTER_H
+#define CHARTPAINTER_H
+
+#include <QColor>
+#include <QFont>
+#include <QList>
+#include <QPainter>
+#include <QRectF>
+#include <QSizeF>
+#include <limits>
+#include "bindecimator.h"
+#include "binstore.h"
+#include "densitymap.h"
+
+// Draws the chart with QPainter: axes, grid, and the envelope, median and
+// marker of each series. It is no QObject and touches no window, so any
+// thread may own one. ChartRenderer paints and renders through its own;
+// ReportExporter keeps one per worker thread.
+class ChartPainter
+{
+public:
+    // Inclusive range of bin rows
+    struct BinRange {
+        int first = std::numeric_limits<int>::max();
+        int last = -1;
+
+        bool isEmpty() const { return last < first; }
+        void unite(int from, int to)
+        {
+            first = qMin(first, from);
+            last = qMax(last, to);
+        }
+        void clear() { *this = BinRange(); }
+    };
+
+    // What is drawn of one curve: its bins and live point. A series
+    // without a colour keeps the classic look.
+    struct Series {
+        bool reference = false;             // Bins only, no live point
+        BinStore bins;
+        QColor color;
+        double currentRpm = 1500.0;
+        double currentFuelFlow = 15.0;
+        bool isEcoMode = false;
+        BinDecimator lod;                   // Visible bins merged per pixel column
+    };
+
+    ChartPainter();
+
+    // Size of the whole chart, margins and axis labels included
+    QSizeF size() const { return m_size; }
+    void setSize(const QSizeF &size) { m_size = size; }
+
+    double minRpm() const { return m_minRpm; }
+    double maxRpm() const { return m_maxRpm; }
+    void setRpmRange(double minRpm, double maxRpm);
+
+    // The part of the RPM axis that is drawn, within minRpm..maxRpm
+    double viewMinRpm() const { return m_viewMinRpm; }
+    double viewMaxRpm() const { return m_viewMaxRpm; }
+    void setViewRange(double minRpm, double maxRpm);
+
+    double minFuelFlow() const { return m_minFuelFlow; }
+    double maxFuelFlow() const { return m_maxFuelFlow; }
+    void setFuelFlowRange(double minFuelFlow, double maxFuelFlow);
+
+    const QFont &font() const { return m_font; }
+
+    // Bins are decimated to one column per device pixel
+    void setDevicePixelRatio(qreal devicePixelRatio) { m_devicePixelRatio = devicePixelRatio; }
+
+    // Identifies the contents of every series' bins; changing any of them
+    // must change it, or a stale decimation is drawn
+    void setDataVersion(quint64 version) { m_dataVersion = version; }
+
+    QRectF chartRect() const;
+    QRectF plotColumns(const QRectF &chartRect) const;  // Full height, chart width
+    QPointF mapToChart(double rpm, double fuelFlow, const QRectF &chartRect) const;
+    double rpmAt(double x, const QRectF &chartRect) const;
+    double binPixelWidth(const BinLayout &layout, const QRectF &chartRect) const;
+    BinRange visibleBins(const BinLayout &layout) const;
+    QList<double> fuelFlowTicks() const;
+
+    // The series' visible bins merged per pixel column, or null while every
+    // bin is at least a pixel wide
+    const BinDecimator *decimatedBins(Series &series, const QRectF &chartRect) const;
+
+    static QColor markerColor(const Series &series);
+    static bool hasMarker(const Series &series) { return !series.reference && !series.bins.isEmpty(); }
+
+    // From the bottom up: background, grid, axes, then clipped to the plot
+    // columns the density, each series' envelope, each median and each marker
+    void drawBackground(QPainter *painter) const;
+    void drawGrid(QPainter *painter, const QRectF &chartRect) const;
+    void drawAxes(QPainter *painter, const QRectF &chartRect) const;
+    void drawDensity(QPainter *painter, const QRectF &chartRect, const DensityMap &density) const;
+    void drawData(QPainter *painter, const QRectF &chartRect, Series &series) const;
+    void drawMedianLine(QPainter *painter, const QRectF &chartRect, Series &series) const;
+    void drawCurrentPoint(QPainter *painter, const QRectF &chartRect, const Series &series) const;
+
+    // The whole chart of a single series, in the order above
+    void render(QPainter *painter, Series &series) const;
+
+    // Chart styling
+    static constexpr int MARGIN = 60;
+    static constexpr int MARKER_RADIUS = 6;
+    static constexpr int FUEL_FLOW_INTERVALS = 4;   // Approximate grid lines per axis
+    static constexpr int RPM_INTERVALS = 6;
+
+private:
+    QSizeF m_size;
+    double m_minRpm;
+    double m_maxRpm;
+    double m_viewMinRpm;
+    double m_viewMaxRpm;
+    double m_minFuelFlow;
+    double m_maxFuelFlow;
+    QFont m_font;
+    qreal m_devicePixelRatio;
+    quint64 m_dataVersion;
+};
+
+#endif // CHARTPAINTER_H
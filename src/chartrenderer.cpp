@@ -1,269 +1,1377 @@
 #include "chartrenderer.h"
+#include "densitymaterial.h"
+#include "metrics.h"
 #include <QPainter>
 #include <QPen>
 #include <QBrush>
 #include <QFont>
 #include <QFontMetrics>
 #include <QtMath>
-#include <QPainterPath>
+#include <QLineF>
+#include <QQuickWindow>
+#include <QSGFlatColorMaterial>
+#include <QSGVertexColorMaterial>
+#include <QSGSimpleRectNode>
+#include <QSGImageNode>
+#include <QSGRendererInterface>
+#include <QSGClipNode>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include <QTouchEvent>
+#include <iterator>
+
+namespace {
+
+// Root of the chart's node tree. Each layer lives in its own child node so
+// that only the layers whose inputs changed are rebuilt on a sync.
+class ChartSceneNode : public QSGNode
+{
+public:
+    struct PaintedMarker {
+        QSGImageNode *image = nullptr;
+        QSGTexture *texture = nullptr;
+        QColor color;
+    };
+
+    ~ChartSceneNode() override
+    {
+        delete texture;
+        for (const PaintedMarker &marker : std::as_const(markers))
+            delete marker.texture;
+        delete metricsTexture;
+    }
+
+    ChartRenderer::RenderMode mode = ChartRenderer::SceneGraph;
+    QSGSimpleRectNode *background = nullptr;
+    QSGGeometryNode *grid = nullptr;
+    QSGGeometryNode *density = nullptr; // Density heatmap, one textured quad
+    QSGImageNode *image = nullptr;      // Axes layer, or the whole chart when painted
+    QSGClipNode *plot = nullptr;        // Clips the layers below to the visible RPM range
+    QSGGeometryNode *bins = nullptr;    // Envelopes of every series in one draw
+    QSGGeometryNode *median = nullptr;  // Median lines of every series in one draw
+    QSGGeometryNode *marker = nullptr;  // Markers of every series in one draw
+    QSGTexture *texture = nullptr;      // Owned texture shown by image
+    qint64 imageCacheKey = 0;           // QImage::cacheKey() of that texture
+
+    // Painted mode: one pre-rasterized marker disc per series, re-created
+    // on colour change
+    QList<PaintedMarker> markers;
+
+    // Optional metrics overlay, on top of everything else
+    QSGImageNode *metrics = nullptr;
+    QSGTexture *metricsTexture = nullptr;
+};
+
+QSGGeometryNode *createGeometryNode(const QSGGeometry::AttributeSet &attributes,
+                                    unsigned int drawingMode, QSGMaterial *material)
+{
+    auto *geometry = new QSGGeometry(attributes, 0);
+    geometry->setDrawingMode(drawingMode);
+
+    auto *node = new QSGGeometryNode;
+    node->setGeometry(geometry);
+    node->setFlag(QSGNode::OwnsGeometry);
+    node->setMaterial(material);
+    node->setFlag(QSGNode::OwnsMaterial);
+    return node;
+}
+
+QSGFlatColorMaterial *createFlatColorMaterial(const QColor &color)
+{
+    auto *material = new QSGFlatColorMaterial;
+    material->setColor(color);
+    return material;
+}
+
+void setImageTexture(ChartSceneNode *node, QSGTexture *texture, const QRectF &rect)
+{
+    node->image->setTexture(texture);
+    node->image->setRect(rect);
+    delete node->texture;
+    node->texture = texture;
+}
+
+// Colours of the engine series, in engine order
+const QColor SERIES_COLORS[] = {
+    QColor(0, 170, 255),
+    QColor(255, 90, 120),
+    QColor(170, 120, 255),
+    QColor(255, 210, 0),
+};
+
+// Muted, so the reference stays in the background
+const QColor REFERENCE_COLOR(150, 170, 200);
+
+QColor seriesColor(int engine)
+{
+    return SERIES_COLORS[engine % int(std::size(SERIES_COLORS))];
+}
+
+// Vertices of the series' visible bins, first..last of the view clamped
+// to the series' own size
+int envelopeVertexCount(const BinStore &bins, int first, int last)
+{
+    return bins.size() < 2 ? 0 : qMax(0, qMin(last, bins.size() - 1) - first + 1) * 6;
+}
+
+int medianVertexCount(const BinStore &bins, int first, int last)
+{
+    return bins.size() < 2 ? 0 : qMax(0, qMin(last, bins.size() - 1) - first) * 2;
+}
+
+} // namespace
 
 ChartRenderer::ChartRenderer(QQuickItem *parent)
-    : QQuickPaintedItem(parent)
-    , m_currentRpm(1500.0)
-    , m_currentFuelFlow(15.0)
-    , m_isEcoMode(false)
-    , m_minRpm(0.0)
-    , m_maxRpm(6000.0)
-    , m_minFuelFlow(0.0)
-    , m_maxFuelFlow(80.0)
+    : QQuickItem(parent)
+    , m_series(1)
+    , m_dragX(0.0)
+    , m_touchSpread(0.0)
+    , m_touchPointCount(0)
+    , m_renderMode(SceneGraph)
+    , m_dirty(AllDirty)
+    , m_dataVersion(0)
+    , m_showMetrics(false)
+    , m_showDensity(false)
+    , m_lastRepaints(0)
+    , m_lastUpdateRequests(0)
+    , m_maxFps(0.0)
+    , m_redrawThreshold(1.0)
 {
+    setFlag(ItemHasContents, true);
     setAntialiasing(true);
+    setAcceptedMouseButtons(Qt::LeftButton);
+    setAcceptTouchEvents(true);
+
+    m_metricsTimer.setInterval(METRICS_REFRESH_MS);
+    connect(&m_metricsTimer, &QTimer::timeout, this, &ChartRenderer::refreshMetrics);
+
+    m_governorTimer.setSingleShot(true);
+    m_governorTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_governorTimer, &QTimer::timeout, this, &ChartRenderer::scheduleMarkerUpdate);
 }
 
 void ChartRenderer::paint(QPainter *painter)
 {
-    if (m_dataPoints.isEmpty())
+    ScopedTimer timer(Metrics::Paint);
+
+    if (!hasBins())
         return;
 
+    // Everything except the marker only changes on resize or model reset,
+    // so live updates composite the cached layer and draw a single ellipse
+    painter->drawImage(QPointF(0, 0), staticLayer(painter->device()->devicePixelRatioF()));
+
     painter->setRenderHint(QPainter::Antialiasing, true);
-    
-    // Fill background with black
-    painter->fillRect(boundingRect(), Qt::black);
-    
+    painter->save();
+    painter->setClipRect(plotColumns(chartRect()), Qt::IntersectClip);
+    drawCurrentPoint(painter, chartRect());
+    painter->restore();
+
+    if (m_showMetrics)
+        drawMetricsOverlay(painter, metricsRect());
+}
+
+const QImage &ChartRenderer::staticLayer(qreal devicePixelRatio)
+{
+    const LayerKey key { (size() * devicePixelRatio).toSize(), devicePixelRatio, m_dataVersion };
+    if (!m_staticLayer.isNull() && key == m_staticLayerKey)
+        return m_staticLayer;
+
+    ScopedTimer timer(Metrics::StaticLayer);
+
+    // When only some bins changed, the layer is repainted in place within
+    // their columns; anything else re-renders it completely
+    const bool partial = !m_staticLayer.isNull() && !m_layerDirtyBins.isEmpty()
+        && key.pixelSize == m_staticLayerKey.pixelSize
+        && qFuzzyCompare(key.devicePixelRatio, m_staticLayerKey.devicePixelRatio);
+    if (!partial) {
+        m_staticLayer = QImage(key.pixelSize, QImage::Format_ARGB32_Premultiplied);
+        m_staticLayer.setDevicePixelRatio(devicePixelRatio);
+    }
+
+    QPainter painter(&m_staticLayer);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+
     // Define chart area (excluding margins only - no legend)
-    QRectF chartRect(MARGIN, MARGIN, 
-                     width() - 2 * MARGIN, 
-                     height() - 2 * MARGIN);
+    const QRectF rect = chartRect();
+
+    if (partial)
+        painter.setClipRect(binColumns(m_layerDirtyBins, rect).toAlignedRect());
+
+    // Fill background with black
+    m_chart.drawBackground(&painter);
 
     // Draw chart components
-    drawGrid(painter, chartRect);
-    drawAxes(painter, chartRect);
-    drawData(painter, chartRect);
-    drawCurrentPoint(painter, chartRect);
-    
+    m_chart.drawGrid(&painter, rect);
+    m_chart.drawAxes(&painter, rect);
+
+    // Bins cut by the edges of the view must not spill into the margins
+    painter.setClipRect(plotColumns(rect), partial ? Qt::IntersectClip : Qt::ReplaceClip);
+    drawData(&painter, rect);
+
     // Draw median line separately to ensure it's always visible
-    drawMedianLine(painter, chartRect);
+    drawMedianLine(&painter, rect);
+    painter.end();
+
+    m_staticLayerKey = key;
+    m_layerDirtyBins.clear();
+    return m_staticLayer;
+}
+
+void ChartRenderer::invalidateStaticLayer()
+{
+    m_staticLayer = QImage();
+    m_layerDirtyBins.clear();
 }
 
-void ChartRenderer::setDataPoints(const QVariantList &dataPoints)
+QRectF ChartRenderer::binColumns(const BinRange &range, const QRectF &chartRect) const
 {
-    if (m_dataPoints != dataPoints) {
-        m_dataPoints = dataPoints;
-        emit dataPointsChanged();
-        update();
+    // Neighbouring bins are included because they share median segments
+    // with the changed ones; the margin covers antialiasing and pen width
+    const BinLayout layout = binLayout();
+    const int first = qMax(0, range.first - 1);
+    const int last = qMin(layout.binCount() - 1, range.last + 1);
+    const double halfBin = binPixelWidth(chartRect) / 2 + 2;
+    const double left = mapToChart(layout.binRpm(first), m_chart.minFuelFlow(), chartRect).x() - halfBin;
+    const double right = mapToChart(layout.binRpm(last), m_chart.minFuelFlow(), chartRect).x() + halfBin;
+    return QRectF(left, 0, right - left, height());
+}
+
+bool ChartRenderer::hasBins() const
+{
+    for (const Series &series : m_series) {
+        if (!series.bins.isEmpty())
+            return true;
     }
+    return false;
 }
 
-void ChartRenderer::setCurrentRpm(double rpm)
+BinLayout ChartRenderer::binLayout() const
 {
-    if (!qFuzzyCompare(m_currentRpm, rpm)) {
-        m_currentRpm = rpm;
-        emit currentRpmChanged();
-        update();
+    // Every series of a chart shares one layout, but the vessel total is
+    // empty while its engines are being re-laid out one by one
+    for (const Series &series : m_series) {
+        if (!series.bins.isEmpty())
+            return series.bins.layout;
     }
+    return BinLayout();
 }
 
-void ChartRenderer::setCurrentFuelFlow(double fuelFlow)
+QSGNode *ChartRenderer::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data)
+{
+    Q_UNUSED(data)
+
+    ScopedTimer timer(Metrics::SceneGraphSync);
+    Metrics::add(Metrics::Repaints);
+
+    if (!hasBins() || width() <= 0 || height() <= 0) {
+        delete oldNode;
+        return nullptr;
+    }
+
+    // The software backend cannot render custom geometry, so it always paints
+    RenderMode mode = m_renderMode;
+    if (window()->rendererInterface()->graphicsApi() == QSGRendererInterface::Software)
+        mode = Painted;
+
+    auto *node = static_cast<ChartSceneNode *>(oldNode);
+    if (node && node->mode != mode) {
+        delete node;
+        node = nullptr;
+    }
+
+    auto *result = static_cast<ChartSceneNode *>(mode == Painted ? updatePaintedNode(node)
+                                                                  : updateSceneGraphNode(node));
+
+    if (!m_showMetrics && result->metrics) {
+        result->removeChildNode(result->metrics);
+        delete result->metrics;
+        delete result->metricsTexture;
+        result->metrics = nullptr;
+        result->metricsTexture = nullptr;
+    } else if (m_showMetrics && (!result->metrics || (m_dirty & MetricsDirty))) {
+        if (!result->metrics) {
+            result->metrics = window()->createImageNode();
+            result->appendChildNode(result->metrics);
+        }
+
+        QSGTexture *texture = window()->createTextureFromImage(
+            renderMetricsImage(window()->effectiveDevicePixelRatio()));
+        result->metrics->setTexture(texture);
+        result->metrics->setRect(metricsRect());
+        delete result->metricsTexture;
+        result->metricsTexture = texture;
+    }
+
+    m_dirty = 0;
+    m_densityDirtyRows.clear();
+    return result;
+}
+
+QSGNode *ChartRenderer::updateSceneGraphNode(QSGNode *oldNode)
+{
+    auto *node = static_cast<ChartSceneNode *>(oldNode);
+    int dirty = m_dirty;
+
+    if (!node) {
+        node = new ChartSceneNode;
+        node->mode = SceneGraph;
+        node->background = new QSGSimpleRectNode(boundingRect(), Qt::black);
+        node->grid = createGeometryNode(QSGGeometry::defaultAttributes_Point2D(),
+                                        QSGGeometry::DrawLines,
+                                        createFlatColorMaterial(QColor(100, 100, 100)));
+        node->image = window()->createImageNode();
+        auto *densityMaterial = new DensityMaterial;
+        densityMaterial->setPalette(window()->createTextureFromImage(DensityMap::palette()));
+        node->density = createGeometryNode(QSGGeometry::defaultAttributes_TexturedPoint2D(),
+                                           QSGGeometry::DrawTriangleStrip, densityMaterial);
+        // Per-vertex colours let all series share one node, and so one
+        // draw call, per layer however many engines there are
+        node->bins = createGeometryNode(QSGGeometry::defaultAttributes_ColoredPoint2D(),
+                                        QSGGeometry::DrawTriangles,
+                                        new QSGVertexColorMaterial);
+        node->median = createGeometryNode(QSGGeometry::defaultAttributes_ColoredPoint2D(),
+                                          QSGGeometry::DrawLines,
+                                          new QSGVertexColorMaterial);
+        node->marker = createGeometryNode(QSGGeometry::defaultAttributes_ColoredPoint2D(),
+                                          QSGGeometry::DrawTriangles,
+                                          new QSGVertexColorMaterial);
+        node->plot = new QSGClipNode;
+        node->plot->setGeometry(new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), 4));
+        node->plot->setFlag(QSGNode::OwnsGeometry);
+        node->plot->setIsRectangular(true);
+
+        // Same stacking order as paint()
+        node->appendChildNode(node->background);
+        node->appendChildNode(node->grid);
+        node->appendChildNode(node->image);
+        node->appendChildNode(node->plot);
+        node->plot->appendChildNode(node->density);
+        node->plot->appendChildNode(node->bins);
+        node->plot->appendChildNode(node->median);
+        node->plot->appendChildNode(node->marker);
+        dirty = AllDirty;
+    }
+
+    const QRectF rect = chartRect();
+
+    if (dirty & GridDirty) {
+        node->background->setRect(boundingRect());
+        updateGridGeometry(node->grid, rect);
+        setImageTexture(node, window()->createTextureFromImage(renderAxesImage()), boundingRect());
+
+        const QRectF plot = plotColumns(rect);
+        QSGGeometry::updateRectGeometry(node->plot->geometry(), plot);
+        node->plot->setClipRect(plot);
+        node->plot->markDirty(QSGNode::DirtyGeometry);
+    }
+
+    if (dirty & (GridDirty | DensityDirty))
+        updateDensityNode(node->density, rect);
+
+    // A new node, resize, axis or view change moves every vertex
+    const bool full = dirty & GridDirty;
+
+    if (dirty & BinsDirty)
+        updateBinsGeometry(node->bins, rect, full);
+
+    if (dirty & MedianDirty)
+        updateMedianGeometry(node->median, rect, full);
+
+    for (Series &series : m_series)
+        series.geometryDirtyBins.clear();
+
+    if (dirty & MarkerDirty)
+        updateMarkerGeometry(node->marker, rect);
+
+    return node;
+}
+
+QSGNode *ChartRenderer::updatePaintedNode(QSGNode *oldNode)
+{
+    auto *node = static_cast<ChartSceneNode *>(oldNode);
+    if (!node) {
+        node = new ChartSceneNode;
+        node->mode = Painted;
+        node->image = window()->createImageNode();
+        node->appendChildNode(node->image);
+    }
+
+    const qreal dpr = window()->effectiveDevicePixelRatio();
+
+    // Only re-upload the static layer when the cache actually re-rendered it
+    const QImage &layer = staticLayer(dpr);
+    if (node->imageCacheKey != layer.cacheKey()) {
+        setImageTexture(node, window()->createTextureFromImage(layer), boundingRect());
+        node->imageCacheKey = layer.cacheKey();
+    }
+
+    // Marker nodes follow the series, the primary one last so it stays on top
+    while (node->markers.size() > m_series.size()) {
+        const ChartSceneNode::PaintedMarker marker = node->markers.takeLast();
+        node->removeChildNode(marker.image);
+        delete marker.image;
+        delete marker.texture;
+    }
+    while (node->markers.size() < m_series.size()) {
+        ChartSceneNode::PaintedMarker marker;
+        marker.image = window()->createImageNode();
+        node->insertChildNodeAfter(marker.image, node->image);
+        node->markers.append(marker);
+    }
+
+    const double extent = MARKER_RADIUS + 1;
+    for (int i = 0; i < m_series.size(); ++i) {
+        const Series &series = m_series.at(i);
+        ChartSceneNode::PaintedMarker &marker = node->markers[i];
+        const QColor pointColor = markerColor(series);
+        if (!marker.texture || marker.color != pointColor) {
+            QImage disc((QSizeF(2 * extent, 2 * extent) * dpr).toSize(), QImage::Format_ARGB32_Premultiplied);
+            disc.setDevicePixelRatio(dpr);
+            disc.fill(Qt::transparent);
+
+            QPainter painter(&disc);
+            painter.setRenderHint(QPainter::Antialiasing, true);
+            painter.setBrush(QBrush(pointColor));
+            painter.setPen(QPen(pointColor, 1));
+            painter.drawEllipse(QPointF(extent, extent), MARKER_RADIUS, MARKER_RADIUS);
+            painter.end();
+
+            QSGTexture *texture = window()->createTextureFromImage(disc);
+            marker.image->setTexture(texture);
+            delete marker.texture;
+            marker.texture = texture;
+            marker.color = pointColor;
+        }
+
+        // Series without bins or a live point, or outside the view, have nothing to mark
+        const QPointF position = mapToChart(series.currentRpm, series.currentFuelFlow, chartRect());
+        const bool visible = series.currentRpm >= m_chart.viewMinRpm() && series.currentRpm <= m_chart.viewMaxRpm();
+        marker.image->setRect(!hasMarker(series) || !visible
+                                  ? QRectF()
+                                  : QRectF(position.x() - extent, position.y() - extent, 2 * extent, 2 * extent));
+    }
+    return node;
+}
+
+void ChartRenderer::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+
+    if (newGeometry.size() != oldGeometry.size()) {
+        m_chart.setSize(newGeometry.size());
+        markDirty(AllDirty);
+    }
+}
+
+void ChartRenderer::itemChange(ItemChange change, const ItemChangeData &value)
+{
+    QQuickItem::itemChange(change, value);
+
+    // Cached layers are rasterized, and bins decimated, at the window's
+    // device pixel ratio
+    if (change == ItemDevicePixelRatioHasChanged) {
+        m_chart.setDevicePixelRatio(window()->effectiveDevicePixelRatio());
+        markDirty(AllDirty);
+    }
+
+    if (change == ItemSceneChange) {
+        m_chart.setDevicePixelRatio(value.window ? value.window->effectiveDevicePixelRatio() : 1.0);
+        trackFrameInterval(value.window);
+    }
+}
+
+void ChartRenderer::markDirty(int flags)
+{
+    m_dirty |= flags;
+
+    if (flags & MarkerDirty) {
+        const QRectF rect = chartRect();
+        for (Series &series : m_series) {
+            series.drawnMarkerPosition = mapToChart(series.currentRpm, series.currentFuelFlow, rect);
+            series.drawnMarkerColor = markerColor(series);
+        }
+    }
+
+    Metrics::add(Metrics::UpdateRequests);
+    update();
+}
+
+void ChartRenderer::updateGridGeometry(QSGGeometryNode *node, const QRectF &chartRect)
+{
+    // Same horizontal lines as ChartPainter::drawGrid()
+    const QList<double> ticks = m_chart.fuelFlowTicks();
+
+    QSGGeometry *geometry = node->geometry();
+    geometry->allocate(int(ticks.size()) * 2);
+    QSGGeometry::Point2D *vertices = geometry->vertexDataAsPoint2D();
+
+    int i = 0;
+    for (double flow : ticks) {
+        const float y = mapToChart(m_chart.minRpm(), flow, chartRect).y();
+        vertices[i++].set(chartRect.left(), y);
+        vertices[i++].set(chartRect.right(), y);
+    }
+
+    node->markDirty(QSGNode::DirtyGeometry);
+}
+
+void ChartRenderer::updateBinsGeometry(QSGGeometryNode *node, const QRectF &chartRect, bool full)
+{
+    QSGGeometry *geometry = node->geometry();
+    const BinRange visible = visibleBins();
+    int vertexCount = 0;
+    for (Series &series : m_series) {
+        if (!drawsEnvelope(series))
+            continue;
+        const BinDecimator *lod = decimatedBins(series, chartRect);
+        vertexCount += lod ? lod->envelopeCount() * 6 : envelopeVertexCount(series.bins, visible.first, visible.last);
+    }
+
+    // Only the visible bins have vertices, so a zoomed in chart costs what
+    // it shows. Rewrite only the changed ones while no series changed its
+    // bin count.
+    if (geometry->vertexCount() != vertexCount) {
+        geometry->allocate(vertexCount);
+        full = true;
+    }
+    QSGGeometry::ColoredPoint2D *vertices = geometry->vertexDataAsColoredPoint2D();
+
+    // Same layout as ChartPainter::drawData(); the vertex colours reproduce
+    // its vertical gradient, premultiplied as QSGVertexColorMaterial expects
+    const double binWidth = binPixelWidth(chartRect);
+
+    // Engines first, so the primary series ends up on top
+    for (int s = m_series.size() - 1; s >= 0; --s) {
+        Series &series = m_series[s];
+        if (!drawsEnvelope(series))
+            continue;
+
+        // Merged columns are no more than the chart is wide, so they are
+        // rewritten whole; bins are indexed from the first visible one
+        const BinDecimator *lod = decimatedBins(series, chartRect);
+        const bool rewrite = full || lod;
+        const int base = lod ? 0 : visible.first;
+        const int binCount = lod ? lod->envelopeCount()
+                                 : envelopeVertexCount(series.bins, visible.first, visible.last) / 6;
+        const int end = base + binCount - 1;
+        const int first = rewrite ? base : qMax(base, series.geometryDirtyBins.first);
+        const int last = rewrite ? end : qMin(end, series.geometryDirtyBins.last);
+        const double *rpms = lod ? lod->rpm().constData() : series.bins.rpm.constData();
+        const double *minFlows = lod ? lod->minFuelFlow().constData() : series.bins.minFuelFlow.constData();
+        const double *maxFlows = lod ? lod->maxFuelFlow().constData() : series.bins.maxFuelFlow.constData();
+        const double rectWidth = lod ? chartRect.width() * lod->columnWidth()
+                                           / (m_chart.viewMaxRpm() - m_chart.viewMinRpm())
+                                     : binWidth;
+        const double gap = lod ? 0.0 : 1.5;
+
+        // Engine envelopes are a faint wash of their colour
+        const int alpha = series.color.isValid() ? 48 : 128;
+        const QColor top = series.color.isValid() ? series.color : QColor(80, 80, 80);
+        const QColor bottom = series.color.isValid() ? series.color : QColor(60, 60, 60);
+        const uchar topR = top.red() * alpha / 255, topG = top.green() * alpha / 255, topB = top.blue() * alpha / 255;
+        const uchar bottomR = bottom.red() * alpha / 255, bottomG = bottom.green() * alpha / 255,
+                    bottomB = bottom.blue() * alpha / 255;
+
+        for (int i = first; i <= last; ++i) {
+            const QPointF topCentre = mapToChart(rpms[i], maxFlows[i], chartRect);
+            const float left = topCentre.x() - rectWidth / 2 + gap;
+            const float right = left + rectWidth - gap * 2;
+            const float y1 = topCentre.y();
+            const float y2 = mapToChart(rpms[i], minFlows[i], chartRect).y();
+
+            QSGGeometry::ColoredPoint2D *v = vertices + (i - base) * 6;
+            v[0].set(left, y1, topR, topG, topB, alpha);
+            v[1].set(right, y1, topR, topG, topB, alpha);
+            v[2].set(left, y2, bottomR, bottomG, bottomB, alpha);
+            v[3].set(left, y2, bottomR, bottomG, bottomB, alpha);
+            v[4].set(right, y1, topR, topG, topB, alpha);
+            v[5].set(right, y2, bottomR, bottomG, bottomB, alpha);
+        }
+        vertices += binCount * 6;
+    }
+
+    node->markDirty(QSGNode::DirtyGeometry);
+}
+
+void ChartRenderer::updateMedianGeometry(QSGGeometryNode *node, const QRectF &chartRect, bool full)
+{
+    QSGGeometry *geometry = node->geometry();
+    const BinRange visible = visibleBins();
+    int vertexCount = 0;
+    for (Series &series : m_series) {
+        const BinDecimator *lod = decimatedBins(series, chartRect);
+        vertexCount += lod ? qMax(0, lod->medianCount() - 1) * 2
+                           : medianVertexCount(series.bins, visible.first, visible.last);
+    }
+
+    if (geometry->vertexCount() != vertexCount) {
+        geometry->allocate(vertexCount);
+        full = true;
+    }
+    QSGGeometry::ColoredPoint2D *vertices = geometry->vertexDataAsColoredPoint2D();
+
+    // Separate segments instead of a strip, so that every series fits into
+    // one node; a bin moves the segments on either side of it
+    for (int s = m_series.size() - 1; s >= 0; --s) {
+        Series &series = m_series[s];
+        const BinDecimator *lod = decimatedBins(series, chartRect);
+        const bool rewrite = full || lod;
+        const int base = lod ? 0 : visible.first;
+        const int segmentCount = lod ? qMax(0, lod->medianCount() - 1)
+                                     : medianVertexCount(series.bins, visible.first, visible.last) / 2;
+        const int end = base + segmentCount - 1;
+        const int first = rewrite ? base : qMax(base, series.geometryDirtyBins.first - 1);
+        const int last = rewrite ? end : qMin(end, series.geometryDirtyBins.last);
+        const double *rpms = lod ? lod->medianRpm().constData() : series.bins.rpm.constData();
+        const double *medians = lod ? lod->medianFuelFlow().constData() : series.bins.medianFuelFlow.constData();
+        const QColor color = series.color.isValid() ? series.color : QColor(Qt::white);
+
+        for (int i = first; i <= last; ++i) {
+            const QPointF from = mapToChart(rpms[i], medians[i], chartRect);
+            const QPointF to = mapToChart(rpms[i + 1], medians[i + 1], chartRect);
+            QSGGeometry::ColoredPoint2D *v = vertices + (i - base) * 2;
+            v[0].set(from.x(), from.y(), color.red(), color.green(), color.blue(), 255);
+            v[1].set(to.x(), to.y(), color.red(), color.green(), color.blue(), 255);
+        }
+        vertices += segmentCount * 2;
+    }
+
+    node->markDirty(QSGNode::DirtyGeometry);
+}
+
+void ChartRenderer::updateMarkerGeometry(QSGGeometryNode *node, const QRectF &chartRect)
+{
+    QSGGeometry *geometry = node->geometry();
+    int markerCount = 0;
+    for (const Series &series : std::as_const(m_series))
+        markerCount += hasMarker(series) ? 1 : 0;
+
+    if (geometry->vertexCount() != markerCount * MARKER_SEGMENTS * 3)
+        geometry->allocate(markerCount * MARKER_SEGMENTS * 3);
+    QSGGeometry::ColoredPoint2D *vertices = geometry->vertexDataAsColoredPoint2D();
+
+    // Reverse order puts the primary marker on top of the engine markers
+    for (int s = m_series.size() - 1; s >= 0; --s) {
+        const Series &series = m_series.at(s);
+        if (!hasMarker(series))
+            continue;
+
+        const QPointF centre = mapToChart(series.currentRpm, series.currentFuelFlow, chartRect);
+        const QColor color = markerColor(series);
+        for (int i = 0; i < MARKER_SEGMENTS; ++i) {
+            const double a1 = 2.0 * M_PI * i / MARKER_SEGMENTS;
+            const double a2 = 2.0 * M_PI * (i + 1) / MARKER_SEGMENTS;
+            vertices[0].set(centre.x(), centre.y(), color.red(), color.green(), color.blue(), 255);
+            vertices[1].set(centre.x() + MARKER_RADIUS * qCos(a1), centre.y() + MARKER_RADIUS * qSin(a1),
+                            color.red(), color.green(), color.blue(), 255);
+            vertices[2].set(centre.x() + MARKER_RADIUS * qCos(a2), centre.y() + MARKER_RADIUS * qSin(a2),
+                            color.red(), color.green(), color.blue(), 255);
+            vertices += 3;
+        }
+    }
+
+    node->markDirty(QSGNode::DirtyGeometry);
+}
+
+void ChartRenderer::updateDensityNode(QSGGeometryNode *node, const QRectF &chartRect)
 {
-    if (!qFuzzyCompare(m_currentFuelFlow, fuelFlow)) {
-        m_currentFuelFlow = fuelFlow;
-        emit currentFuelFlowChanged();
-        update();
+    QSGGeometry *geometry = node->geometry();
+    if (m_density.isEmpty()) {
+        if (geometry->vertexCount() != 0) {
+            geometry->allocate(0);
+            node->markDirty(QSGNode::DirtyGeometry);
+        }
+        return;
+    }
+
+    // Only changed rows are uploaded; the shader colours them with the
+    // current maximum
+    auto *material = static_cast<DensityMaterial *>(node->material());
+    const QSize size(m_density.columns(), m_density.rows());
+    if (material->levels()->textureSize() != size || !m_densityDirtyRows.isEmpty()
+        || material->maxLevel() != m_density.maxLevel()) {
+        material->levels()->setLevels(m_density.levels(), size.width(), size.height(),
+                                      m_densityDirtyRows.first, m_densityDirtyRows.last);
+        material->setMaxLevel(m_density.maxLevel());
+        node->markDirty(QSGNode::DirtyMaterial);
     }
+
+    // Texture rows run along the RPM axis, columns up the fuel flow axis
+    const BinLayout &layout = m_density.layout();
+    const double halfBin = layout.binWidth / 2;
+    const QPointF topLeft = mapToChart(layout.binRpm(0) - halfBin, layout.maxFuelFlow, chartRect);
+    const QPointF bottomRight = mapToChart(layout.binRpm(m_density.rows() - 1) + halfBin, layout.minFuelFlow,
+                                           chartRect);
+    if (geometry->vertexCount() != 4)
+        geometry->allocate(4);
+    QSGGeometry::TexturedPoint2D *vertices = geometry->vertexDataAsTexturedPoint2D();
+    vertices[0].set(topLeft.x(), bottomRight.y(), 0, 0);
+    vertices[1].set(topLeft.x(), topLeft.y(), 1, 0);
+    vertices[2].set(bottomRight.x(), bottomRight.y(), 0, 1);
+    vertices[3].set(bottomRight.x(), topLeft.y(), 1, 1);
+    node->markDirty(QSGNode::DirtyGeometry);
+}
+
+QImage ChartRenderer::renderAxesImage() const
+{
+    const qreal dpr = window()->effectiveDevicePixelRatio();
+    QImage image((size() * dpr).toSize(), QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(dpr);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    m_chart.drawAxes(&painter, chartRect());
+    return image;
+}
+
+void ChartRenderer::setModel(ChartDataModel *model)
+{
+    if (m_model == model)
+        return;
+
+    m_model = model;
+    rebuildSeries();
+    emit modelChanged();
+}
+
+void ChartRenderer::setVessel(VesselModel *vessel)
+{
+    if (m_vessel == vessel)
+        return;
+
+    m_vessel = vessel;
+    rebuildSeries();
+    emit vesselChanged();
+}
+
+void ChartRenderer::setReference(ChartDataModel *reference)
+{
+    if (m_reference == reference)
+        return;
+
+    m_reference = reference;
+    rebuildSeries();
+    emit referenceChanged();
+}
+
+void ChartRenderer::setBins(const BinStore &bins)
+{
+    m_bins = bins;
+    if (!m_vessel && !m_model)
+        reloadSeries();
+}
+
+void ChartRenderer::rebuildSeries()
+{
+    for (const QMetaObject::Connection &connection : std::as_const(m_seriesConnections))
+        disconnect(connection);
+    m_seriesConnections.clear();
+
+    // The primary series keeps a live state set by hand while there is no model
+    Series primary;
+    primary.currentRpm = m_series.first().currentRpm;
+    primary.currentFuelFlow = m_series.first().currentFuelFlow;
+    primary.isEcoMode = m_series.first().isEcoMode;
+    primary.model = m_vessel ? nullptr : m_model.data();
+    m_series = { primary };
+
+    // A single engine would only repeat the total
+    if (m_vessel && m_vessel->engineCount() > 1) {
+        for (int i = 0; i < m_vessel->engineCount(); ++i) {
+            Series engine;
+            engine.model = m_vessel->engine(i);
+            engine.color = seriesColor(i);
+            m_series.append(engine);
+        }
+    }
+
+    // Drawn first, beneath the engines
+    if (m_reference) {
+        Series reference;
+        reference.model = m_reference;
+        reference.reference = true;
+        reference.color = REFERENCE_COLOR;
+        m_series.append(reference);
+    }
+
+    for (int i = 0; i < m_series.size(); ++i) {
+        ChartDataModel *model = m_series.at(i).model;
+        if (!model)
+            continue;
+
+        m_seriesConnections << connect(model, &QAbstractItemModel::modelReset, this, &ChartRenderer::reloadSeries);
+        m_seriesConnections << connect(model, &QAbstractItemModel::dataChanged, this,
+                                       [this, i](const QModelIndex &topLeft, const QModelIndex &bottomRight,
+                                                 const QList<int> &roles) {
+            updateBins(i, topLeft.row(), bottomRight.row(), roles);
+        });
+        if (m_series.at(i).reference)
+            continue;
+
+        // A reading changes up to three properties; polish() collapses them
+        // and any further readings into one updatePolish() per frame
+        m_seriesConnections << connect(model, &ChartDataModel::currentRpmChanged, this, &QQuickItem::polish);
+        m_seriesConnections << connect(model, &ChartDataModel::currentFuelFlowChanged, this, &QQuickItem::polish);
+        m_seriesConnections << connect(model, &ChartDataModel::ecoModeChanged, this, &QQuickItem::polish);
+    }
+
+    if (m_vessel)
+        m_seriesConnections << connect(m_vessel, &VesselModel::totalDensityChanged, this, &ChartRenderer::updateDensity);
+    else if (m_model)
+        m_seriesConnections << connect(m_model, &ChartDataModel::densityChanged, this, &ChartRenderer::updateDensity);
+
+    if (m_vessel) {
+        m_seriesConnections << connect(m_vessel, &VesselModel::totalReset, this, &ChartRenderer::reloadSeries);
+        m_seriesConnections << connect(m_vessel, &VesselModel::totalBinsChanged, this, [this](int firstRow, int lastRow) {
+            updateBins(0, firstRow, lastRow, { ChartDataModel::MinFuelFlowRole, ChartDataModel::MaxFuelFlowRole,
+                                               ChartDataModel::MedianFuelFlowRole });
+        });
+        m_seriesConnections << connect(m_vessel, &VesselModel::totalLiveStateChanged, this, &QQuickItem::polish);
+    }
+
+    if (m_vessel || m_model)
+        polish();
+    reloadSeries();
+}
+
+void ChartRenderer::reloadSeries()
+{
+    // Shallow copies: the models detach on their next write, so these stay
+    // immutable snapshots without copying the bins
+    for (int i = 0; i < m_series.size(); ++i) {
+        m_series[i].bins = sourceBins(i);
+        m_series[i].geometryDirtyBins.unite(0, m_series.at(i).bins.size() - 1);
+    }
+
+    // The density is only converted while it is shown
+    if (m_showDensity)
+        m_density.reset(sourceDensity());
+    else
+        m_density.clear();
+    m_densityDirtyRows.unite(0, m_density.rows() - 1);
+
+    m_chart.setDataVersion(++m_dataVersion);
+    invalidateStaticLayer();
+    markDirty(BinsDirty | MedianDirty | MarkerDirty | DensityDirty);
+}
+
+BinStore ChartRenderer::sourceBins(int index) const
+{
+    const Series &series = m_series.at(index);
+    if (series.model)
+        return series.model->bins();
+    if (index == 0 && m_vessel)
+        return m_vessel->totalBins();
+    if (index == 0 && !m_model)
+        return m_bins;
+    return BinStore();
+}
+
+DensityGrid ChartRenderer::sourceDensity() const
+{
+    if (m_vessel)
+        return m_vessel->totalDensity();
+    if (m_model)
+        return m_model->density();
+    return DensityGrid();
+}
+
+bool ChartRenderer::pullLiveState(int index)
+{
+    Series &series = m_series[index];
+    if (series.reference)
+        return false;
+
+    double rpm = series.currentRpm;
+    double fuelFlow = series.currentFuelFlow;
+    bool isEco = series.isEcoMode;
+    if (series.model) {
+        rpm = series.model->currentRpm();
+        fuelFlow = series.model->currentFuelFlow();
+        isEco = series.model->isEcoMode();
+    } else if (m_vessel && index == 0) {
+        rpm = m_vessel->totalRpm();
+        fuelFlow = m_vessel->totalFuelFlow();
+        isEco = m_vessel->isTotalEcoMode();
+    } else {
+        return false;
+    }
+
+    if (qFuzzyCompare(series.currentRpm, rpm) && qFuzzyCompare(series.currentFuelFlow, fuelFlow)
+        && series.isEcoMode == isEco) {
+        return false;
+    }
+
+    series.currentRpm = rpm;
+    series.currentFuelFlow = fuelFlow;
+    series.isEcoMode = isEco;
+    return true;
+}
+
+void ChartRenderer::updateBins(int index, int firstRow, int lastRow, const QList<int> &roles)
+{
+    if (index >= m_series.size())
+        return;
+
+    // Only the roles that are drawn matter; an empty list means all of them
+    auto changed = [&roles](int role) { return roles.isEmpty() || roles.contains(role); };
+    int flags = 0;
+    if (changed(ChartDataModel::RpmRole) || changed(ChartDataModel::MinFuelFlowRole)
+        || changed(ChartDataModel::MaxFuelFlowRole)) {
+        flags |= BinsDirty;
+    }
+    if (changed(ChartDataModel::RpmRole) || changed(ChartDataModel::MedianFuelFlowRole))
+        flags |= MedianDirty;
+
+    Series &series = m_series[index];
+    series.bins = sourceBins(index);
+    if (!flags)
+        return;
+
+    // The bin count only changes with a reset, so the cached layer and
+    // geometry can be patched row by row
+    m_layerDirtyBins.unite(firstRow, lastRow);
+    series.geometryDirtyBins.unite(firstRow, lastRow);
+
+    m_chart.setDataVersion(++m_dataVersion);
+    markDirty(flags);
+}
+
+void ChartRenderer::updateDensity(int firstRow, int lastRow)
+{
+    if (!m_showDensity)
+        return;
+
+    // A new maximum recolours every cell of the painted layer
+    const int maxLevel = m_density.maxLevel();
+    m_density.update(sourceDensity(), firstRow, lastRow);
+    if (m_density.maxLevel() != maxLevel)
+        invalidateStaticLayer();
+    else
+        m_layerDirtyBins.unite(firstRow, lastRow);
+    m_densityDirtyRows.unite(firstRow, lastRow);
+
+    m_chart.setDataVersion(++m_dataVersion);
+    markDirty(DensityDirty);
+}
+
+bool ChartRenderer::drawsEnvelope(const Series &series) const
+{
+    // The density takes the place of the primary series' envelope, whose
+    // samples it counts
+    return m_density.isEmpty() || &series != &m_series.constFirst();
+}
+
+void ChartRenderer::setCurrentRpm(double rpm)
+{
+    setLiveState(rpm, currentFuelFlow(), isEcoMode());
+}
+
+void ChartRenderer::setCurrentFuelFlow(double fuelFlow)
+{
+    setLiveState(currentRpm(), fuelFlow, isEcoMode());
 }
 
 void ChartRenderer::setIsEcoMode(bool isEco)
 {
-    if (m_isEcoMode != isEco) {
-        m_isEcoMode = isEco;
-        emit ecoModeChanged();
-        update();
+    setLiveState(currentRpm(), currentFuelFlow(), isEco);
+}
+
+void ChartRenderer::setLiveState(double rpm, double fuelFlow, bool isEco)
+{
+    Series &primary = m_series.first();
+    if (qFuzzyCompare(primary.currentRpm, rpm) && qFuzzyCompare(primary.currentFuelFlow, fuelFlow)
+        && primary.isEcoMode == isEco) {
+        return;
+    }
+
+    primary.currentRpm = rpm;
+    primary.currentFuelFlow = fuelFlow;
+    primary.isEcoMode = isEco;
+    emit liveStateChanged();
+    scheduleMarkerUpdate();
+}
+
+void ChartRenderer::scheduleMarkerUpdate()
+{
+    // Sub-pixel moves are invisible; a colour change never is
+    const qreal dpr = window() ? window()->effectiveDevicePixelRatio() : 1.0;
+    const QRectF rect = chartRect();
+    bool visible = false;
+    for (const Series &series : std::as_const(m_series)) {
+        const QPointF position = mapToChart(series.currentRpm, series.currentFuelFlow, rect);
+        if (markerColor(series) != series.drawnMarkerColor
+            || QLineF(position, series.drawnMarkerPosition).length() * dpr >= m_redrawThreshold) {
+            visible = true;
+            break;
+        }
+    }
+    if (!visible)
+        return;
+
+    // Too soon after the last marker frame: redraw once the interval is up,
+    // with whatever the state is by then
+    if (m_maxFps > 0.0 && m_markerFrameClock.isValid()) {
+        const qint64 remaining = qCeil(1000.0 / m_maxFps) - m_markerFrameClock.elapsed();
+        if (remaining > 0) {
+            if (!m_governorTimer.isActive())
+                m_governorTimer.start(int(remaining));
+            return;
+        }
+    }
+
+    m_markerFrameClock.start();
+    markDirty(MarkerDirty);
+}
+
+void ChartRenderer::updatePolish()
+{
+    bool changed = false;
+    for (int i = 0; i < m_series.size(); ++i)
+        changed |= pullLiveState(i);
+
+    if (changed) {
+        emit liveStateChanged();
+        scheduleMarkerUpdate();
     }
 }
 
 void ChartRenderer::setMinRpm(double minRpm)
 {
-    if (!qFuzzyCompare(m_minRpm, minRpm)) {
-        m_minRpm = minRpm;
+    if (!qFuzzyCompare(m_chart.minRpm(), minRpm)) {
+        setRpmRange(minRpm, m_chart.maxRpm());
         emit minRpmChanged();
-        update();
     }
 }
 
 void ChartRenderer::setMaxRpm(double maxRpm)
 {
-    if (!qFuzzyCompare(m_maxRpm, maxRpm)) {
-        m_maxRpm = maxRpm;
+    if (!qFuzzyCompare(m_chart.maxRpm(), maxRpm)) {
+        setRpmRange(m_chart.minRpm(), maxRpm);
         emit maxRpmChanged();
-        update();
     }
 }
 
+void ChartRenderer::setRpmRange(double minRpm, double maxRpm)
+{
+    // An unzoomed view follows the axis, a zoomed one is kept where possible
+    const bool zoomed = isZoomed();
+    m_chart.setRpmRange(minRpm, maxRpm);
+    if (zoomed)
+        setViewRange(m_chart.viewMinRpm(), m_chart.viewMaxRpm());
+    else
+        resetView();
+
+    invalidateStaticLayer();
+    markDirty(AllDirty);
+}
+
+bool ChartRenderer::isZoomed() const
+{
+    return !qFuzzyCompare(m_chart.viewMinRpm(), m_chart.minRpm())
+        || !qFuzzyCompare(m_chart.viewMaxRpm(), m_chart.maxRpm());
+}
+
+void ChartRenderer::setViewRange(double minRpm, double maxRpm)
+{
+    const double fullSpan = m_chart.maxRpm() - m_chart.minRpm();
+    double span = fullSpan;
+    if (fullSpan > 0.0) {
+        const double minSpan = qMin(fullSpan, MIN_VIEW_BINS * binLayout().binWidth);
+        span = qBound(minSpan, maxRpm - minRpm, fullSpan);
+        minRpm = qBound(m_chart.minRpm(), minRpm, m_chart.maxRpm() - span);
+    } else {
+        minRpm = m_chart.minRpm();
+    }
+    maxRpm = minRpm + span;
+
+    if (m_chart.viewMinRpm() == minRpm && m_chart.viewMaxRpm() == maxRpm)
+        return;
+
+    m_chart.setViewRange(minRpm, maxRpm);
+    emit viewChanged();
+    invalidateStaticLayer();
+    markDirty(AllDirty);
+}
+
+void ChartRenderer::zoom(double factor, double x)
+{
+    if (!(factor > 0.0) || chartRect().width() <= 0)
+        return;
+
+    const QRectF rect = chartRect();
+    const double anchor = rpmAt(qBound(rect.left(), x, rect.right()), rect);
+    setViewRange(anchor - (anchor - m_chart.viewMinRpm()) / factor,
+                 anchor + (m_chart.viewMaxRpm() - anchor) / factor);
+}
+
+void ChartRenderer::pan(double pixels)
+{
+    const QRectF rect = chartRect();
+    if (rect.width() <= 0)
+        return;
+
+    // Content follows the pointer, so the view moves the other way
+    const double offset = -pixels / rect.width() * (m_chart.viewMaxRpm() - m_chart.viewMinRpm());
+    setViewRange(m_chart.viewMinRpm() + offset, m_chart.viewMaxRpm() + offset);
+}
+
+void ChartRenderer::resetView()
+{
+    setViewRange(m_chart.minRpm(), m_chart.maxRpm());
+}
+
+void ChartRenderer::wheelEvent(QWheelEvent *event)
+{
+    // Vertical scrolling zooms around the pointer, horizontal scrolling pans
+    const QPoint delta = event->angleDelta();
+    if (qAbs(delta.x()) > qAbs(delta.y()))
+        pan(delta.x() / 8.0);
+    else
+        zoom(qPow(WHEEL_ZOOM_STEP, delta.y() / 120.0), event->position().x());
+    event->accept();
+}
+
+void ChartRenderer::mousePressEvent(QMouseEvent *event)
+{
+    m_dragX = event->position().x();
+    event->accept();
+}
+
+void ChartRenderer::mouseMoveEvent(QMouseEvent *event)
+{
+    pan(event->position().x() - m_dragX);
+    m_dragX = event->position().x();
+    event->accept();
+}
+
+void ChartRenderer::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    resetView();
+    event->accept();
+}
+
+void ChartRenderer::touchEvent(QTouchEvent *event)
+{
+    const QList<QEventPoint> &points = event->points();
+    if (event->type() == QEvent::TouchEnd || event->type() == QEvent::TouchCancel || points.isEmpty()) {
+        m_touchPointCount = 0;
+        event->accept();
+        return;
+    }
+
+    // One finger pans; two also zoom by how far they moved apart, around
+    // the point between them
+    QPointF centre = points.at(0).position();
+    double spread = 0.0;
+    if (points.size() > 1) {
+        centre = (points.at(0).position() + points.at(1).position()) / 2;
+        spread = QLineF(points.at(0).position(), points.at(1).position()).length();
+    }
+
+    // Every change in the number of fingers starts the gesture over
+    const int pointCount = qMin(int(points.size()), 2);
+    if (pointCount == m_touchPointCount) {
+        pan(centre.x() - m_touchCentre.x());
+        if (spread > 0.0 && m_touchSpread > 0.0)
+            zoom(spread / m_touchSpread, centre.x());
+    }
+    m_touchCentre = centre;
+    m_touchSpread = spread;
+    m_touchPointCount = pointCount;
+    event->accept();
+}
+
 void ChartRenderer::setMinFuelFlow(double minFuelFlow)
 {
-    if (!qFuzzyCompare(m_minFuelFlow, minFuelFlow)) {
-        m_minFuelFlow = minFuelFlow;
+    if (!qFuzzyCompare(m_chart.minFuelFlow(), minFuelFlow)) {
+        m_chart.setFuelFlowRange(minFuelFlow, m_chart.maxFuelFlow());
         emit minFuelFlowChanged();
-        update();
+        invalidateStaticLayer();
+        markDirty(AllDirty);
     }
 }
 
 void ChartRenderer::setMaxFuelFlow(double maxFuelFlow)
 {
-    if (!qFuzzyCompare(m_maxFuelFlow, maxFuelFlow)) {
-        m_maxFuelFlow = maxFuelFlow;
+    if (!qFuzzyCompare(m_chart.maxFuelFlow(), maxFuelFlow)) {
+        m_chart.setFuelFlowRange(m_chart.minFuelFlow(), maxFuelFlow);
         emit maxFuelFlowChanged();
-        update();
+        invalidateStaticLayer();
+        markDirty(AllDirty);
     }
 }
 
-void ChartRenderer::drawGrid(QPainter *painter, const QRectF &chartRect)
+void ChartRenderer::setRenderMode(RenderMode mode)
 {
-    painter->setPen(QPen(QColor(100, 100, 100), 1, Qt::SolidLine));
-
-    // Only draw horizontal grid lines (Fuel Flow) - updated for 0-80 range with 20 intervals
-    for (int flow = 0; flow <= 80; flow += 20) {
-        double y = chartRect.bottom() - (flow / 80.0) * chartRect.height();
-        painter->drawLine(QPointF(chartRect.left(), y), 
-                         QPointF(chartRect.right(), y));
+    if (m_renderMode != mode) {
+        m_renderMode = mode;
+        emit renderModeChanged();
+        markDirty(AllDirty);
     }
 }
 
-void ChartRenderer::drawAxes(QPainter *painter, const QRectF &chartRect)
+void ChartRenderer::setMaxFps(double fps)
 {
-    painter->setFont(QFont("Arial", 10));
+    fps = qMax(0.0, fps);
+    if (qFuzzyCompare(m_maxFps, fps))
+        return;
 
-    // X-axis in dark grey
-    painter->setPen(QPen(QColor(80, 80, 80), 2));
-    painter->drawLine(chartRect.bottomLeft(), chartRect.bottomRight());
+    m_maxFps = fps;
+    emit maxFpsChanged();
+}
 
-    // X-axis labels (RPM) - white color
-    painter->setPen(QPen(Qt::white, 1));
-    for (int rpm = 0; rpm <= 6000; rpm += 1000) {
-        double x = chartRect.left() + (rpm / 6000.0) * chartRect.width();
-        painter->drawText(QPointF(x - 15, chartRect.bottom() + 20), 
-                         QString::number(rpm));
+void ChartRenderer::setRedrawThreshold(double pixels)
+{
+    pixels = qMax(0.0, pixels);
+    if (qFuzzyCompare(m_redrawThreshold, pixels))
+        return;
+
+    m_redrawThreshold = pixels;
+    emit redrawThresholdChanged();
+}
+
+void ChartRenderer::setShowMetrics(bool show)
+{
+    if (m_showMetrics == show)
+        return;
+
+    m_showMetrics = show;
+    if (show) {
+        Metrics::setEnabled(true);
+        m_lastRepaints = Metrics::counter(Metrics::Repaints);
+        m_lastUpdateRequests = Metrics::counter(Metrics::UpdateRequests);
+        m_metricsClock.start();
+        m_metricsTimer.start();
+    } else {
+        m_metricsTimer.stop();
     }
 
-    // Y-axis labels (Fuel Flow) - moved to right side with white color, updated for 0-80 range
-    for (int flow = 0; flow <= 80; flow += 20) {
-        double y = chartRect.bottom() - (flow / 80.0) * chartRect.height();
-        painter->drawText(QPointF(chartRect.right() + 10, y + 5), 
-                         QString::number(flow));
+    trackFrameInterval(window());
+    refreshMetrics();
+    emit showMetricsChanged();
+}
+
+void ChartRenderer::setShowDensity(bool show)
+{
+    if (m_showDensity == show)
+        return;
+
+    m_showDensity = show;
+    reloadSeries();
+    emit showDensityChanged();
+}
+
+void ChartRenderer::refreshMetrics()
+{
+    if (!m_showMetrics) {
+        m_metricsText.clear();
+        markDirty(MetricsDirty);
+        return;
     }
 
-    // Axis titles - dark grey color
-    painter->setPen(QPen(QColor(80, 80, 80), 1));
-    
-    // Move Fuel Flow title to right side
+    const double seconds = m_metricsClock.isValid() ? m_metricsClock.restart() / 1000.0 : 0.0;
+    const qint64 repaints = Metrics::counter(Metrics::Repaints);
+    const qint64 updateRequests = Metrics::counter(Metrics::UpdateRequests);
+    const double repaintRate = seconds > 0.0 ? (repaints - m_lastRepaints) / seconds : 0.0;
+    const double updateRate = seconds > 0.0 ? (updateRequests - m_lastUpdateRequests) / seconds : 0.0;
+    m_lastRepaints = repaints;
+    m_lastUpdateRequests = updateRequests;
+
+    const Metrics::Summary frame = Metrics::summary(Metrics::FrameInterval);
+    const Metrics::Summary sync = Metrics::summary(Metrics::SceneGraphSync);
+    m_metricsText = {
+        QStringLiteral("frame  p50 %1 ms  p99 %2 ms").arg(frame.p50Ms, 0, 'f', 1).arg(frame.p99Ms, 0, 'f', 1),
+        QStringLiteral("sync   p50 %1 ms  p99 %2 ms").arg(sync.p50Ms, 0, 'f', 2).arg(sync.p99Ms, 0, 'f', 2),
+        QStringLiteral("repaints %1/s  updates %2/s").arg(repaintRate, 0, 'f', 0).arg(updateRate, 0, 'f', 0),
+    };
+    markDirty(MetricsDirty);
+}
+
+void ChartRenderer::trackFrameInterval(QQuickWindow *window)
+{
+    disconnect(m_frameSwappedConnection);
+    if (!window || !(m_showMetrics || Metrics::isEnabled()))
+        return;
+
+    // frameSwapped is emitted on the render thread, which alone owns m_frameClock
+    m_frameClock.invalidate();
+    m_frameSwappedConnection = connect(window, &QQuickWindow::frameSwapped, this, [this]() {
+        if (m_frameClock.isValid()) {
+            const qint64 interval = m_frameClock.nsecsElapsed();
+            if (interval < IDLE_FRAME_NS)
+                Metrics::record(Metrics::FrameInterval, interval);
+        }
+        m_frameClock.start();
+    }, Qt::DirectConnection);
+}
+
+QRectF ChartRenderer::metricsRect() const
+{
+    const QRectF rect = chartRect();
+    return QRectF(rect.left() + 8, rect.top() + 8, 240, 3 * 16 + 12);
+}
+
+QImage ChartRenderer::renderMetricsImage(qreal devicePixelRatio) const
+{
+    const QSizeF size = metricsRect().size();
+    QImage image((size * devicePixelRatio).toSize(), QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(devicePixelRatio);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    drawMetricsOverlay(&painter, QRectF(QPointF(0, 0), size));
+    return image;
+}
+
+void ChartRenderer::drawMetricsOverlay(QPainter *painter, const QRectF &rect) const
+{
     painter->save();
-    painter->translate(chartRect.right() + 60, chartRect.center().y());
-    painter->rotate(-90);
-    painter->drawText(QPointF(-50, 0), "Fuel Flow (L/h)");
-    painter->restore();
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(QColor(0, 0, 0, 170));
+    painter->drawRoundedRect(rect, 4, 4);
 
-    painter->drawText(QPointF(chartRect.center().x() - 30, chartRect.bottom() + 50), 
-                     "RPM");
+    painter->setFont(m_chart.font());
+    painter->setPen(QPen(Qt::white));
+    double y = rect.top() + 6 + 12;
+    for (const QString &line : m_metricsText) {
+        painter->drawText(QPointF(rect.left() + 8, y), line);
+        y += 16;
+    }
+    painter->restore();
 }
 
 void ChartRenderer::drawData(QPainter *painter, const QRectF &chartRect)
 {
-    if (m_dataPoints.size() < 2)
-        return;
+    ScopedTimer timer(Metrics::DrawData);
 
-    // Calculate width of each rectangle based on RPM range - now 50 RPM per rectangle
-    double rpmRange = m_maxRpm - m_minRpm;
-    double rectWidth = chartRect.width() / (rpmRange / 50.0); // 50 RPM per rectangle
-    
-    // Enable antialiasing for smooth rounded corners
-    painter->setRenderHint(QPainter::Antialiasing, true);
-    
-    for (const auto &pointVar : m_dataPoints) {
-        QVariantMap point = pointVar.toMap();
-        double rpm = point["rpm"].toDouble();
-        double minFlow = point["minFuelFlow"].toDouble();
-        double maxFlow = point["maxFuelFlow"].toDouble();
-        
-        // Calculate rectangle position and dimensions
-        double x = chartRect.left() + (rpm / rpmRange) * chartRect.width() - rectWidth / 2;
-        double minY = chartRect.bottom() - (minFlow / (m_maxFuelFlow - m_minFuelFlow)) * chartRect.height();
-        double maxY = chartRect.bottom() - (maxFlow / (m_maxFuelFlow - m_minFuelFlow)) * chartRect.height();
-        double rectHeight = minY - maxY;
-        
-        // Create the rectangle with 1.5 pixel gap on each side (3 pixels total gap between rectangles)
-        double gap = 1.5; // 1.5 pixels gap on each side
-        QRectF rect(x + gap, maxY, rectWidth - (gap * 2), rectHeight);
-        
-        // Create gradient for modern look - dark grey with 50% transparency
-        QLinearGradient gradient(rect.topLeft(), rect.bottomLeft());
-        gradient.setColorAt(0, QColor(80, 80, 80, 128));   // 50% transparent dark grey
-        gradient.setColorAt(0.5, QColor(70, 70, 70, 128)); // 50% transparent darker grey
-        gradient.setColorAt(1, QColor(60, 60, 60, 128));   // 50% transparent darkest grey
-        
-        // Draw rectangle with gradient and rounded corners (smaller radius for smaller rectangles)
-        painter->setBrush(QBrush(gradient));
-        painter->setPen(QPen(QColor(50, 50, 50, 128), 1)); // 50% transparent dark border
-        painter->drawRoundedRect(rect, 2, 2); // 2px rounded corners for smaller rectangles
+    // The density goes beneath every envelope
+    if (!m_density.isEmpty())
+        m_chart.drawDensity(painter, chartRect, m_density);
+
+    for (int s = m_series.size() - 1; s >= 0; --s) {
+        if (drawsEnvelope(m_series.at(s)))
+            m_chart.drawData(painter, chartRect, m_series[s]);
     }
-    
-    // Reset brush for other elements
-    painter->setBrush(Qt::NoBrush);
 }
 
+void ChartRenderer::drawMedianLine(QPainter *painter, const QRectF &chartRect)
+{
+    ScopedTimer timer(Metrics::DrawMedianLine);
+
+    for (int s = m_series.size() - 1; s >= 0; --s)
+        m_chart.drawMedianLine(painter, chartRect, m_series[s]);
+}
 
 void ChartRenderer::drawCurrentPoint(QPainter *painter, const QRectF &chartRect)
 {
-    // Calculate the median fuel flow at current RPM
-    double medianFuelFlowAtCurrentRpm = 0.0;
-    bool foundMedian = false;
-    
-    // Find median fuel flow by interpolating between data points
-    for (int i = 0; i < m_dataPoints.size() - 1; ++i) {
-        QVariantMap point1 = m_dataPoints[i].toMap();
-        QVariantMap point2 = m_dataPoints[i + 1].toMap();
-        
-        double rpm1 = point1["rpm"].toDouble();
-        double rpm2 = point2["rpm"].toDouble();
-        
-        if (m_currentRpm >= rpm1 && m_currentRpm <= rpm2) {
-            double median1 = point1["medianFuelFlow"].toDouble();
-            double median2 = point2["medianFuelFlow"].toDouble();
-            
-            // Linear interpolation
-            double ratio = (m_currentRpm - rpm1) / (rpm2 - rpm1);
-            medianFuelFlowAtCurrentRpm = median1 + ratio * (median2 - median1);
-            foundMedian = true;
-            break;
-        }
-    }
-    
-    // If we couldn't interpolate, use the closest point
-    if (!foundMedian && !m_dataPoints.isEmpty()) {
-        // Find closest data point
-        int closestIndex = 0;
-        double minDistance = qAbs(m_dataPoints[0].toMap()["rpm"].toDouble() - m_currentRpm);
-        
-        for (int i = 1; i < m_dataPoints.size(); ++i) {
-            double distance = qAbs(m_dataPoints[i].toMap()["rpm"].toDouble() - m_currentRpm);
-            if (distance < minDistance) {
-                minDistance = distance;
-                closestIndex = i;
-            }
-        }
-        medianFuelFlowAtCurrentRpm = m_dataPoints[closestIndex].toMap()["medianFuelFlow"].toDouble();
-    }
-    
-    // Map the current RPM and median fuel flow to chart coordinates for reference
-    QPointF currentPointOnMedian = mapToChart(m_currentRpm, medianFuelFlowAtCurrentRpm, chartRect);
-    
-    // Map the current RPM and ACTUAL current fuel flow to chart coordinates
-    QPointF actualCurrentPoint = mapToChart(m_currentRpm, m_currentFuelFlow, chartRect);
-    
-    // Draw current point at the actual fuel flow position - smaller dot without white border
-    QColor pointColor = m_isEcoMode ? QColor(0, 200, 0) : QColor(255, 150, 0);
-    painter->setBrush(QBrush(pointColor));
-    painter->setPen(QPen(pointColor, 1)); // Use same color for border
-    painter->drawEllipse(actualCurrentPoint, 6, 6); // Draw at actual current fuel flow position
+    ScopedTimer timer(Metrics::DrawCurrentPoint);
+
+    for (int s = m_series.size() - 1; s >= 0; --s)
+        m_chart.drawCurrentPoint(painter, chartRect, m_series.at(s));
 }
 
 void ChartRenderer::drawLegend(QPainter *painter, const QRectF &chartRect)
@@ -271,7 +1379,7 @@ void ChartRenderer::drawLegend(QPainter *painter, const QRectF &chartRect)
     QRectF legendRect(chartRect.left(), chartRect.bottom() + 10, 
                      chartRect.width(), LEGEND_HEIGHT - 10);
 
-    painter->setFont(QFont("Arial", 10));
+    painter->setFont(m_chart.font());
     
     double itemWidth = legendRect.width() / 4;
     double y = legendRect.top() + 20;
@@ -286,7 +1394,7 @@ void ChartRenderer::drawLegend(QPainter *painter, const QRectF &chartRect)
     painter->setPen(QPen(QColor(50, 50, 50, 128), 1)); // 50% transparent dark border
     painter->drawRoundedRect(QRectF(legendRect.left(), y, 20, 10), 2, 2);
     painter->setPen(QPen(Qt::white));
-    painter->drawText(QPointF(legendRect.left() + 25, y + 10), "Fuel Range (50 RPM blocks)");
+    painter->drawText(QPointF(legendRect.left() + 25, y + 10), QStringLiteral("Fuel Range (%1 RPM blocks)").arg(binLayout().binWidth));
 
     // Median line
     painter->setPen(QPen(Qt::white, 3));
@@ -309,40 +1417,3 @@ void ChartRenderer::drawLegend(QPainter *painter, const QRectF &chartRect)
     painter->setPen(QPen(Qt::white));
     painter->drawText(QPointF(legendRect.left() + 3 * itemWidth + 25, y + 10), "Normal");
 }
-
-QPointF ChartRenderer::mapToChart(double rpm, double fuelFlow, const QRectF &chartRect) const
-{
-    double x = chartRect.left() + (rpm / (m_maxRpm - m_minRpm)) * chartRect.width();
-    double y = chartRect.bottom() - (fuelFlow / (m_maxFuelFlow - m_minFuelFlow)) * chartRect.height();
-    return QPointF(x, y);
-}
-
-void ChartRenderer::drawMedianLine(QPainter *painter, const QRectF &chartRect)
-{
-    if (m_dataPoints.size() < 2)
-        return;
-        
-    // Create median path
-    QPainterPath medianPath;
-    bool firstPoint = true;
-    
-    for (const auto &pointVar : m_dataPoints) {
-        QVariantMap point = pointVar.toMap();
-        double rpm = point["rpm"].toDouble();
-        double medianFlow = point["medianFuelFlow"].toDouble();
-        
-        QPointF medianPoint = mapToChart(rpm, medianFlow, chartRect);
-        
-        if (firstPoint) {
-            medianPath.moveTo(medianPoint);
-            firstPoint = false;
-        } else {
-            medianPath.lineTo(medianPoint);
-        }
-    }
-    
-    // Draw median line in white - made thinner
-    painter->setBrush(Qt::NoBrush);
-    painter->setPen(QPen(Qt::white, 1, Qt::SolidLine));
-    painter->drawPath(medianPath);
-}
@@ -2,39 +2,91 @@
 #define CHARTRENDERER_H
 
 #include <QQuickItem>
-#include <QQuickPaintedItem>
 #include <QPainter>
-#include <QVariantList>
+#include <QImage>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "chartdatamodel.h"
+#include "chartpainter.h"
+#include "densitymap.h"
+#include "vesselmodel.h"
 
-class ChartRenderer : public QQuickPaintedItem
+class QSGGeometryNode;
+
+class ChartRenderer : public QQuickItem
 {
     Q_OBJECT
-    Q_PROPERTY(QVariantList dataPoints READ dataPoints WRITE setDataPoints NOTIFY dataPointsChanged)
-    Q_PROPERTY(double currentRpm READ currentRpm WRITE setCurrentRpm NOTIFY currentRpmChanged)
-    Q_PROPERTY(double currentFuelFlow READ currentFuelFlow WRITE setCurrentFuelFlow NOTIFY currentFuelFlowChanged)
-    Q_PROPERTY(bool isEcoMode READ isEcoMode WRITE setIsEcoMode NOTIFY ecoModeChanged)
+    Q_PROPERTY(ChartDataModel *model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(VesselModel *vessel READ vessel WRITE setVessel NOTIFY vesselChanged)
+    Q_PROPERTY(ChartDataModel *reference READ reference WRITE setReference NOTIFY referenceChanged)
+    Q_PROPERTY(double currentRpm READ currentRpm WRITE setCurrentRpm NOTIFY liveStateChanged)
+    Q_PROPERTY(double currentFuelFlow READ currentFuelFlow WRITE setCurrentFuelFlow NOTIFY liveStateChanged)
+    Q_PROPERTY(bool isEcoMode READ isEcoMode WRITE setIsEcoMode NOTIFY liveStateChanged)
     Q_PROPERTY(double minRpm READ minRpm WRITE setMinRpm NOTIFY minRpmChanged)
     Q_PROPERTY(double maxRpm READ maxRpm WRITE setMaxRpm NOTIFY maxRpmChanged)
+    Q_PROPERTY(double viewMinRpm READ viewMinRpm NOTIFY viewChanged)
+    Q_PROPERTY(double viewMaxRpm READ viewMaxRpm NOTIFY viewChanged)
+    Q_PROPERTY(bool zoomed READ isZoomed NOTIFY viewChanged)
     Q_PROPERTY(double minFuelFlow READ minFuelFlow WRITE setMinFuelFlow NOTIFY minFuelFlowChanged)
     Q_PROPERTY(double maxFuelFlow READ maxFuelFlow WRITE setMaxFuelFlow NOTIFY maxFuelFlowChanged)
+    Q_PROPERTY(RenderMode renderMode READ renderMode WRITE setRenderMode NOTIFY renderModeChanged)
+    Q_PROPERTY(bool showMetrics READ showMetrics WRITE setShowMetrics NOTIFY showMetricsChanged)
+    Q_PROPERTY(bool showDensity READ showDensity WRITE setShowDensity NOTIFY showDensityChanged)
+    Q_PROPERTY(double maxFps READ maxFps WRITE setMaxFps NOTIFY maxFpsChanged)
+    Q_PROPERTY(double redrawThreshold READ redrawThreshold WRITE setRedrawThreshold NOTIFY redrawThresholdChanged)
 
 public:
+    // SceneGraph builds retained geometry nodes; Painted rasterizes with
+    // QPainter and is used automatically on the software backend.
+    enum RenderMode {
+        SceneGraph,
+        Painted
+    };
+    Q_ENUM(RenderMode)
+
     explicit ChartRenderer(QQuickItem *parent = nullptr);
 
-    void paint(QPainter *painter) override;
+    // Rasterizes the complete chart, used by the Painted fallback
+    void paint(QPainter *painter);
 
     // Property getters
-    QVariantList dataPoints() const { return m_dataPoints; }
-    double currentRpm() const { return m_currentRpm; }
-    double currentFuelFlow() const { return m_currentFuelFlow; }
-    bool isEcoMode() const { return m_isEcoMode; }
-    double minRpm() const { return m_minRpm; }
-    double maxRpm() const { return m_maxRpm; }
-    double minFuelFlow() const { return m_minFuelFlow; }
-    double maxFuelFlow() const { return m_maxFuelFlow; }
-
-    // Property setters
-    void setDataPoints(const QVariantList &dataPoints);
+    ChartDataModel *model() const { return m_model; }
+    VesselModel *vessel() const { return m_vessel; }
+    ChartDataModel *reference() const { return m_reference; }
+    double currentRpm() const { return m_series.first().currentRpm; }
+    double currentFuelFlow() const { return m_series.first().currentFuelFlow; }
+    bool isEcoMode() const { return m_series.first().isEcoMode; }
+    double minRpm() const { return m_chart.minRpm(); }
+    double maxRpm() const { return m_chart.maxRpm(); }
+    double viewMinRpm() const { return m_chart.viewMinRpm(); }
+    double viewMaxRpm() const { return m_chart.viewMaxRpm(); }
+    bool isZoomed() const;
+    double minFuelFlow() const { return m_chart.minFuelFlow(); }
+    double maxFuelFlow() const { return m_chart.maxFuelFlow(); }
+    RenderMode renderMode() const { return m_renderMode; }
+    bool showMetrics() const { return m_showMetrics; }
+    bool showDensity() const { return m_showDensity; }
+    double maxFps() const { return m_maxFps; }
+    double redrawThreshold() const { return m_redrawThreshold; }
+
+    // Property setters. With a model set, the live state (current RPM,
+    // fuel flow and eco mode) follows the model by itself, read once per
+    // frame however often the model changes it. The live state properties
+    // belong to the primary series: the model, or the vessel's total.
+    void setModel(ChartDataModel *model);
+
+    // Overlays every engine of the vessel, each in its own colour, under
+    // their combined total. Takes precedence over model.
+    void setVessel(VesselModel *vessel);
+
+    // Envelope and median of another model, e.g. the fleet's, drawn beneath
+    // every other series without a marker
+    void setReference(ChartDataModel *reference);
+
+    // Fixed bins for the primary series while there is neither a model nor
+    // a vessel
+    void setBins(const BinStore &bins);
     void setCurrentRpm(double rpm);
     void setCurrentFuelFlow(double fuelFlow);
     void setIsEcoMode(bool isEco);
@@ -42,39 +94,198 @@ public:
     void setMaxRpm(double maxRpm);
     void setMinFuelFlow(double minFuelFlow);
     void setMaxFuelFlow(double maxFuelFlow);
+    void setRenderMode(RenderMode mode);
+
+    // Overlays frame timing and repaint rate on the chart. Turning it on
+    // also enables Metrics recording.
+    void setShowMetrics(bool show);
+
+    // Replaces the primary series' envelope with a heatmap of where its
+    // samples fall within each bin, see ChartDataModel::density(). With a
+    // vessel that is the total, see VesselModel::totalDensity().
+    void setShowDensity(bool show);
+
+    // Marker governor: at most maxFps marker redraws per second (0 follows
+    // vsync), and none while the marker moved less than redrawThreshold
+    // device pixels and kept its colour
+    void setMaxFps(double fps);
+    void setRedrawThreshold(double pixels);
+
+    // The visible part of the RPM axis. It stays within minRpm..maxRpm and
+    // spans at least MIN_VIEW_BINS bins; only the bins inside it are drawn.
+    // Wheel and pinch zoom it, dragging pans it and a double click resets it.
+    Q_INVOKABLE void setViewRange(double minRpm, double maxRpm);
+    Q_INVOKABLE void zoom(double factor, double x);     // Keeps the RPM under item x in place
+    Q_INVOKABLE void pan(double pixels);
+    Q_INVOKABLE void resetView();
+
+    // Applies a complete reading at once: one liveStateChanged and at most
+    // one repaint, subject to the governor
+    Q_INVOKABLE void setLiveState(double rpm, double fuelFlow, bool isEco);
 
 signals:
-    void dataPointsChanged();
-    void currentRpmChanged();
-    void currentFuelFlowChanged();
-    void ecoModeChanged();
+    void modelChanged();
+    void vesselChanged();
+    void referenceChanged();
+    void liveStateChanged();
     void minRpmChanged();
     void maxRpmChanged();
+    void viewChanged();
     void minFuelFlowChanged();
     void maxFuelFlowChanged();
+    void renderModeChanged();
+    void showMetricsChanged();
+    void showDensityChanged();
+    void maxFpsChanged();
+    void redrawThresholdChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+    void itemChange(ItemChange change, const ItemChangeData &value) override;
+    void updatePolish() override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void touchEvent(QTouchEvent *event) override;
 
 private:
-    void drawGrid(QPainter *painter, const QRectF &chartRect);
-    void drawAxes(QPainter *painter, const QRectF &chartRect);
+    // Which scene graph nodes need to be rebuilt on the next sync
+    enum DirtyFlag {
+        GridDirty = 0x1,
+        BinsDirty = 0x2,
+        MedianDirty = 0x4,
+        MarkerDirty = 0x8,
+        MetricsDirty = 0x10,
+        DensityDirty = 0x20,
+        AllDirty = GridDirty | BinsDirty | MedianDirty | MarkerDirty | MetricsDirty | DensityDirty
+    };
+
+    // Identifies the contents of the cached static layer
+    struct LayerKey {
+        QSize pixelSize;
+        qreal devicePixelRatio = 0.0;
+        quint64 dataVersion = 0;
+
+        bool operator==(const LayerKey &other) const
+        {
+            return pixelSize == other.pixelSize
+                && qFuzzyCompare(devicePixelRatio, other.devicePixelRatio)
+                && dataVersion == other.dataVersion;
+        }
+    };
+
+    // Bin rows changed since it was last cleared
+    using BinRange = ChartPainter::BinRange;
+
+    // One curve on the chart: a model's or the vessel total's bins and live
+    // point, and what has been drawn of them. The primary series comes first.
+    struct Series : ChartPainter::Series {
+        QPointer<ChartDataModel> model;     // Null for the vessel total
+        BinRange geometryDirtyBins;         // Bins to rewrite in the scene graph geometry
+        QPointF drawnMarkerPosition;        // Where the last scheduled marker redraw puts it
+        QColor drawnMarkerColor;
+    };
+
+    void rebuildSeries();
+    void reloadSeries();
+    BinStore sourceBins(int index) const;
+    DensityGrid sourceDensity() const;
+    bool pullLiveState(int index);
+    void updateBins(int index, int firstRow, int lastRow, const QList<int> &roles);
+    void updateDensity(int firstRow, int lastRow);
+    bool drawsEnvelope(const Series &series) const;
+    bool hasBins() const;
+    BinLayout binLayout() const;
+    QRectF binColumns(const BinRange &range, const QRectF &chartRect) const;
+    BinRange visibleBins() const { return m_chart.visibleBins(binLayout()); }
+    QRectF plotColumns(const QRectF &chartRect) const { return m_chart.plotColumns(chartRect); }
+    const BinDecimator *decimatedBins(Series &series, const QRectF &chartRect) const
+    {
+        return m_chart.decimatedBins(series, chartRect);
+    }
+    void setRpmRange(double minRpm, double maxRpm);
+    void scheduleMarkerUpdate();
+    void markDirty(int flags);
+    QRectF chartRect() const { return m_chart.chartRect(); }
+    static QColor markerColor(const Series &series) { return ChartPainter::markerColor(series); }
+    static bool hasMarker(const Series &series) { return ChartPainter::hasMarker(series); }
+
+    // Background, grid, axes, bins and median rasterized once per LayerKey
+    const QImage &staticLayer(qreal devicePixelRatio);
+    void invalidateStaticLayer();
+
+    QSGNode *updateSceneGraphNode(QSGNode *oldNode);
+    QSGNode *updatePaintedNode(QSGNode *oldNode);
+    void updateGridGeometry(QSGGeometryNode *node, const QRectF &chartRect);
+    void updateBinsGeometry(QSGGeometryNode *node, const QRectF &chartRect, bool full);
+    void updateMedianGeometry(QSGGeometryNode *node, const QRectF &chartRect, bool full);
+    void updateMarkerGeometry(QSGGeometryNode *node, const QRectF &chartRect);
+    void updateDensityNode(QSGGeometryNode *node, const QRectF &chartRect);
+    QImage renderAxesImage() const;
+
+    void refreshMetrics();
+    void trackFrameInterval(QQuickWindow *window);
+    QRectF metricsRect() const;
+    QImage renderMetricsImage(qreal devicePixelRatio) const;
+    void drawMetricsOverlay(QPainter *painter, const QRectF &rect) const;
+
+    // Every series through m_chart, engines first so that the primary
+    // series ends up on top
     void drawData(QPainter *painter, const QRectF &chartRect);
-    void drawCurrentPoint(QPainter *painter, const QRectF &chartRect);
     void drawMedianLine(QPainter *painter, const QRectF &chartRect);
+    void drawCurrentPoint(QPainter *painter, const QRectF &chartRect);
     void drawLegend(QPainter *painter, const QRectF &chartRect);
-    
-    QPointF mapToChart(double rpm, double fuelFlow, const QRectF &chartRect) const;
-    
-    QVariantList m_dataPoints;
-    double m_currentRpm;
-    double m_currentFuelFlow;
-    bool m_isEcoMode;
-    double m_minRpm;
-    double m_maxRpm;
-    double m_minFuelFlow;
-    double m_maxFuelFlow;
-    
+
+    QPointF mapToChart(double rpm, double fuelFlow, const QRectF &chartRect) const
+    {
+        return m_chart.mapToChart(rpm, fuelFlow, chartRect);
+    }
+    double rpmAt(double x, const QRectF &chartRect) const { return m_chart.rpmAt(x, chartRect); }
+    double binPixelWidth(const QRectF &chartRect) const { return m_chart.binPixelWidth(binLayout(), chartRect); }
+
+    QPointer<ChartDataModel> m_model;
+    QPointer<VesselModel> m_vessel;
+    QPointer<ChartDataModel> m_reference;
+    QList<Series> m_series;                 // Never empty; the primary series comes first, the reference last
+    QList<QMetaObject::Connection> m_seriesConnections;
+    BinStore m_bins;                        // Set with setBins()
+    ChartPainter m_chart;                   // Axis and view ranges, size and the QPainter drawing
+    double m_dragX;
+    QPointF m_touchCentre;
+    double m_touchSpread;
+    int m_touchPointCount;
+    RenderMode m_renderMode;
+    int m_dirty;
+    quint64 m_dataVersion;
+    QImage m_staticLayer;
+    LayerKey m_staticLayerKey;
+    BinRange m_layerDirtyBins;              // Bins to repaint in the static layer
+    bool m_showMetrics;
+    bool m_showDensity;
+    DensityMap m_density;                   // Of the primary series, while shown
+    BinRange m_densityDirtyRows;            // Rows to upload to the density texture
+    QStringList m_metricsText;
+    QTimer m_metricsTimer;
+    QElapsedTimer m_metricsClock;
+    qint64 m_lastRepaints;
+    qint64 m_lastUpdateRequests;
+    QElapsedTimer m_frameClock;             // Render thread only
+    QMetaObject::Connection m_frameSwappedConnection;
+    double m_maxFps;
+    double m_redrawThreshold;
+    QTimer m_governorTimer;
+    QElapsedTimer m_markerFrameClock;
+
     // Chart styling
-    static constexpr int MARGIN = 60;
     static constexpr int LEGEND_HEIGHT = 80;
+    static constexpr int MARKER_RADIUS = ChartPainter::MARKER_RADIUS;
+    static constexpr int MARKER_SEGMENTS = 24;
+    static constexpr int MIN_VIEW_BINS = 4;
+    static constexpr double WHEEL_ZOOM_STEP = 1.25;     // Per wheel notch
+    static constexpr int METRICS_REFRESH_MS = 500;
+    static constexpr qint64 IDLE_FRAME_NS = 250000000;  // Longer gaps are idle, not jank
 };
 
 #endif // CHARTRENDERER_H
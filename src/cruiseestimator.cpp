@@ -0,0 +1,77 @@
+#include "cruiseestimator.h"
+#include <limits>
+
+void CruiseEstimator::reset(const BinLayout &layout)
+{
+    m_layout = layout;
+    const int count = layout.binCount();
+    m_speed.fill(0.0, count);
+    m_speedCount.fill(0, count);
+    m_fuelFlow.fill(0.0, count);
+
+    // Every bin starts out without a speed, so any row will do as the best
+    m_leaves = 1;
+    while (m_leaves < count)
+        m_leaves *= 2;
+    m_tree.fill(-1, 2 * m_leaves);
+    for (int row = 0; row < count; ++row)
+        m_tree[m_leaves + row] = row;
+    for (int node = m_leaves - 1; node >= 1; --node)
+        m_tree[node] = m_tree.at(2 * node) >= 0 ? m_tree.at(2 * node) : m_tree.at(2 * node + 1);
+}
+
+void CruiseEstimator::addSpeed(double rpm, double knots)
+{
+    const int row = m_layout.binIndex(rpm);
+    if (row < 0 || row >= m_speed.size() || !qIsFinite(knots))
+        return;
+
+    // Mean of every reading at first, then moving on with the boat's load
+    const qint64 count = qMin(m_speedCount.at(row) + 1, SPEED_SAMPLES);
+    m_speedCount[row] = count;
+    m_speed[row] += (qMax(0.0, knots) - m_speed.at(row)) / count;
+    update(row);
+}
+
+void CruiseEstimator::setFuelFlow(int row, double litresPerHour)
+{
+    if (row < 0 || row >= m_fuelFlow.size())
+        return;
+
+    m_fuelFlow[row] = litresPerHour;
+    update(row);
+}
+
+double CruiseEstimator::fuelPerNauticalMile(int row) const
+{
+    const double speed = m_speed.at(row);
+    if (m_speedCount.at(row) == 0 || !(speed >= MIN_SPEED) || !qIsFinite(m_fuelFlow.at(row)))
+        return std::numeric_limits<double>::infinity();
+    return qMax(0.0, m_fuelFlow.at(row)) / speed;
+}
+
+int CruiseEstimator::optimalRow() const
+{
+    const int row = m_tree.isEmpty() ? -1 : m_tree.at(1);
+    return row >= 0 && qIsFinite(fuelPerNauticalMile(row)) ? row : -1;
+}
+
+void CruiseEstimator::update(int row)
+{
+    // Only the path from the leaf to the root can change. Ties keep the
+    // left child, the lower RPM.
+    for (int node = (m_leaves + row) / 2; node >= 1; node /= 2) {
+        const int left = m_tree.at(2 * node);
+        const int right = m_tree.at(2 * node + 1);
+        m_tree[node] = better(right, left) ? right : left;
+    }
+}
+
+bool CruiseEstimator::better(int row, int other) const
+{
+    if (row < 0)
+        return false;
+    if (other < 0)
+        return true;
+    return fuelPerNauticalMile(row) < fuelPerNauticalMile(other);
+}
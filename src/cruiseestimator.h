@@ -0,0 +1,47 @@
+#ifndef CRUISEESTIMATOR_H
+#define CRUISEESTIMATOR_H
+
+#include <QList>
+#include "binstore.h"
+
+// Fuel burnt per nautical mile in every RPM bin, and the bin where it is
+// lowest. A bin's speed is the mean of its recent speed readings, its fuel
+// flow the median the statistics learned, and their ratio its economy. A
+// min tree over the bins keeps the most economical one at the root, so a
+// new reading or median costs O(log n) and the answer O(1); nothing is
+// ever rescanned.
+class CruiseEstimator
+{
+public:
+    static constexpr qint64 SPEED_SAMPLES = 3000;  // Readings a bin's speed averages over, a minute at 50 Hz
+    static constexpr double MIN_SPEED = 1.0;        // Knots; slower bins are not under way and never optimal
+
+    void reset(const BinLayout &layout);
+    const BinLayout &layout() const { return m_layout; }
+
+    // Speed over ground in knots while the engine ran at rpm. Readings
+    // outside the layout, or not finite, are ignored.
+    void addSpeed(double rpm, double knots);
+    void setFuelFlow(int row, double litresPerHour);
+
+    double speed(int row) const { return m_speed.at(row); }
+
+    // L/NM, infinite while the bin has no speed of at least MIN_SPEED
+    double fuelPerNauticalMile(int row) const;
+
+    // Bin with the lowest fuelPerNauticalMile(), -1 while no bin has one
+    int optimalRow() const;
+
+private:
+    void update(int row);
+    bool better(int row, int other) const;
+
+    BinLayout m_layout;
+    QList<double> m_speed;
+    QList<qint64> m_speedCount;
+    QList<double> m_fuelFlow;
+    int m_leaves = 0;                   // Power of two of at least the bin count
+    QList<int> m_tree;                  // Node i holds the best row below it, -1 for none; leaves start at m_leaves
+};
+
+#endif // CRUISEESTIMATOR_H
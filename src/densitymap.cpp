@@ -0,0 +1,127 @@
+#include "densitymap.h"
+#include <QtMath>
+#include <cmath>
+
+namespace {
+
+// Colour scale, from a faint violet for single samples to a bright yellow
+// for the densest cells
+struct PaletteStop {
+    double position;
+    int red, green, blue, alpha;
+};
+
+const PaletteStop PALETTE_STOPS[] = {
+    { 0.0, 60, 30, 120, 90 },
+    { 0.35, 150, 40, 140, 160 },
+    { 0.7, 240, 110, 40, 220 },
+    { 1.0, 255, 240, 120, 255 },
+};
+
+// Same stretch as the density fragment shader
+int paletteIndex(int level, int maxLevel)
+{
+    if (level == 0)
+        return 0;
+    const double t = maxLevel > 1 ? double(level - 1) / (maxLevel - 1) : 1.0;
+    return 1 + qRound(qBound(0.0, t, 1.0) * (DensityMap::MAX_LEVEL - 1));
+}
+
+} // namespace
+
+void DensityMap::reset(const DensityGrid &grid)
+{
+    m_layout = grid.layout;
+    m_rows = grid.size();
+    m_levels.fill(0, qsizetype(m_rows) * columns());
+    m_cells.fill(0);
+    m_cells[0] = m_rows * columns();
+    m_maxLevel = 0;
+    update(grid, 0, m_rows - 1);
+}
+
+void DensityMap::update(const DensityGrid &grid, int firstRow, int lastRow)
+{
+    if (grid.size() != m_rows || grid.layout != m_layout) {
+        reset(grid);
+        return;
+    }
+
+    for (int row = qMax(0, firstRow); row <= lastRow && row < m_rows; ++row) {
+        const QList<quint32> &counts = grid.rows.at(row);
+        const bool empty = counts.size() != columns();
+        for (int column = 0; column < columns(); ++column)
+            setLevel(row * columns() + column, empty ? 0 : level(counts.at(column)));
+    }
+
+    // Cells only ever move between levels, so the new maximum is the
+    // highest level still occupied
+    while (m_maxLevel > 0 && m_cells[m_maxLevel] == 0)
+        --m_maxLevel;
+}
+
+void DensityMap::clear()
+{
+    *this = DensityMap();
+}
+
+int DensityMap::level(quint32 count)
+{
+    if (count == 0)
+        return 0;
+    return qMin(MAX_LEVEL, 1 + qRound(LEVELS_PER_DOUBLING * std::log2(double(count))));
+}
+
+QImage DensityMap::palette()
+{
+    QImage image(MAX_LEVEL + 1, 1, QImage::Format_ARGB32_Premultiplied);
+    auto *pixels = reinterpret_cast<QRgb *>(image.scanLine(0));
+    pixels[0] = qRgba(0, 0, 0, 0);
+
+    int stop = 0;
+    for (int i = 1; i <= MAX_LEVEL; ++i) {
+        const double t = double(i - 1) / (MAX_LEVEL - 1);
+        while (t > PALETTE_STOPS[stop + 1].position)
+            ++stop;
+        const PaletteStop &from = PALETTE_STOPS[stop];
+        const PaletteStop &to = PALETTE_STOPS[stop + 1];
+        const double f = (t - from.position) / (to.position - from.position);
+        auto mix = [f](int a, int b) { return qRound(a + (b - a) * f); };
+        pixels[i] = qPremultiply(qRgba(mix(from.red, to.red), mix(from.green, to.green),
+                                       mix(from.blue, to.blue), mix(from.alpha, to.alpha)));
+    }
+    return image;
+}
+
+QImage DensityMap::toImage(int firstRow, int lastRow) const
+{
+    firstRow = qMax(0, firstRow);
+    lastRow = qMin(m_rows - 1, lastRow);
+    if (lastRow < firstRow)
+        return QImage();
+
+    static const QImage colours = palette();
+    const auto *scale = reinterpret_cast<const QRgb *>(colours.constScanLine(0));
+
+    QImage image(lastRow - firstRow + 1, columns(), QImage::Format_ARGB32_Premultiplied);
+    for (int column = 0; column < columns(); ++column) {
+        auto *pixels = reinterpret_cast<QRgb *>(image.scanLine(columns() - 1 - column));
+        for (int row = firstRow; row <= lastRow; ++row) {
+            const int level = uchar(m_levels.at(qsizetype(row) * columns() + column));
+            pixels[row - firstRow] = scale[paletteIndex(level, m_maxLevel)];
+        }
+    }
+    return image;
+}
+
+void DensityMap::setLevel(int cell, int level)
+{
+    const int current = uchar(m_levels.at(cell));
+    if (current == level)
+        return;
+
+    --m_cells[current];
+    ++m_cells[level];
+    m_levels[cell] = char(level);
+    m_maxLevel = qMax(m_maxLevel, level);
+}
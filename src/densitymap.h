@@ -0,0 +1,54 @@
+#ifndef DENSITYMAP_H
+#define DENSITYMAP_H
+
+#include <QByteArray>
+#include <QImage>
+#include <array>
+#include "binstore.h"
+
+// DensityGrid reduced to one byte per cell, for display: a row per bin and
+// a column per fuel flow bucket. Levels grow with the logarithm of the
+// count, LEVELS_PER_DOUBLING per doubling, and 0 means no samples, so the
+// mapping never depends on the rest of the grid and changed rows can be
+// converted, and uploaded, on their own. The colour scale is stretched over
+// 1..maxLevel() when drawing.
+class DensityMap
+{
+public:
+    static constexpr int LEVELS_PER_DOUBLING = 8;
+    static constexpr int MAX_LEVEL = 255;
+
+    int rows() const { return m_rows; }
+    int columns() const { return DensityGrid::BUCKETS; }
+    bool isEmpty() const { return m_rows == 0; }
+    const BinLayout &layout() const { return m_layout; }
+    const QByteArray &levels() const { return m_levels; }
+
+    // Highest level of any cell, 0 while there are no samples
+    int maxLevel() const { return m_maxLevel; }
+
+    void reset(const DensityGrid &grid);
+    void update(const DensityGrid &grid, int firstRow, int lastRow);
+    void clear();
+
+    static int level(quint32 count);
+
+    // MAX_LEVEL + 1 premultiplied colours from faint to saturated, as one
+    // row; colour 0 is transparent
+    static QImage palette();
+
+    // Colour-maps rows first..last into an image with one pixel per cell,
+    // bins from left to right and fuel flow upwards
+    QImage toImage(int firstRow, int lastRow) const;
+
+private:
+    void setLevel(int cell, int level);
+
+    BinLayout m_layout;
+    int m_rows = 0;
+    QByteArray m_levels;                        // rows() x columns(), row-major
+    std::array<int, MAX_LEVEL + 1> m_cells {};  // Number of cells at each level
+    int m_maxLevel = 0;
+};
+
+#endif // DENSITYMAP_H
@@ -0,0 +1,148 @@
+#include "densitymaterial.h"
+#include <QMatrix4x4>
+#include <QSGMaterialShader>
+#include <rhi/qrhi.h>
+#include <cstring>
+
+namespace {
+
+class DensityShader : public QSGMaterialShader
+{
+public:
+    DensityShader()
+    {
+        setShaderFileName(VertexStage, QStringLiteral(":/BoatPerformanceChart/shaders/density.vert.qsb"));
+        setShaderFileName(FragmentStage, QStringLiteral(":/BoatPerformanceChart/shaders/density.frag.qsb"));
+    }
+
+    bool updateUniformData(RenderState &state, QSGMaterial *newMaterial, QSGMaterial *oldMaterial) override
+    {
+        Q_UNUSED(oldMaterial)
+
+        // Same std140 block as the shaders: qt_Matrix, qt_Opacity, maxLevel
+        QByteArray *buffer = state.uniformData();
+        if (state.isMatrixDirty()) {
+            const QMatrix4x4 matrix = state.combinedMatrix();
+            std::memcpy(buffer->data(), matrix.constData(), 64);
+        }
+        if (state.isOpacityDirty()) {
+            const float opacity = state.opacity();
+            std::memcpy(buffer->data() + 64, &opacity, 4);
+        }
+        const float maxLevel = static_cast<DensityMaterial *>(newMaterial)->maxLevel();
+        std::memcpy(buffer->data() + 68, &maxLevel, 4);
+        return true;
+    }
+
+    void updateSampledImage(RenderState &state, int binding, QSGTexture **texture,
+                            QSGMaterial *newMaterial, QSGMaterial *oldMaterial) override
+    {
+        Q_UNUSED(oldMaterial)
+
+        auto *material = static_cast<DensityMaterial *>(newMaterial);
+        QSGTexture *sampled = binding == 1 ? static_cast<QSGTexture *>(material->levels()) : material->palette();
+        sampled->commitTextureOperations(state.rhi(), state.resourceUpdateBatch());
+        *texture = sampled;
+    }
+};
+
+} // namespace
+
+DensityTexture::~DensityTexture()
+{
+    delete m_texture;
+}
+
+void DensityTexture::setLevels(const QByteArray &levels, int columns, int rows, int firstRow, int lastRow)
+{
+    m_levels = levels;
+    if (m_size != QSize(columns, rows)) {
+        m_size = QSize(columns, rows);
+        delete m_texture;
+        m_texture = nullptr;
+    }
+
+    if (m_lastDirtyRow < m_firstDirtyRow) {
+        m_firstDirtyRow = firstRow;
+        m_lastDirtyRow = lastRow;
+    } else {
+        m_firstDirtyRow = qMin(m_firstDirtyRow, firstRow);
+        m_lastDirtyRow = qMax(m_lastDirtyRow, lastRow);
+    }
+}
+
+void DensityTexture::commitTextureOperations(QRhi *rhi, QRhiResourceUpdateBatch *resourceUpdates)
+{
+    if (m_size.isEmpty())
+        return;
+
+    // A new texture has no contents yet
+    if (!m_texture) {
+        m_texture = rhi->newTexture(QRhiTexture::R8, m_size);
+        if (!m_texture->create()) {
+            delete m_texture;
+            m_texture = nullptr;
+            return;
+        }
+        m_firstDirtyRow = 0;
+        m_lastDirtyRow = m_size.height() - 1;
+    }
+
+    const int first = qMax(0, m_firstDirtyRow);
+    const int last = qMin(m_size.height() - 1, m_lastDirtyRow);
+    if (last >= first) {
+        const int width = m_size.width();
+        QRhiTextureSubresourceUploadDescription rows(m_levels.constData() + qsizetype(first) * width,
+                                                     quint32((last - first + 1) * width));
+        rows.setSourceSize(QSize(width, last - first + 1));
+        rows.setDestinationTopLeft(QPoint(0, first));
+        resourceUpdates->uploadTexture(m_texture, QRhiTextureUploadEntry(0, 0, rows));
+    }
+    m_firstDirtyRow = 0;
+    m_lastDirtyRow = -1;
+}
+
+DensityMaterial::DensityMaterial()
+    : m_levels(new DensityTexture)
+    , m_palette(nullptr)
+    , m_maxLevel(0)
+{
+    // One texel per cell and palette entry, never blended between them
+    m_levels->setFiltering(QSGTexture::Nearest);
+    setFlag(Blending);
+}
+
+DensityMaterial::~DensityMaterial()
+{
+    delete m_levels;
+    delete m_palette;
+}
+
+QSGMaterialType *DensityMaterial::type() const
+{
+    static QSGMaterialType type;
+    return &type;
+}
+
+QSGMaterialShader *DensityMaterial::createShader(QSGRendererInterface::RenderMode renderMode) const
+{
+    Q_UNUSED(renderMode)
+    return new DensityShader;
+}
+
+int DensityMaterial::compare(const QSGMaterial *other) const
+{
+    const auto *material = static_cast<const DensityMaterial *>(other);
+    if (m_levels != material->m_levels)
+        return m_levels < material->m_levels ? -1 : 1;
+    if (m_palette != material->m_palette)
+        return m_palette < material->m_palette ? -1 : 1;
+    return m_maxLevel - material->m_maxLevel;
+}
+
+void DensityMaterial::setPalette(QSGTexture *palette)
+{
+    delete m_palette;
+    m_palette = palette;
+    m_palette->setFiltering(QSGTexture::Nearest);
+}
@@ -0,0 +1,64 @@
+#ifndef DENSITYMATERIAL_H
+#define DENSITYMATERIAL_H
+
+#include <QByteArray>
+#include <QSGMaterial>
+#include <QSGTexture>
+
+class QRhiTexture;
+
+// Single-channel texture of a DensityMap's levels. Only the rows marked
+// with setLevels() are uploaded when the scene graph next commits it; a
+// new size re-creates and fills the whole texture.
+class DensityTexture : public QSGTexture
+{
+public:
+    ~DensityTexture() override;
+
+    // Takes a shallow copy of levels, rows of columns bytes each
+    void setLevels(const QByteArray &levels, int columns, int rows, int firstRow, int lastRow);
+
+    qint64 comparisonKey() const override { return qint64(quintptr(this)); }
+    QRhiTexture *rhiTexture() const override { return m_texture; }
+    QSize textureSize() const override { return m_size; }
+    bool hasAlphaChannel() const override { return false; }
+    bool hasMipmaps() const override { return false; }
+    void commitTextureOperations(QRhi *rhi, QRhiResourceUpdateBatch *resourceUpdates) override;
+
+private:
+    QRhiTexture *m_texture = nullptr;
+    QSize m_size;
+    QByteArray m_levels;
+    int m_firstDirtyRow = 0;
+    int m_lastDirtyRow = -1;
+};
+
+// Colours density levels on the GPU: the fragment shader stretches them
+// over 1..maxLevel and looks them up in a palette texture, so a changed
+// maximum costs a uniform rather than a new texture.
+class DensityMaterial : public QSGMaterial
+{
+public:
+    DensityMaterial();
+    ~DensityMaterial() override;
+
+    QSGMaterialType *type() const override;
+    QSGMaterialShader *createShader(QSGRendererInterface::RenderMode renderMode) const override;
+    int compare(const QSGMaterial *other) const override;
+
+    DensityTexture *levels() const { return m_levels; }
+
+    // Takes ownership of palette
+    void setPalette(QSGTexture *palette);
+    QSGTexture *palette() const { return m_palette; }
+
+    int maxLevel() const { return m_maxLevel; }
+    void setMaxLevel(int level) { m_maxLevel = level; }
+
+private:
+    DensityTexture *m_levels;
+    QSGTexture *m_palette;
+    int m_maxLevel;
+};
+
+#endif // DENSITYMATERIAL_H
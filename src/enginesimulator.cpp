@@ -0,0 +1,127 @@
+#include "enginesimulator.h"
+#include "chartdatamodel.h"
+#include "workerpool.h"
+#include <cmath>
+#include <vector>
+
+namespace {
+
+QRandomGenerator seededGenerator(quint64 seed)
+{
+    // All 64 bits of the seed count
+    const quint32 seedBuffer[] = { quint32(seed), quint32(seed >> 32) };
+    return QRandomGenerator(seedBuffer);
+}
+
+} // namespace
+
+SimulationProfile SimulationProfile::drive(double rateHz, double maxRpm)
+{
+    SimulationProfile profile;
+    profile.rateHz = rateHz;
+    profile.maxRpm = maxRpm;
+    profile.meanLegSeconds = 20.0;
+    profile.loadVariation = 0.2;
+    profile.dropoutsPerHour = 4.0;
+    return profile;
+}
+
+EngineSimulator::EngineSimulator(quint64 seed, const SimulationProfile &profile)
+    : m_profile(profile)
+    , m_generator(seededGenerator(seed))
+    , m_sampleIndex(0)
+    , m_rpm(1500.0)
+    , m_targetRpm(1500.0)
+    , m_load(1.0)
+    , m_targetLoad(1.0)
+    , m_legRemaining(0)
+    , m_dropoutRemaining(0)
+{
+    m_profile.rateHz = qMax(0.001, m_profile.rateHz);
+}
+
+qint64 EngineSimulator::timestampMs() const
+{
+    // Derived from the index rather than accumulated, so rates that are no
+    // whole number of milliseconds do not drift
+    return m_profile.startTimestampMs + qint64(m_sampleIndex * 1000.0 / m_profile.rateHz);
+}
+
+int EngineSimulator::generate(TelemetrySample *out, int count)
+{
+    const double dropoutChance = m_profile.dropoutsPerHour / (3600.0 * m_profile.rateHz);
+
+    int written = 0;
+    for (int i = 0; i < count; ++i) {
+        const qint64 timestamp = timestampMs();
+        ++m_sampleIndex;
+
+        if (m_profile.meanLegSeconds > 0.0 && --m_legRemaining <= 0)
+            startLeg();
+
+        // First-order lag towards the throttle setting and the hull load
+        m_rpm += (m_targetRpm - m_rpm) * m_profile.rpmLag;
+        m_load += (m_targetLoad - m_load) * 0.01;
+
+        // The engine keeps running through a dropout; only its samples are lost
+        const double noise = (m_generator.generateDouble() - 0.5) * 2.0 * m_profile.noise;
+        if (m_dropoutRemaining > 0) {
+            --m_dropoutRemaining;
+            continue;
+        }
+        if (dropoutChance > 0.0 && m_generator.generateDouble() < dropoutChance) {
+            m_dropoutRemaining = qMax<qint64>(1, qRound64(exponential(m_profile.meanDropoutSeconds) * m_profile.rateHz));
+            continue;
+        }
+
+        out[written].timestampMs = timestamp;
+        out[written].rpm = m_rpm;
+        out[written].fuelFlow = ChartDataModel::baseFuelFlow(m_rpm, m_profile.maxRpm) * m_load * (1.0 + noise);
+
+        // A heavier hull makes less way for the same RPM
+        out[written].speed = m_profile.maxSpeed * (m_rpm / m_profile.maxRpm) / std::sqrt(m_load);
+        ++written;
+    }
+    return written;
+}
+
+void EngineSimulator::startLeg()
+{
+    m_targetRpm = m_profile.idleRpm + m_generator.generateDouble() * (m_profile.maxRpm - m_profile.idleRpm);
+    m_targetLoad = 1.0 + (m_generator.generateDouble() * 2.0 - 1.0) * m_profile.loadVariation;
+    m_legRemaining = qMax<qint64>(1, qRound64(exponential(m_profile.meanLegSeconds) * m_profile.rateHz));
+}
+
+double EngineSimulator::exponential(double mean)
+{
+    return -mean * std::log(1.0 - m_generator.generateDouble());
+}
+
+quint64 EngineSimulator::streamSeed(quint64 seed, int stream)
+{
+    // splitmix64 finalizer, so neighbouring streams get unrelated generators
+    quint64 z = seed + (quint64(stream) + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void EngineSimulator::run(quint64 seed, const SimulationProfile &profile, int streamCount,
+                          qint64 samplesPerStream, int threadCount,
+                          const std::function<void(int, const TelemetrySample *, int)> &sink)
+{
+    static constexpr int CHUNK = 4096;
+
+    // Workers take whole streams, so every stream is generated sequentially
+    threadCount = WorkerPool::workerCount(threadCount, streamCount);
+    std::vector<std::vector<TelemetrySample>> chunks(threadCount, std::vector<TelemetrySample>(CHUNK));
+    WorkerPool::run(streamCount, threadCount, QStringLiteral("EngineSimulator"), [&](int worker, int stream) {
+        std::vector<TelemetrySample> &chunk = chunks[worker];
+        EngineSimulator simulator(streamSeed(seed, stream), profile);
+        for (qint64 done = 0; done < samplesPerStream; done += CHUNK) {
+            const int count = simulator.generate(chunk.data(), int(qMin<qint64>(CHUNK, samplesPerStream - done)));
+            if (count > 0)
+                sink(stream, chunk.data(), count);
+        }
+    });
+}
@@ -0,0 +1,76 @@
+#ifndef ENGINESIMULATOR_H
+#define ENGINESIMULATOR_H
+
+#include <QRandomGenerator>
+#include <functional>
+#include "telemetrysample.h"
+
+// Shape of a simulated engine trace. The defaults follow the throttle only,
+// like the interactive simulator always did; drive() adds a scripted trip.
+struct SimulationProfile {
+    double rateHz = 50.0;
+    double maxRpm = 6000.0;
+    double idleRpm = 700.0;
+    double rpmLag = 0.05;               // Share of the gap to the target closed per sample
+    double meanLegSeconds = 0.0;        // Mean time between scripted throttle changes; 0 follows setTargetRpm()
+    double loadVariation = 0.0;         // Hull load drifts within 1 ± this, changing with each leg
+    double noise = 0.15;                // Fuel flow noise, ± share of the nominal flow
+    double maxSpeed = 30.0;             // Knots at maxRpm under nominal load
+    double dropoutsPerHour = 0.0;       // Sensor dropouts, during which no samples arrive
+    double meanDropoutSeconds = 3.0;
+    qint64 startTimestampMs = 0;
+
+    // Throttle ramps every 20 s on average, ±20% load and a few dropouts an hour
+    static SimulationProfile drive(double rateHz = 50.0, double maxRpm = 6000.0);
+};
+
+// Reproducible engine model for load and soak tests. The same seed and
+// profile always produce the same samples, bit for bit, however they are
+// chunked and on whatever thread: nothing reads the clock or a shared
+// generator.
+class EngineSimulator
+{
+public:
+    explicit EngineSimulator(quint64 seed = 0, const SimulationProfile &profile = SimulationProfile());
+
+    const SimulationProfile &profile() const { return m_profile; }
+
+    // Throttle setting; scripted legs replace it when the next leg starts
+    double targetRpm() const { return m_targetRpm; }
+    void setTargetRpm(double rpm) { m_targetRpm = rpm; }
+
+    // Time of the next sample period
+    qint64 timestampMs() const;
+
+    // Advances by count sample periods and writes the samples that were not
+    // lost to a dropout. Returns the number written.
+    int generate(TelemetrySample *out, int count);
+
+    // Seed of one of several independent streams of a run
+    static quint64 streamSeed(quint64 seed, int stream);
+
+    // Simulates samplesPerStream sample periods for each of streamCount
+    // streams on up to threadCount threads. Stream i uses
+    // streamSeed(seed, i), so the output does not depend on threadCount.
+    // sink receives each stream's chunks in order, but is called
+    // concurrently for different streams.
+    static void run(quint64 seed, const SimulationProfile &profile, int streamCount,
+                    qint64 samplesPerStream, int threadCount,
+                    const std::function<void(int stream, const TelemetrySample *samples, int count)> &sink);
+
+private:
+    void startLeg();
+    double exponential(double mean);
+
+    SimulationProfile m_profile;
+    QRandomGenerator m_generator;
+    qint64 m_sampleIndex;
+    double m_rpm;
+    double m_targetRpm;
+    double m_load;
+    double m_targetLoad;
+    qint64 m_legRemaining;              // Samples until the next scripted leg
+    qint64 m_dropoutRemaining;          // Samples still lost to the current dropout
+};
+
+#endif // ENGINESIMULATOR_H
@@ -0,0 +1,181 @@
+#include "fleetsketch.h"
+#include "samplelog.h"
+#include "workerpool.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <vector>
+
+FleetSketch::FleetSketch(const BinLayout &layout)
+    : m_layout(layout)
+    , m_bins(layout.binCount(), QuantileSketch(layout.minFuelFlow, layout.maxFuelFlow))
+{
+}
+
+qint64 FleetSketch::sampleCount() const
+{
+    qint64 count = 0;
+    for (const QuantileSketch &bin : m_bins)
+        count += bin.count();
+    return count;
+}
+
+void FleetSketch::add(double rpm, double fuelFlow)
+{
+    const int row = m_layout.binIndex(rpm);
+    if (row >= 0 && row < m_bins.size())
+        m_bins[row].add(fuelFlow);
+}
+
+void FleetSketch::addLog(SampleLog &log)
+{
+    log.scan(0, SampleLog::Rpm | SampleLog::FuelFlow, [this](const SampleLog::Columns &columns) {
+        for (qint64 i = 0; i < columns.count; ++i)
+            add(columns.rpm[i], columns.fuelFlow[i]);
+    });
+    ++m_logCount;
+}
+
+bool FleetSketch::merge(const FleetSketch &other)
+{
+    if (other.isEmpty())
+        return true;
+    if (isEmpty()) {
+        *this = other;
+        return true;
+    }
+    if (m_layout != other.m_layout || m_bins.size() != other.m_bins.size())
+        return false;
+
+    for (int row = 0; row < m_bins.size(); ++row)
+        m_bins[row].merge(other.m_bins.at(row));
+    m_logCount += other.m_logCount;
+    return true;
+}
+
+BinStore FleetSketch::envelope(double lowerPercentile, double upperPercentile, const BinStore &baseline) const
+{
+    BinStore result = baseline;
+    if (isEmpty() || result.isEmpty())
+        return result;
+
+    const BinLayout &layout = result.layout;
+    QList<QuantileSketch> rows(result.size(), QuantileSketch(m_layout.minFuelFlow, m_layout.maxFuelFlow));
+    for (int bin = 0; bin < m_bins.size(); ++bin) {
+        const int row = layout.binIndex(m_layout.binRpm(bin));
+        if (row >= 0)
+            rows[row].merge(m_bins.at(bin));
+    }
+
+    for (int row = 0; row < result.size(); ++row) {
+        const QuantileSketch *sketch = &rows.at(row);
+        if (sketch->count() == 0) {
+            const int nearest = m_layout.binIndex(result.rpm.at(row));
+            if (nearest < 0 || m_bins.at(nearest).count() == 0)
+                continue;
+            sketch = &m_bins.at(nearest);
+        }
+
+        result.minFuelFlow[row] = sketch->quantile(lowerPercentile);
+        result.medianFuelFlow[row] = sketch->quantile(0.5);
+        result.maxFuelFlow[row] = sketch->quantile(upperPercentile);
+    }
+    return result;
+}
+
+bool FleetSketch::save(const QString &path) const
+{
+    QByteArray payload;
+    QDataStream payloadStream(&payload, QIODevice::WriteOnly);
+    payloadStream.setVersion(QDataStream::Qt_6_0);
+    payloadStream << m_logCount << qint32(m_bins.size());
+    for (const QuantileSketch &bin : m_bins)
+        payloadStream << bin;
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "FleetSketch: cannot write" << path;
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << MAGIC << VERSION << m_layout.minRpm << m_layout.maxRpm << m_layout.binWidth
+           << m_layout.minFuelFlow << m_layout.maxFuelFlow << qCompress(payload);
+
+    if (!file.commit()) {
+        qWarning() << "FleetSketch: cannot write" << path;
+        return false;
+    }
+    return true;
+}
+
+bool FleetSketch::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "FleetSketch: cannot read" << path;
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    BinLayout layout;
+    QByteArray compressed;
+    stream >> magic >> version >> layout.minRpm >> layout.maxRpm >> layout.binWidth
+           >> layout.minFuelFlow >> layout.maxFuelFlow >> compressed;
+    if (stream.status() != QDataStream::Ok || magic != MAGIC || version != VERSION || layout.binCount() <= 0) {
+        qWarning() << "FleetSketch: not a fleet sketch" << path;
+        return false;
+    }
+
+    const QByteArray payload = qUncompress(compressed);
+    QDataStream payloadStream(payload);
+    payloadStream.setVersion(QDataStream::Qt_6_0);
+
+    qint64 logCount = 0;
+    qint32 binCount = 0;
+    payloadStream >> logCount >> binCount;
+    FleetSketch sketch(layout);
+    bool valid = payloadStream.status() == QDataStream::Ok && binCount == sketch.m_bins.size();
+    for (int row = 0; valid && row < binCount; ++row) {
+        payloadStream >> sketch.m_bins[row];
+        valid = payloadStream.status() == QDataStream::Ok
+            && sketch.m_bins.at(row).minValue() == layout.minFuelFlow
+            && sketch.m_bins.at(row).maxValue() == layout.maxFuelFlow;
+    }
+    if (!valid) {
+        qWarning() << "FleetSketch: corrupt fleet sketch" << path;
+        return false;
+    }
+
+    sketch.m_logCount = logCount;
+    *this = sketch;
+    return true;
+}
+
+FleetSketch FleetSketch::aggregate(const QStringList &logDirectories, const BinLayout &layout, int threadCount)
+{
+    // Map: every thread sketches whole logs into its own partial sketch
+    threadCount = WorkerPool::workerCount(threadCount, int(logDirectories.size()));
+    std::vector<FleetSketch> partials(threadCount, FleetSketch(layout));
+    WorkerPool::run(int(logDirectories.size()), threadCount, QStringLiteral("FleetSketch"),
+                    [&](int worker, int i) {
+        SampleLog log(logDirectories.at(i));
+        if (!log.open(SampleLog::ReadOnly)) {
+            qWarning() << "FleetSketch: cannot read" << logDirectories.at(i);
+            return;
+        }
+        partials[worker].addLog(log);
+    });
+
+    // Reduce: merging is exact, so the order does not matter
+    FleetSketch result(layout);
+    for (const FleetSketch &partial : partials)
+        result.merge(partial);
+    return result;
+}
@@ -0,0 +1,61 @@
+#ifndef FLEETSKETCH_H
+#define FLEETSKETCH_H
+
+#include <QList>
+#include <QStringList>
+#include "binstore.h"
+#include "quantilesketch.h"
+
+class SampleLog;
+
+// Fuel-flow distribution of every RPM bin across a fleet, as one mergeable
+// QuantileSketch per bin of a BinLayout. Sketches of the same layout merge
+// exactly and in any order, so a fleet is aggregated map-reduce style:
+// per log and core, then across machines by merging their files.
+//
+// A boat loads the result as its reference curve, see
+// ChartDataModel::setFleetSketch().
+class FleetSketch
+{
+public:
+    FleetSketch() = default;
+    explicit FleetSketch(const BinLayout &layout);
+
+    const BinLayout &layout() const { return m_layout; }
+    bool isEmpty() const { return m_bins.isEmpty(); }
+    qint64 sampleCount() const;
+    qint64 logCount() const { return m_logCount; }
+    const QuantileSketch &bin(int row) const { return m_bins.at(row); }
+
+    // Samples outside the layout's RPM range are ignored
+    void add(double rpm, double fuelFlow);
+    void addLog(SampleLog &log);
+
+    // Adds other's bins; false, and nothing merged, if the layouts differ.
+    // An empty sketch takes on other's layout.
+    bool merge(const FleetSketch &other);
+
+    // Envelope at the given percentiles, re-binned to baseline's layout:
+    // each row merges the sketch bins whose centres it covers, or takes the
+    // nearest one when it is narrower than they are. Rows the fleet never
+    // visited keep baseline's values.
+    BinStore envelope(double lowerPercentile, double upperPercentile, const BinStore &baseline) const;
+
+    // Compressed file holding the layout and the sketches
+    bool save(const QString &path) const;
+    bool load(const QString &path);
+
+    // Sketch of every log in logDirectories, read by threadCount threads
+    // that each fill their own sketch before all of them are merged
+    static FleetSketch aggregate(const QStringList &logDirectories, const BinLayout &layout, int threadCount);
+
+private:
+    static constexpr quint32 MAGIC = 0x4B534642;        // "BFSK"
+    static constexpr quint32 VERSION = 1;
+
+    BinLayout m_layout;
+    QList<QuantileSketch> m_bins;
+    qint64 m_logCount = 0;
+};
+
+#endif // FLEETSKETCH_H
@@ -0,0 +1,42 @@
+#ifndef HISTOGRAMQUANTILE_H
+#define HISTOGRAMQUANTILE_H
+
+#include <QtGlobal>
+
+// Equal-width bucket histograms over [minValue, maxValue], as kept by
+// WindowedQuantiles and QuantileSketch. Values outside the range count
+// towards the outermost buckets. Quantiles are interpolated within the
+// bucket that holds their rank, so they resolve to
+// (maxValue - minValue) / buckets.
+class HistogramQuantile
+{
+public:
+    static int bucket(double value, double minValue, double maxValue, int buckets)
+    {
+        return qBound(0, int((value - minValue) / (maxValue - minValue) * buckets), buckets - 1);
+    }
+
+    // counts holds buckets counts adding up to total; 0 when total is 0
+    template <typename Count>
+    static double quantile(const Count *counts, int buckets, qint64 total,
+                           double minValue, double maxValue, double probability)
+    {
+        if (total == 0)
+            return 0.0;
+
+        // Walk the cumulative counts and interpolate inside the bucket that
+        // holds the rank
+        const double rank = qBound(0.0, probability, 1.0) * total;
+        const double width = (maxValue - minValue) / buckets;
+        double below = 0.0;
+        for (int bucket = 0; bucket < buckets; ++bucket) {
+            const Count count = counts[bucket];
+            if (count > 0 && below + count >= rank)
+                return minValue + (bucket + (rank - below) / count) * width;
+            below += count;
+        }
+        return maxValue;
+    }
+};
+
+#endif // HISTOGRAMQUANTILE_H
@@ -1,23 +1,304 @@
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
+#include <QCommandLineParser>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
 #include "chartdatamodel.h"
 #include "chartrenderer.h"
+#include "fleetsketch.h"
+#include "metrics.h"
+#include "nmeasimulator.h"
+#include "reportexporter.h"
+#include "samplelog.h"
+#include "telemetryingestor.h"
+#include "telemetrysource.h"
+#include "tripreplay.h"
+#include "vesselmodel.h"
 
 int main(int argc, char *argv[])
 {
+    // Reports, fleet aggregation and the gateway simulator run headless and
+    // never need a display
+    for (int i = 1; i < argc; ++i) {
+        const bool headless = qstrncmp(argv[i], "--report", 8) == 0 || qstrcmp(argv[i], "--aggregate-fleet") == 0
+            || qstrcmp(argv[i], "--serve-nmea") == 0;
+        if (headless && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     QGuiApplication app(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption simulateOption("simulate-telemetry",
+                                      "Feed the chart from a simulated engine on a worker thread.");
+    QCommandLineOption enginesOption("engines",
+                                     "Number of engines on the vessel (default 1).", "count", "1");
+    QCommandLineOption rateOption("telemetry-rate",
+                                  "Simulated sample rate in Hz (default 50).", "hz", "50");
+    QCommandLineOption seedOption("seed",
+                                  "Seed the simulated engines and sample data, for reproducible runs.", "seed");
+    QCommandLineOption simulationSpeedOption("simulation-speed",
+                                             "Simulated seconds per wall clock second (default 1, 0 for unthrottled).",
+                                             "factor", "1");
+    QCommandLineOption scriptedDriveOption("scripted-drive",
+                                           "Let the simulated engines drive a random trip instead of following the throttle.");
+    QCommandLineOption historyOption("history-dir",
+                                     "Directory of the persistent sample history.", "dir",
+                                     QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation))
+                                         .filePath("history"));
+    QCommandLineOption replayOption("replay",
+                                    "Replay the trip recorded in dir, laid out like the history directory.",
+                                    "dir");
+    QCommandLineOption binWidthOption("bin-width",
+                                      "RPM covered by one chart bin (default 50).", "rpm", "50");
+    QCommandLineOption maxRpmOption("max-rpm",
+                                    "Rated engine speed, the end of the RPM axis (default 6000).", "rpm", "6000");
+    QCommandLineOption maxFuelFlowOption("max-fuel-flow",
+                                         "End of the fuel flow axis in L/h (default 80).", "lph", "80");
+    QCommandLineOption showMetricsOption("show-metrics",
+                                         "Overlay frame timing and repaint rate on the chart.");
+    QCommandLineOption metricsFileOption("metrics-file",
+                                         "Append timing and counter metrics as JSON lines to file.", "file");
+    QCommandLineOption metricsIntervalOption("metrics-interval",
+                                             "Milliseconds between metrics lines (default 1000).", "ms", "1000");
+    QCommandLineOption maxFpsOption("max-fps",
+                                    "Limit marker redraws per second to save power (default 0, follow vsync).",
+                                    "fps", "0");
+    QCommandLineOption reportOption("report",
+                                    "Render the charts of the given sample log directories into dir and exit.",
+                                    "dir");
+    QCommandLineOption reportFormatOption("report-format",
+                                          "Report image format: png or svg (default png).", "format", "png");
+    QCommandLineOption reportSizeOption("report-size",
+                                        "Report image size in pixels (default 1200x800).", "size", "1200x800");
+    QCommandLineOption reportThreadsOption("report-threads",
+                                           "Charts rendered in parallel (default one per core).", "count",
+                                           QString::number(QThread::idealThreadCount()));
+    QCommandLineOption aggregateFleetOption("aggregate-fleet",
+                                            "Sketch the given sample log directories and fleet sketch files "
+                                            "into one fleet sketch file and exit.",
+                                            "file");
+    QCommandLineOption fleetReferenceOption("fleet-reference",
+                                            "Draw the fleet envelope of a fleet sketch file beneath the chart.",
+                                            "file");
+    QCommandLineOption nmeaOption("nmea",
+                                  "Feed the chart from an engine gateway sending NMEA 0183 sentences or NMEA 2000 "
+                                  "RAW frames, at udp://[host]:port or tcp://host:port.",
+                                  "address");
+    QCommandLineOption serveNmeaOption("serve-nmea",
+                                       "Replay captured NMEA traffic from file to the --nmea address "
+                                       "(default udp://127.0.0.1:10110) until stopped.",
+                                       "file");
+    QCommandLineOption nmeaRateOption("nmea-rate",
+                                      "Lines per second sent by --serve-nmea (default 500, 0 for unthrottled).",
+                                      "lines", "500");
+    parser.addOption(simulateOption);
+    parser.addOption(enginesOption);
+    parser.addOption(rateOption);
+    parser.addOption(seedOption);
+    parser.addOption(simulationSpeedOption);
+    parser.addOption(scriptedDriveOption);
+    parser.addOption(historyOption);
+    parser.addOption(replayOption);
+    parser.addOption(binWidthOption);
+    parser.addOption(maxRpmOption);
+    parser.addOption(maxFuelFlowOption);
+    parser.addOption(maxFpsOption);
+    parser.addOption(showMetricsOption);
+    parser.addOption(metricsFileOption);
+    parser.addOption(metricsIntervalOption);
+    parser.addOption(reportOption);
+    parser.addOption(reportFormatOption);
+    parser.addOption(reportSizeOption);
+    parser.addOption(reportThreadsOption);
+    parser.addOption(aggregateFleetOption);
+    parser.addOption(fleetReferenceOption);
+    parser.addOption(nmeaOption);
+    parser.addOption(serveNmeaOption);
+    parser.addOption(nmeaRateOption);
+    parser.addPositionalArgument("logs",
+                                 "Sample log directories to render with --report, or sample log directories "
+                                 "and fleet sketch files to combine with --aggregate-fleet.",
+                                 "[logs...]");
+    parser.process(app);
+
+    // Enabled before anything is created so that every probe and watched
+    // signal is counted from the start
+    const bool metricsEnabled = parser.isSet(showMetricsOption) || parser.isSet(metricsFileOption);
+    Metrics::setEnabled(metricsEnabled);
+
+    BinLayout layout;
+    layout.binWidth = parser.value(binWidthOption).toDouble();
+    layout.maxRpm = parser.value(maxRpmOption).toDouble();
+    layout.maxFuelFlow = parser.value(maxFuelFlowOption).toDouble();
+
+    if (parser.isSet(reportOption)) {
+        const QString format = parser.value(reportFormatOption);
+        const QStringList size = parser.value(reportSizeOption).split('x');
+        if ((format != "png" && format != "svg") || size.size() != 2) {
+            qCritical("BoatPerformanceChart: invalid report format or size");
+            return 1;
+        }
+
+        ReportExporter exporter;
+        exporter.setFormat(format == "svg" ? ReportExporter::Svg : ReportExporter::Png);
+        exporter.setSize(QSize(size.at(0).toInt(), size.at(1).toInt()));
+        exporter.setLayout(layout);
+        exporter.setThreadCount(parser.value(reportThreadsOption).toInt());
+
+        const QStringList logs = parser.positionalArguments();
+        const int written = exporter.exportCharts(logs, parser.value(reportOption));
+        return written == logs.size() ? 0 : 1;
+    }
+
+    if (parser.isSet(aggregateFleetOption)) {
+        // Directories are read in parallel; sketches from other machines
+        // are merged into the result
+        QStringList logDirectories;
+        QStringList sketchFiles;
+        for (const QString &path : parser.positionalArguments())
+            (QFileInfo(path).isFile() ? sketchFiles : logDirectories).append(path);
+
+        FleetSketch fleet = FleetSketch::aggregate(logDirectories, layout, QThread::idealThreadCount());
+        for (const QString &path : std::as_const(sketchFiles)) {
+            FleetSketch sketch;
+            if (!sketch.load(path) || !fleet.merge(sketch)) {
+                qCritical("BoatPerformanceChart: cannot merge fleet sketch %s", qPrintable(path));
+                return 1;
+            }
+        }
+        return fleet.save(parser.value(aggregateFleetOption)) ? 0 : 1;
+    }
+
+    if (parser.isSet(serveNmeaOption)) {
+        NmeaSimulator simulator;
+        if (!simulator.load(parser.value(serveNmeaOption))) {
+            qCritical("BoatPerformanceChart: cannot read NMEA capture %s", qPrintable(parser.value(serveNmeaOption)));
+            return 1;
+        }
+        const QUrl address(parser.isSet(nmeaOption) ? parser.value(nmeaOption)
+                                                    : QStringLiteral("udp://127.0.0.1:10110"));
+        return simulator.run(address, parser.value(nmeaRateOption).toDouble()) < 0 ? 1 : 0;
+    }
+
     qmlRegisterType<ChartDataModel>("BoatPerformanceChart", 1, 0, "ChartDataModel");
     qmlRegisterType<ChartRenderer>("BoatPerformanceChart", 1, 0, "ChartRenderer");
+    qmlRegisterType<VesselModel>("BoatPerformanceChart", 1, 0, "VesselModel");
 
     QQmlApplicationEngine engine;
+
+    // Declared before the models, whose statistics threads use them
+    std::vector<std::unique_ptr<SampleLog>> sampleLogs;
+
+    // Create and initialize one data model per engine
+    VesselModel vessel(qMax(1, parser.value(enginesOption).toInt()));
+
+    // The fleet reference is a model without history or telemetry
+    std::unique_ptr<ChartDataModel> fleetModel;
+    if (parser.isSet(fleetReferenceOption)) {
+        FleetSketch sketch;
+        if (sketch.load(parser.value(fleetReferenceOption))) {
+            fleetModel = std::make_unique<ChartDataModel>();
+            fleetModel->setLayout(layout);
+            fleetModel->setFleetSketch(sketch);
+        }
+    }
+
+    // Live telemetry is optional; without it the models simulate readings themselves
+    std::vector<std::unique_ptr<TelemetryIngestor>> ingestors;
+    SimulationProfile profile = parser.isSet(scriptedDriveOption) ? SimulationProfile::drive() : SimulationProfile();
+    profile.rateHz = parser.value(rateOption).toDouble();
+    profile.maxRpm = layout.maxRpm;
+
+    // Each engine draws two independent streams from the seed: one for its
+    // sample data, one for its simulator
+    const bool seeded = parser.isSet(seedOption);
+    const quint64 seed = parser.value(seedOption).toULongLong();
+
+    // The first engine keeps a directory itself, so the history of a
+    // single-engine setup carries over
+    auto engineDirectory = [](const QString &directory, int engine) {
+        return engine == 0 ? directory : QDir(directory).filePath(QStringLiteral("engine%1").arg(engine + 1));
+    };
+
+    // A replay takes the place of the live history and telemetry
+    const bool replaying = parser.isSet(replayOption);
+    QStringList replayDirectories;
+
+    for (int i = 0; i < vessel.engineCount(); ++i) {
+        ChartDataModel *dataModel = vessel.engine(i);
+        dataModel->setLayout(layout);
+        if (seeded)
+            dataModel->setRandomSeed(EngineSimulator::streamSeed(seed, 2 * i));
+        dataModel->generateSampleData();
+
+        if (replaying) {
+            replayDirectories.append(engineDirectory(parser.value(replayOption), i));
+            sampleLogs.push_back(std::make_unique<SampleLog>(replayDirectories.last()));
+            sampleLogs.back()->open(SampleLog::ReadOnly);
+            dataModel->attachReplay(sampleLogs.back().get());
+            continue;
+        }
+
+        sampleLogs.push_back(std::make_unique<SampleLog>(engineDirectory(parser.value(historyOption), i)));
+        sampleLogs.back()->open();
+        dataModel->attachHistory(sampleLogs.back().get());
+
+        if (parser.isSet(simulateOption)) {
+            auto ingestor = std::make_unique<TelemetryIngestor>(dataModel);
+            const quint64 simulatorSeed = seeded ? EngineSimulator::streamSeed(seed, 2 * i + 1)
+                                                 : QRandomGenerator::global()->generate64();
+            ingestor->start(std::make_unique<SimulatedTelemetrySource>(profile, simulatorSeed,
+                                                                      parser.value(simulationSpeedOption).toDouble()));
+            ingestors.push_back(std::move(ingestor));
+        }
+    }
+
+    // One gateway connection reads all engines; engine i of the vessel is
+    // instance i on the gateway
+    if (!replaying && !parser.isSet(simulateOption) && parser.isSet(nmeaOption)) {
+        auto ingestor = std::make_unique<TelemetryIngestor>(vessel.engines());
+        ingestor->start(std::make_unique<NmeaTelemetrySource>(QUrl(parser.value(nmeaOption)), 0,
+                                                              vessel.engineCount()));
+        ingestors.push_back(std::move(ingestor));
+    }
+
+    // The UI throttles the first engine; the others follow it
+    TelemetryIngestor *throttle = ingestors.empty() ? nullptr : ingestors.front().get();
+    for (const auto &ingestor : ingestors) {
+        if (ingestor.get() == throttle)
+            continue;
+        QObject::connect(throttle, &TelemetryIngestor::targetRpmChanged, ingestor.get(),
+                         [throttle, follower = ingestor.get()]() { follower->setTargetRpm(throttle->targetRpm()); });
+    }
     
-    // Create and initialize the data model
-    ChartDataModel dataModel;
-    dataModel.generateSampleData();
-    
-    engine.rootContext()->setContextProperty("chartDataModel", &dataModel);
+    std::unique_ptr<TripReplay> tripReplay;
+    if (replaying)
+        tripReplay = std::make_unique<TripReplay>(&vessel, replayDirectories);
+
+    std::unique_ptr<MetricsExporter> metricsExporter;
+    if (parser.isSet(metricsFileOption)) {
+        metricsExporter = std::make_unique<MetricsExporter>(parser.value(metricsFileOption),
+                                                            parser.value(metricsIntervalOption).toInt());
+    }
+    if (metricsEnabled) {
+        for (ChartDataModel *dataModel : vessel.engines())
+            Metrics::watchSignals(dataModel);
+        for (const auto &ingestor : ingestors)
+            Metrics::watchSignals(ingestor.get());
+    }
+
+    engine.rootContext()->setContextProperty("chartDataModel", vessel.engine(0));
+    engine.rootContext()->setContextProperty("vesselModel", &vessel);
+    engine.rootContext()->setContextProperty("showMetricsOverlay", parser.isSet(showMetricsOption));
+    engine.rootContext()->setContextProperty("chartMaxFps", parser.value(maxFpsOption).toDouble());
+    engine.rootContext()->setContextProperty("telemetryIngestor", throttle);
+    engine.rootContext()->setContextProperty("tripReplay", tripReplay.get());
+    engine.rootContext()->setContextProperty("fleetModel", fleetModel.get());
     
     const QUrl url(QStringLiteral("qrc:/BoatPerformanceChart/qml/main.qml"));
     QObject::connect(&engine, &QQmlApplicationEngine::objectCreated,
@@ -28,5 +309,12 @@ int main(int argc, char *argv[])
     
     engine.load(url);
 
-    return app.exec();
+    const int result = app.exec();
+
+    // Stop ingestion first so the final checkpoint covers every logged sample
+    ingestors.clear();
+    tripReplay.reset();
+    for (ChartDataModel *dataModel : vessel.engines())
+        dataModel->saveCheckpoint();
+    return result;
 }
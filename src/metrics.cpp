@@ -0,0 +1,195 @@
+#include "metrics.h"
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QMetaMethod>
+#include <QMutex>
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace {
+
+// Last HISTORY durations of one probe
+struct ProbeHistory {
+    static constexpr int HISTORY = 1024;
+
+    QMutex mutex;
+    std::array<qint64, HISTORY> durations {};
+    qint64 count = 0;
+};
+
+ProbeHistory probeHistories[Metrics::ProbeCount];
+
+// Receiver for watchSignals(); a slot without arguments accepts any signal
+class SignalCounter : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+public slots:
+    void count() { Metrics::add(Metrics::SignalEmissions); }
+};
+
+double percentile(std::vector<qint64> &values, double p)
+{
+    const auto nth = values.begin() + qsizetype(p * (values.size() - 1));
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth / 1e6;
+}
+
+} // namespace
+
+std::atomic<bool> Metrics::s_enabled { false };
+std::atomic<qint64> Metrics::s_counters[Metrics::CounterCount] {};
+
+void Metrics::setEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Metrics::record(Probe probe, qint64 nanoseconds)
+{
+    if (!isEnabled())
+        return;
+
+    ProbeHistory &history = probeHistories[probe];
+    QMutexLocker locker(&history.mutex);
+    history.durations[history.count % ProbeHistory::HISTORY] = nanoseconds;
+    ++history.count;
+}
+
+Metrics::Summary Metrics::summary(Probe probe)
+{
+    ProbeHistory &history = probeHistories[probe];
+    std::vector<qint64> values;
+    Summary result;
+    {
+        QMutexLocker locker(&history.mutex);
+        result.count = history.count;
+        const qint64 retained = qMin<qint64>(history.count, ProbeHistory::HISTORY);
+        values.assign(history.durations.begin(), history.durations.begin() + retained);
+    }
+
+    if (values.empty())
+        return result;
+
+    result.maxMs = *std::max_element(values.begin(), values.end()) / 1e6;
+    result.p99Ms = percentile(values, 0.99);
+    result.p50Ms = percentile(values, 0.5);
+    return result;
+}
+
+const char *Metrics::name(Probe probe)
+{
+    switch (probe) {
+    case FrameInterval: return "frameInterval";
+    case Paint: return "paint";
+    case SceneGraphSync: return "sceneGraphSync";
+    case StaticLayer: return "staticLayer";
+    case DrawGrid: return "drawGrid";
+    case DrawAxes: return "drawAxes";
+    case DrawData: return "drawData";
+    case DrawMedianLine: return "drawMedianLine";
+    case DrawCurrentPoint: return "drawCurrentPoint";
+    case CurrentFuelFlowUpdate: return "currentFuelFlowUpdate";
+    case ModelReset: return "modelReset";
+    case ProbeCount: break;
+    }
+    return "";
+}
+
+const char *Metrics::name(Counter counter)
+{
+    switch (counter) {
+    case Repaints: return "repaints";
+    case UpdateRequests: return "updateRequests";
+    case SignalEmissions: return "signalEmissions";
+    case SamplesIngested: return "samplesIngested";
+    case SamplesDropped: return "samplesDropped";
+    case NmeaLinesRejected: return "nmeaLinesRejected";
+    case CounterCount: break;
+    }
+    return "";
+}
+
+QJsonObject Metrics::snapshot()
+{
+    QJsonObject counters;
+    for (int i = 0; i < CounterCount; ++i)
+        counters.insert(QLatin1String(name(Counter(i))), counter(Counter(i)));
+
+    QJsonObject probes;
+    for (int i = 0; i < ProbeCount; ++i) {
+        const Summary probeSummary = summary(Probe(i));
+        if (probeSummary.count == 0)
+            continue;
+
+        probes.insert(QLatin1String(name(Probe(i))), QJsonObject {
+            { "count", probeSummary.count },
+            { "p50Ms", probeSummary.p50Ms },
+            { "p99Ms", probeSummary.p99Ms },
+            { "maxMs", probeSummary.maxMs },
+        });
+    }
+
+    return QJsonObject { { "counters", counters }, { "probes", probes } };
+}
+
+void Metrics::watchSignals(QObject *object)
+{
+    // The counter lives with the object, so connections stay direct
+    auto *signalCounter = new SignalCounter(object);
+    const QMetaMethod slot = signalCounter->metaObject()->method(
+        signalCounter->metaObject()->indexOfMethod("count()"));
+
+    const QMetaObject *metaObject = object->metaObject();
+    for (int i = 0; i < metaObject->methodCount(); ++i) {
+        const QMetaMethod method = metaObject->method(i);
+        if (method.methodType() == QMetaMethod::Signal && method.access() == QMetaMethod::Public)
+            QObject::connect(object, method, signalCounter, slot);
+    }
+}
+
+MetricsExporter::MetricsExporter(const QString &path, int intervalMs, QObject *parent)
+    : QObject(parent)
+    , m_file(path)
+{
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qWarning() << "MetricsExporter: cannot open" << path;
+        return;
+    }
+
+    for (int i = 0; i < Metrics::CounterCount; ++i)
+        m_lastCounters[i] = Metrics::counter(Metrics::Counter(i));
+    m_clock.start();
+
+    m_timer.setInterval(qMax(100, intervalMs));
+    connect(&m_timer, &QTimer::timeout, this, &MetricsExporter::write);
+    m_timer.start();
+}
+
+void MetricsExporter::write()
+{
+    const double seconds = m_clock.restart() / 1000.0;
+
+    QJsonObject rates;
+    for (int i = 0; i < Metrics::CounterCount; ++i) {
+        const qint64 value = Metrics::counter(Metrics::Counter(i));
+        rates.insert(QLatin1String(Metrics::name(Metrics::Counter(i))),
+                     seconds > 0.0 ? (value - m_lastCounters[i]) / seconds : 0.0);
+        m_lastCounters[i] = value;
+    }
+
+    QJsonObject line = Metrics::snapshot();
+    line.insert("timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs));
+    line.insert("ratesPerSecond", rates);
+
+    m_file.write(QJsonDocument(line).toJson(QJsonDocument::Compact));
+    m_file.write("\n");
+    m_file.flush();
+}
+
+#include "metrics.moc"
@@ -0,0 +1,123 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <atomic>
+
+// Process-wide timing probes and counters for diagnosing stutter. Probes
+// keep the most recent durations for percentiles; counters are monotonic.
+// Recording is safe from the GUI, render and worker threads and costs a
+// single relaxed load while metrics are disabled.
+class Metrics
+{
+public:
+    enum Probe {
+        FrameInterval,          // Between swaps of the window showing the chart
+        Paint,
+        SceneGraphSync,
+        StaticLayer,
+        DrawGrid,
+        DrawAxes,
+        DrawData,
+        DrawMedianLine,
+        DrawCurrentPoint,
+        CurrentFuelFlowUpdate,
+        ModelReset,
+        ProbeCount
+    };
+
+    enum Counter {
+        Repaints,               // Frames in which the chart produced new nodes
+        UpdateRequests,         // QQuickItem::update() calls by the chart
+        SignalEmissions,        // Signals of objects passed to watchSignals()
+        SamplesIngested,
+        SamplesDropped,
+        NmeaLinesRejected,      // Malformed or failing their checksum
+        CounterCount
+    };
+
+    struct Summary {
+        qint64 count = 0;       // Total recordings, not just the retained ones
+        double p50Ms = 0.0;
+        double p99Ms = 0.0;
+        double maxMs = 0.0;     // Of the retained recordings
+    };
+
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    static void record(Probe probe, qint64 nanoseconds);
+    static void add(Counter counter, qint64 value = 1)
+    {
+        if (isEnabled())
+            s_counters[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    static qint64 counter(Counter counter) { return s_counters[counter].load(std::memory_order_relaxed); }
+    static Summary summary(Probe probe);
+
+    static const char *name(Probe probe);
+    static const char *name(Counter counter);
+
+    // Counters and probe summaries as one JSON object
+    static QJsonObject snapshot();
+
+    // Counts every signal emitted by object towards SignalEmissions
+    static void watchSignals(QObject *object);
+
+private:
+    static std::atomic<bool> s_enabled;
+    static std::atomic<qint64> s_counters[CounterCount];
+};
+
+// Records the lifetime of the enclosing scope into a probe
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Metrics::Probe probe)
+        : m_probe(probe)
+    {
+        if (Metrics::isEnabled())
+            m_timer.start();
+    }
+
+    ~ScopedTimer()
+    {
+        if (m_timer.isValid())
+            Metrics::record(m_probe, m_timer.nsecsElapsed());
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    const Metrics::Probe m_probe;
+    QElapsedTimer m_timer;
+};
+
+// Appends a Metrics snapshot, with per-second counter rates, as one JSON
+// line to a file at a fixed interval, so jank can be lined up with sensor
+// rates after a trip
+class MetricsExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    MetricsExporter(const QString &path, int intervalMs, QObject *parent = nullptr);
+
+    bool isOpen() const { return m_file.isOpen(); }
+
+private:
+    void write();
+
+    QFile m_file;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    qint64 m_lastCounters[Metrics::CounterCount];
+};
+
+#endif // METRICS_H
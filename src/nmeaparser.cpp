@@ -0,0 +1,318 @@
+#include "nmeaparser.h"
+#include <cstring>
+#include <limits>
+
+namespace {
+
+constexpr int MAX_FIELDS = 48;
+constexpr double KNOTS_PER_METRE_PER_SECOND = 3600.0 / 1852.0;
+
+struct Field {
+    const char *begin;
+    const char *end;
+
+    qsizetype size() const { return end - begin; }
+    bool operator==(const char *text) const
+    {
+        const std::size_t length = std::strlen(text);
+        return std::size_t(size()) == length && std::memcmp(begin, text, length) == 0;
+    }
+};
+
+// Splits [begin, end) at every separator, without copying. Fields beyond
+// maxFields are dropped.
+int split(const char *begin, const char *end, char separator, Field *fields, int maxFields)
+{
+    int count = 0;
+    for (;;) {
+        const auto *next = static_cast<const char *>(std::memchr(begin, separator, end - begin));
+        if (count == maxFields)
+            return count;
+        fields[count++] = { begin, next ? next : end };
+        if (!next)
+            return count;
+        begin = next + 1;
+    }
+}
+
+int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+bool toHex(const Field &field, quint32 *value)
+{
+    if (field.size() == 0 || field.size() > 8)
+        return false;
+    quint32 result = 0;
+    for (const char *p = field.begin; p < field.end; ++p) {
+        const int digit = hexDigit(*p);
+        if (digit < 0)
+            return false;
+        result = result << 4 | quint32(digit);
+    }
+    *value = result;
+    return true;
+}
+
+// Plain decimal numbers, all NMEA uses; no locale, exponent or allocation
+bool toNumber(const Field &field, double *value)
+{
+    const char *p = field.begin;
+    const bool negative = p < field.end && *p == '-';
+    if (p < field.end && (*p == '-' || *p == '+'))
+        ++p;
+
+    int digits = 0;
+    double integer = 0.0;
+    for (; p < field.end && *p >= '0' && *p <= '9'; ++p, ++digits)
+        integer = integer * 10.0 + (*p - '0');
+
+    double fraction = 0.0;
+    double scale = 1.0;
+    if (p < field.end && *p == '.') {
+        for (++p; p < field.end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+            fraction = fraction * 10.0 + (*p - '0');
+            scale *= 10.0;
+        }
+    }
+
+    if (digits == 0 || p != field.end)
+        return false;
+    const double result = integer + fraction / scale;
+    *value = negative ? -result : result;
+    return true;
+}
+
+bool toInteger(const Field &field, int *value)
+{
+    if (field.size() == 0 || field.size() > 9)
+        return false;
+    int result = 0;
+    for (const char *p = field.begin; p < field.end; ++p) {
+        if (*p < '0' || *p > '9')
+            return false;
+        result = result * 10 + (*p - '0');
+    }
+    *value = result;
+    return true;
+}
+
+} // namespace
+
+NmeaParser::NmeaParser(int firstInstance, int engineCount)
+    : m_firstInstance(firstInstance)
+    , m_fuelFlow(qMax(1, engineCount), std::numeric_limits<double>::quiet_NaN())
+    , m_speed(std::numeric_limits<double>::quiet_NaN())
+    , m_lines(0)
+    , m_rejectedLines(0)
+{
+}
+
+NmeaParser::Result NmeaParser::parse(const char *data, qsizetype size, qint64 timestampMs,
+                                     TelemetrySample *out, int maxCount)
+{
+    Result result;
+    const char *end = data + size;
+    const char *line = data;
+    while (result.samples < maxCount) {
+        const auto *newline = static_cast<const char *>(std::memchr(line, '\n', end - line));
+        if (!newline) {
+            // A line this long without an end is not NMEA; drop it rather
+            // than buffer it forever
+            if (end - line > MAX_LINE) {
+                ++m_lines;
+                ++m_rejectedLines;
+                line = end;
+            }
+            break;
+        }
+
+        const char *lineEnd = newline;
+        if (lineEnd > line && lineEnd[-1] == '\r')
+            --lineEnd;
+        if (lineEnd > line) {
+            ++m_lines;
+            if (parseLine(line, lineEnd, timestampMs, out + result.samples))
+                ++result.samples;
+        }
+        line = newline + 1;
+    }
+    result.consumed = line - data;
+    return result;
+}
+
+quint8 NmeaParser::checksum(const char *begin, const char *end)
+{
+    // XOR is order-independent, so the bytes are folded eight at a time
+    // and the lanes combined at the end
+    quint64 lanes = 0;
+    for (; end - begin >= 8; begin += 8) {
+        quint64 word;
+        std::memcpy(&word, begin, sizeof(word));
+        lanes ^= word;
+    }
+    lanes ^= lanes >> 32;
+    lanes ^= lanes >> 16;
+    lanes ^= lanes >> 8;
+
+    quint8 sum = quint8(lanes);
+    for (; begin < end; ++begin)
+        sum ^= quint8(*begin);
+    return sum;
+}
+
+bool NmeaParser::parseLine(const char *begin, const char *end, qint64 timestampMs, TelemetrySample *out)
+{
+    if (*begin == '$' || *begin == '!')
+        return parseSentence(begin, end, timestampMs, out);
+    if (*begin >= '0' && *begin <= '9')
+        return parseFrame(begin, end, timestampMs, out);
+
+    ++m_rejectedLines;
+    return false;
+}
+
+bool NmeaParser::parseSentence(const char *begin, const char *end, qint64 timestampMs, TelemetrySample *out)
+{
+    // "$TTSSS,...*hh": talker, sentence type, fields and checksum
+    if (end - begin < 9 || end[-3] != '*') {
+        ++m_rejectedLines;
+        return false;
+    }
+    const int high = hexDigit(end[-2]);
+    const int low = hexDigit(end[-1]);
+    if (high < 0 || low < 0 || checksum(begin + 1, end - 3) != quint8(high << 4 | low)) {
+        ++m_rejectedLines;
+        return false;
+    }
+
+    Field fields[MAX_FIELDS];
+    const int count = split(begin + 1, end - 3, ',', fields, MAX_FIELDS);
+    if (fields[0].size() != 5)
+        return false;
+    const Field type = { fields[0].begin + 2, fields[0].end };
+
+    if (type == "RPM") {
+        // Engine, not shaft, speed of one of the engines with valid status
+        int instance;
+        double rpm;
+        if (count >= 4 && fields[1] == "E" && toInteger(fields[2], &instance)
+            && engineIndex(instance) >= 0 && toNumber(fields[3], &rpm)
+            && !(count >= 6 && fields[5] == "V")) {
+            return emitSample(engineIndex(instance), rpm, timestampMs, out);
+        }
+    } else if (type == "XDR") {
+        // Quadruples of type, value, unit and transducer name
+        for (int i = 1; i + 3 < count; i += 4) {
+            int instance;
+            double litresPerSecond;
+            const Field &name = fields[i + 3];
+            static constexpr char prefix[] = "FUELRATE#";
+            constexpr qsizetype prefixLength = sizeof(prefix) - 1;
+            if (fields[i] == "R" && fields[i + 2] == "l" && name.size() > prefixLength
+                && std::memcmp(name.begin, prefix, prefixLength) == 0
+                && toInteger({ name.begin + prefixLength, name.end }, &instance)
+                && engineIndex(instance) >= 0 && toNumber(fields[i + 1], &litresPerSecond)) {
+                m_fuelFlow[engineIndex(instance)] = litresPerSecond * 3600.0;
+            }
+        }
+    } else if (type == "VTG") {
+        double knots;
+        if (count >= 7 && fields[6] == "N" && toNumber(fields[5], &knots))
+            m_speed = knots;
+    } else if (type == "RMC") {
+        double knots;
+        if (count >= 8 && fields[2] == "A" && toNumber(fields[7], &knots))
+            m_speed = knots;
+    }
+    return false;
+}
+
+bool NmeaParser::parseFrame(const char *begin, const char *end, qint64 timestampMs, TelemetrySample *out)
+{
+    // "hh:mm:ss.ddd R 09F20083 01 2F 30 70 00 2F 30 70": receive time,
+    // direction, CAN id and up to eight data bytes. The CAN controller has
+    // already checked the frame's CRC.
+    Field fields[11];
+    const int count = split(begin, end, ' ', fields, 11);
+    quint32 id;
+    if (count < 4 || count > 11 || !toHex(fields[2], &id)) {
+        ++m_rejectedLines;
+        return false;
+    }
+
+    quint8 data[8];
+    const int size = count - 3;
+    for (int i = 0; i < size; ++i) {
+        const Field &byte = fields[3 + i];
+        const int high = byte.size() == 2 ? hexDigit(byte.begin[0]) : -1;
+        const int low = byte.size() == 2 ? hexDigit(byte.begin[1]) : -1;
+        if (high < 0 || low < 0) {
+            ++m_rejectedLines;
+            return false;
+        }
+        data[i] = quint8(high << 4 | low);
+    }
+
+    // PDU1 PGNs carry a destination address in their low byte
+    const int source = int(id & 0xff);
+    quint32 pgn = (id >> 8) & 0x3ffff;
+    if (((pgn >> 8) & 0xff) < 240)
+        pgn &= ~quint32(0xff);
+
+    switch (pgn) {
+    case 127488: {
+        // Engine Parameters, Rapid Update: instance, speed in 0.25 RPM
+        const quint16 speed = size >= 3 ? quint16(data[1] | data[2] << 8) : 0xffff;
+        if (speed != 0xffff && engineIndex(data[0]) >= 0)
+            return emitSample(engineIndex(data[0]), speed * 0.25, timestampMs, out);
+        break;
+    }
+    case 127489: {
+        // Engine Parameters, Dynamic, a fast packet: the instance opens the
+        // first frame, the fuel rate in 0.1 L/h sits in the second
+        const int sequence = data[0] >> 5;
+        const int frame = data[0] & 0x1f;
+        FastPacket &packet = m_engineDynamic[source];
+        if (frame == 0 && size >= 3) {
+            packet = { sequence, data[2] };
+        } else if (frame == 1 && size >= 6) {
+            const qint16 fuelRate = qint16(data[4] | data[5] << 8);
+            if (packet.sequence == sequence && engineIndex(packet.instance) >= 0 && fuelRate != 0x7fff)
+                m_fuelFlow[engineIndex(packet.instance)] = fuelRate * 0.1;
+            packet = FastPacket();
+        }
+        break;
+    }
+    case 129026: {
+        // COG & SOG, Rapid Update: speed over ground in 0.01 m/s
+        const quint16 speed = size >= 6 ? quint16(data[4] | data[5] << 8) : 0xffff;
+        if (speed != 0xffff)
+            m_speed = speed * 0.01 * KNOTS_PER_METRE_PER_SECOND;
+        break;
+    }
+    default:
+        break;
+    }
+    return false;
+}
+
+bool NmeaParser::emitSample(int engine, double rpm, qint64 timestampMs, TelemetrySample *out)
+{
+    if (!qIsFinite(m_fuelFlow[engine]))
+        return false;
+
+    out->timestampMs = timestampMs;
+    out->rpm = rpm;
+    out->fuelFlow = m_fuelFlow[engine];
+    out->speed = m_speed;
+    out->engine = engine;
+    return true;
+}
@@ -0,0 +1,76 @@
+#ifndef NMEAPARSER_H
+#define NMEAPARSER_H
+
+#include <QList>
+#include <QtGlobal>
+#include <array>
+#include "telemetrysample.h"
+
+// Reads the telemetry of engineCount consecutive engine instances out of
+// the line-based text that engine gateways stream over UDP or TCP:
+//
+//   NMEA 0183   $--RPM,E,<instance>,<rpm>,<pitch>,A*hh
+//               $--XDR,R,<litres per second>,l,FUELRATE#<instance>*hh
+//               $--VTG,...,<knots>,N,...*hh and $--RMC for speed
+//   NMEA 2000   "hh:mm:ss.ddd R <CAN id> <data bytes>" RAW frames of
+//               PGN 127488 (RPM), 127489 (fuel rate) and 129026 (speed)
+//
+// Lines are parsed where they lie in the receive buffer: nothing is copied
+// and no field becomes a QString. Every engine RPM reading yields a sample
+// with that engine's latest fuel rate and the latest speed, once a fuel
+// rate has been seen for it; TelemetrySample::engine is the instance minus
+// firstInstance. Other sentences and engines are skipped; malformed lines
+// and sentences failing their checksum are counted as rejected.
+class NmeaParser
+{
+public:
+    static constexpr int MAX_LINE = 256;    // Longer lines are garbage, NMEA 0183 allows 82 bytes
+    static constexpr quint16 DEFAULT_PORT = 10110;  // NMEA over IP
+
+    struct Result {
+        qsizetype consumed = 0;             // Bytes of complete lines parsed
+        int samples = 0;
+    };
+
+    explicit NmeaParser(int firstInstance = 0, int engineCount = 1);
+
+    // Parses the complete lines in data, up to maxCount samples stamped with
+    // timestampMs. Whatever was not consumed, an incomplete line or the
+    // lines after out filled up, is to be passed again with more data.
+    Result parse(const char *data, qsizetype size, qint64 timestampMs,
+                 TelemetrySample *out, int maxCount);
+
+    qint64 lines() const { return m_lines; }
+    qint64 rejectedLines() const { return m_rejectedLines; }
+
+    // XOR of the bytes between '$' or '!' and '*', taken a word at a time
+    static quint8 checksum(const char *begin, const char *end);
+
+private:
+    bool parseLine(const char *begin, const char *end, qint64 timestampMs, TelemetrySample *out);
+    bool parseSentence(const char *begin, const char *end, qint64 timestampMs, TelemetrySample *out);
+    bool parseFrame(const char *begin, const char *end, qint64 timestampMs, TelemetrySample *out);
+    bool emitSample(int engine, double rpm, qint64 timestampMs, TelemetrySample *out);
+
+    // Index of instance among the engines read, or -1
+    int engineIndex(int instance) const
+    {
+        const int engine = instance - m_firstInstance;
+        return engine >= 0 && engine < int(m_fuelFlow.size()) ? engine : -1;
+    }
+
+    // First two frames of a fast packet of PGN 127489, per source address
+    struct FastPacket {
+        int sequence = -1;
+        int instance = -1;
+    };
+
+    const int m_firstInstance;
+    QList<double> m_fuelFlow;               // Per engine
+    double m_speed;
+    std::array<FastPacket, 256> m_engineDynamic;
+    qint64 m_lines;
+    qint64 m_rejectedLines;
+};
+
+#endif // NMEAPARSER_H
@@ -0,0 +1,238 @@
+#include "nmeasimulator.h"
+#include "nmeaparser.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTime>
+#include <QUdpSocket>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+constexpr qsizetype MAX_DATAGRAM = 1400;    // Fits an Ethernet frame
+constexpr qint64 BURST_LINES = 64;          // Per write when unthrottled
+constexpr double METRES_PER_SECOND_PER_KNOT = 1852.0 / 3600.0;
+
+void appendHex(QByteArray &out, quint32 value, int digits)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4)
+        out += hex[(value >> shift) & 0xf];
+}
+
+// One RAW frame at priority 2, received at timestampMs in UTC
+void appendFrame(QByteArray &out, qint64 timestampMs, quint32 pgn, int source, const quint8 *data, int size)
+{
+    constexpr qint64 msPerDay = 24 * 3600 * 1000;
+    const QTime time = QTime::fromMSecsSinceStartOfDay(int(((timestampMs % msPerDay) + msPerDay) % msPerDay));
+    out += time.toString(QStringLiteral("hh:mm:ss.zzz")).toLatin1();
+    out += " R ";
+    appendHex(out, 2u << 26 | pgn << 8 | quint32(source), 8);
+    for (int i = 0; i < size; ++i) {
+        out += ' ';
+        appendHex(out, data[i], 2);
+    }
+    out += "\r\n";
+}
+
+void putUint16(quint8 *data, quint32 value)
+{
+    data[0] = quint8(value);
+    data[1] = quint8(value >> 8);
+}
+
+QHostAddress hostAddress(const QUrl &address)
+{
+    const QString host = address.host();
+    if (host.isEmpty() || host == QLatin1String("localhost"))
+        return QHostAddress(QHostAddress::LocalHost);
+    return QHostAddress(host);
+}
+
+} // namespace
+
+NmeaSimulator::NmeaSimulator()
+    : m_stopRequested(false)
+{
+}
+
+bool NmeaSimulator::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    setCapture(file.readAll());
+    return !m_lineEnds.empty();
+}
+
+void NmeaSimulator::setCapture(const QByteArray &capture)
+{
+    m_capture = capture;
+    if (!m_capture.isEmpty() && !m_capture.endsWith('\n'))
+        m_capture += '\n';
+
+    m_lineEnds.clear();
+    for (qsizetype end = m_capture.indexOf('\n'); end >= 0; end = m_capture.indexOf('\n', end + 1))
+        m_lineEnds.push_back(end + 1);
+}
+
+qint64 NmeaSimulator::run(const QUrl &address, double linesPerSecond, qint64 maxLines)
+{
+    const bool tcp = address.scheme() == QLatin1String("tcp");
+    const QHostAddress host = hostAddress(address);
+    const quint16 port = quint16(address.port(NmeaParser::DEFAULT_PORT));
+    if (m_lineEnds.empty() || (!tcp && address.scheme() != QLatin1String("udp")) || host.isNull())
+        return -1;
+
+    m_stopRequested.store(false);
+
+    // Over TCP the reader connects to us
+    QUdpSocket udp;
+    QTcpServer server;
+    QTcpSocket *client = nullptr;
+    if (tcp) {
+        if (!server.listen(host, port))
+            return -1;
+        while (!client) {
+            if (m_stopRequested.load(std::memory_order_relaxed))
+                return 0;
+            if (server.waitForNewConnection(100))
+                client = server.nextPendingConnection();
+        }
+    }
+
+    // A UDP reader may not be listening yet, which is no reason to stop
+    QByteArray chunk;
+    auto flush = [&]() {
+        if (chunk.isEmpty())
+            return true;
+        bool written = true;
+        if (tcp) {
+            written = client->write(chunk) == chunk.size() && client->waitForBytesWritten(-1);
+        } else {
+            udp.writeDatagram(chunk, host, port);
+        }
+        chunk.resize(0);
+        return written;
+    };
+
+    QElapsedTimer clock;
+    clock.start();
+    std::size_t line = 0;
+    qint64 sent = 0;
+    while (!m_stopRequested.load(std::memory_order_relaxed) && (maxLines < 0 || sent < maxLines)) {
+        // Line i is due i / linesPerSecond seconds after the start
+        qint64 due = linesPerSecond > 0.0
+            ? qint64(clock.nsecsElapsed() * 1e-9 * linesPerSecond) + 1 : sent + BURST_LINES;
+        if (maxLines >= 0)
+            due = qMin(due, maxLines);
+        if (due <= sent) {
+            const double waitUs = sent * 1e6 / linesPerSecond - clock.nsecsElapsed() * 1e-3;
+            QThread::usleep(static_cast<unsigned long>(qMax(1.0, waitUs)));
+            continue;
+        }
+
+        for (; sent < due; ++sent) {
+            const qsizetype begin = line == 0 ? 0 : m_lineEnds[line - 1];
+            const qsizetype end = m_lineEnds[line];
+            if (!tcp && chunk.size() + (end - begin) > MAX_DATAGRAM)
+                flush();
+            chunk.append(m_capture.constData() + begin, end - begin);
+            line = (line + 1) % m_lineEnds.size();
+        }
+        if (!flush())
+            break;
+    }
+    return sent;
+}
+
+void NmeaSimulator::stop()
+{
+    m_stopRequested.store(true);
+}
+
+void NmeaSimulator::appendSentence(QByteArray &out, const QByteArray &body)
+{
+    out += '$';
+    out += body;
+    out += '*';
+    appendHex(out, NmeaParser::checksum(body.constData(), body.constData() + body.size()), 2);
+    out += "\r\n";
+}
+
+QByteArray NmeaSimulator::synthesize(const SimulationProfile &profile, quint64 seed, int engineCount,
+                                     int samplesPerEngine, Format format)
+{
+    engineCount = qMax(1, engineCount);
+    samplesPerEngine = qMax(0, samplesPerEngine);
+
+    std::vector<std::vector<TelemetrySample>> engines(engineCount);
+    for (int engine = 0; engine < engineCount; ++engine) {
+        EngineSimulator simulator(EngineSimulator::streamSeed(seed, engine), profile);
+        engines[engine].resize(samplesPerEngine);
+        simulator.generate(engines[engine].data(), samplesPerEngine);
+    }
+
+    // Fuel rate first, so that every RPM reading can be sampled
+    QByteArray capture;
+    for (int i = 0; i < samplesPerEngine; ++i) {
+        for (int engine = 0; engine < engineCount; ++engine) {
+            const TelemetrySample &sample = engines[engine][i];
+            const bool reportsSpeed = engine == 0 && qIsFinite(sample.speed);
+
+            if (format == Nmea0183) {
+                appendSentence(capture, "ERXDR,R," + QByteArray::number(sample.fuelFlow / 3600.0, 'f', 7)
+                                        + ",l,FUELRATE#" + QByteArray::number(engine));
+                appendSentence(capture, "ERRPM,E," + QByteArray::number(engine) + ','
+                                        + QByteArray::number(sample.rpm, 'f', 1) + ",,A");
+                if (reportsSpeed) {
+                    appendSentence(capture, "GPVTG,,T,,M," + QByteArray::number(sample.speed, 'f', 2)
+                                            + ",N," + QByteArray::number(sample.speed * 1.852, 'f', 2) + ",K,A");
+                }
+                continue;
+            }
+
+            // Engine Parameters, Dynamic: 26 bytes in four fast packet frames
+            const int source = 0x10 + engine;
+            quint8 payload[28];
+            std::fill(std::begin(payload), std::end(payload), quint8(0xff));
+            payload[0] = quint8(engine);
+            putUint16(payload + 9, quint16(qint16(qBound(-32767, qRound(sample.fuelFlow * 10.0), 32766))));
+            putUint16(payload + 20, 0);
+            putUint16(payload + 22, 0);
+            payload[24] = 0x7f;
+            payload[25] = 0x7f;
+            const int sequence = i & 7;
+            for (int frame = 0; frame < 4; ++frame) {
+                quint8 data[8];
+                data[0] = quint8(sequence << 5 | frame);
+                if (frame == 0) {
+                    data[1] = 26;
+                    std::copy(payload, payload + 6, data + 2);
+                } else {
+                    std::copy(payload + 6 + (frame - 1) * 7, payload + 13 + (frame - 1) * 7, data + 1);
+                }
+                appendFrame(capture, sample.timestampMs, 127489, source, data, 8);
+            }
+
+            // Engine Parameters, Rapid Update
+            quint8 rapid[8] = { quint8(engine), 0, 0, 0xff, 0xff, 0x7f, 0xff, 0xff };
+            putUint16(rapid + 1, quint32(qBound(0, qRound(sample.rpm * 4.0), 0xfffe)));
+            appendFrame(capture, sample.timestampMs, 127488, source, rapid, 8);
+
+            // COG & SOG, Rapid Update
+            if (reportsSpeed) {
+                quint8 cogSog[8] = { quint8(i), 0xfc, 0xff, 0xff, 0, 0, 0xff, 0xff };
+                putUint16(cogSog + 4, quint32(qBound(0, qRound(sample.speed * METRES_PER_SECOND_PER_KNOT * 100.0),
+                                                     0xfffe)));
+                appendFrame(capture, sample.timestampMs, 129026, 0x20, cogSog, 8);
+            }
+        }
+    }
+    return capture;
+}
@@ -0,0 +1,53 @@
+#ifndef NMEASIMULATOR_H
+#define NMEASIMULATOR_H
+
+#include <QByteArray>
+#include <QString>
+#include <QUrl>
+#include <atomic>
+#include <vector>
+#include "enginesimulator.h"
+
+// Stands in for an engine gateway: replays captured NMEA traffic, one
+// sentence or RAW frame per line, to a socket at a fixed rate, looping at
+// the end of the capture. Addresses are udp://host:port, sent to, or
+// tcp://host:port, where the simulator listens and serves the first client,
+// as gateways do.
+class NmeaSimulator
+{
+public:
+    enum Format {
+        Nmea0183,
+        Nmea2000Raw
+    };
+
+    NmeaSimulator();
+
+    bool load(const QString &fileName);
+    void setCapture(const QByteArray &capture);
+    const QByteArray &capture() const { return m_capture; }
+    qsizetype lineCount() const { return qsizetype(m_lineEnds.size()); }
+
+    // Sends lines at linesPerSecond, or as fast as the socket takes them
+    // with 0, until stop() or maxLines were sent. Lines due together share
+    // a datagram. Returns the lines sent, or -1 if the address is unusable.
+    qint64 run(const QUrl &address, double linesPerSecond, qint64 maxLines = -1);
+
+    // Thread-safe
+    void stop();
+
+    // Appends "$body*hh" with its checksum as one line
+    static void appendSentence(QByteArray &out, const QByteArray &body);
+
+    // Traffic of engineCount simulated engines, as a gateway would send
+    // their RPM, fuel rate and the boat's speed
+    static QByteArray synthesize(const SimulationProfile &profile, quint64 seed, int engineCount,
+                                 int samplesPerEngine, Format format);
+
+private:
+    QByteArray m_capture;
+    std::vector<qsizetype> m_lineEnds;      // Offsets just past each line's '\n'
+    std::atomic<bool> m_stopRequested;
+};
+
+#endif // NMEASIMULATOR_H
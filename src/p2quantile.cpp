@@ -0,0 +1,119 @@
+#include "p2quantile.h"
+#include <QDataStream>
+#include <algorithm>
+
+P2Quantile::P2Quantile(double probability)
+    : m_probability(qBound(0.0, probability, 1.0))
+{
+    reset();
+}
+
+void P2Quantile::reset()
+{
+    const double p = m_probability;
+    m_count = 0;
+    m_heights.fill(0.0);
+    m_positions = { 0, 1, 2, 3, 4 };
+    m_desired = { 0.0, 2.0 * p, 4.0 * p, 2.0 + 2.0 * p, 4.0 };
+    m_increments = { 0.0, p / 2.0, p, (1.0 + p) / 2.0, 1.0 };
+}
+
+void P2Quantile::add(double value)
+{
+    // The first five observations seed the markers directly
+    if (m_count < 5) {
+        m_heights[m_count++] = value;
+        if (m_count == 5)
+            std::sort(m_heights.begin(), m_heights.end());
+        return;
+    }
+    ++m_count;
+
+    // Find the cell containing the value, widening the extremes if needed
+    int cell;
+    if (value < m_heights[0]) {
+        m_heights[0] = value;
+        cell = 0;
+    } else if (value >= m_heights[4]) {
+        m_heights[4] = std::max(m_heights[4], value);
+        cell = 3;
+    } else {
+        cell = 0;
+        while (cell < 3 && value >= m_heights[cell + 1])
+            ++cell;
+    }
+
+    for (int i = cell + 1; i < 5; ++i)
+        ++m_positions[i];
+    for (int i = 0; i < 5; ++i)
+        m_desired[i] += m_increments[i];
+
+    // Move the middle markers towards their desired positions
+    for (int i = 1; i < 4; ++i) {
+        const double offset = m_desired[i] - m_positions[i];
+        if ((offset >= 1.0 && m_positions[i + 1] - m_positions[i] > 1)
+            || (offset <= -1.0 && m_positions[i - 1] - m_positions[i] < -1)) {
+            const int d = offset > 0 ? 1 : -1;
+            const double candidate = parabolic(i, d);
+            if (m_heights[i - 1] < candidate && candidate < m_heights[i + 1])
+                m_heights[i] = candidate;
+            else
+                m_heights[i] = linear(i, d);
+            m_positions[i] += d;
+        }
+    }
+}
+
+double P2Quantile::value() const
+{
+    if (m_count == 0)
+        return 0.0;
+
+    if (m_count < 5) {
+        // Insertion sort of at most four values
+        std::array<double, 5> sorted = m_heights;
+        for (int i = 1; i < m_count; ++i) {
+            for (int j = i; j > 0 && sorted[j] < sorted[j - 1]; --j)
+                std::swap(sorted[j], sorted[j - 1]);
+        }
+        const int index = qBound(0, int(m_probability * (m_count - 1) + 0.5), int(m_count - 1));
+        return sorted[index];
+    }
+
+    return m_heights[2];
+}
+
+double P2Quantile::parabolic(int i, int d) const
+{
+    const double n0 = m_positions[i - 1];
+    const double n1 = m_positions[i];
+    const double n2 = m_positions[i + 1];
+    return m_heights[i] + d / (n2 - n0)
+        * ((n1 - n0 + d) * (m_heights[i + 1] - m_heights[i]) / (n2 - n1)
+           + (n2 - n1 - d) * (m_heights[i] - m_heights[i - 1]) / (n1 - n0));
+}
+
+double P2Quantile::linear(int i, int d) const
+{
+    return m_heights[i] + d * (m_heights[i + d] - m_heights[i])
+        / double(m_positions[i + d] - m_positions[i]);
+}
+
+QDataStream &operator<<(QDataStream &stream, const P2Quantile &quantile)
+{
+    stream << quantile.m_probability << quantile.m_count;
+    for (int i = 0; i < 5; ++i)
+        stream << quantile.m_heights[i] << quantile.m_positions[i] << quantile.m_desired[i];
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, P2Quantile &quantile)
+{
+    double probability;
+    stream >> probability;
+    quantile = P2Quantile(probability);
+    stream >> quantile.m_count;
+    for (int i = 0; i < 5; ++i)
+        stream >> quantile.m_heights[i] >> quantile.m_positions[i] >> quantile.m_desired[i];
+    return stream;
+}
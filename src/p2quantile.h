@@ -0,0 +1,43 @@
+#ifndef P2QUANTILE_H
+#define P2QUANTILE_H
+
+#include <QtGlobal>
+#include <array>
+
+class QDataStream;
+
+// Streaming estimate of a single quantile using the P² algorithm (Jain &
+// Chlamtac, 1985). Five markers are adjusted per observation, so add() is
+// O(1) and the memory footprint is fixed regardless of how many samples
+// have been seen.
+class P2Quantile
+{
+public:
+    explicit P2Quantile(double probability = 0.5);
+
+    void add(double value);
+    void reset();
+
+    double probability() const { return m_probability; }
+    qint64 count() const { return m_count; }
+
+    // Current estimate; exact while fewer than five samples have been added
+    // and 0 when empty
+    double value() const;
+
+    friend QDataStream &operator<<(QDataStream &stream, const P2Quantile &quantile);
+    friend QDataStream &operator>>(QDataStream &stream, P2Quantile &quantile);
+
+private:
+    double parabolic(int i, int d) const;
+    double linear(int i, int d) const;
+
+    double m_probability;
+    qint64 m_count;
+    std::array<double, 5> m_heights;        // Marker heights q[i]
+    std::array<qint64, 5> m_positions;      // Actual marker positions n[i]
+    std::array<double, 5> m_desired;        // Desired marker positions n'[i]
+    std::array<double, 5> m_increments;     // dn'[i]
+};
+
+#endif // P2QUANTILE_H
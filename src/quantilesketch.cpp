@@ -0,0 +1,90 @@
+#include "quantilesketch.h"
+#include "histogramquantile.h"
+#include <QDataStream>
+
+QuantileSketch::QuantileSketch(double minValue, double maxValue)
+    : m_minValue(minValue)
+    , m_maxValue(qMax(maxValue, minValue + 1e-9))
+    , m_count(0)
+{
+}
+
+void QuantileSketch::add(double value)
+{
+    if (!qIsFinite(value))
+        return;
+
+    if (m_buckets.isEmpty())
+        m_buckets.fill(0, BUCKETS);
+    ++m_buckets[HistogramQuantile::bucket(value, m_minValue, m_maxValue, BUCKETS)];
+    ++m_count;
+}
+
+bool QuantileSketch::merge(const QuantileSketch &other)
+{
+    if (m_minValue != other.m_minValue || m_maxValue != other.m_maxValue)
+        return false;
+    if (other.m_count == 0)
+        return true;
+
+    if (m_buckets.isEmpty())
+        m_buckets.fill(0, BUCKETS);
+    for (int bucket = 0; bucket < BUCKETS; ++bucket)
+        m_buckets[bucket] += other.m_buckets.at(bucket);
+    m_count += other.m_count;
+    return true;
+}
+
+void QuantileSketch::reset()
+{
+    m_count = 0;
+    m_buckets.clear();
+}
+
+double QuantileSketch::quantile(double probability) const
+{
+    return HistogramQuantile::quantile(m_buckets.constData(), BUCKETS, m_count, m_minValue, m_maxValue,
+                                       probability);
+}
+
+QDataStream &operator<<(QDataStream &stream, const QuantileSketch &sketch)
+{
+    quint16 used = 0;
+    for (quint64 count : sketch.m_buckets)
+        used += count > 0 ? 1 : 0;
+
+    stream << sketch.m_minValue << sketch.m_maxValue << used;
+    for (int bucket = 0; bucket < sketch.m_buckets.size(); ++bucket) {
+        if (sketch.m_buckets.at(bucket) > 0)
+            stream << quint16(bucket) << sketch.m_buckets.at(bucket);
+    }
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, QuantileSketch &sketch)
+{
+    double minValue = 0.0;
+    double maxValue = 0.0;
+    quint16 used = 0;
+    stream >> minValue >> maxValue >> used;
+    sketch = QuantileSketch(minValue, maxValue);
+    if (used > QuantileSketch::BUCKETS) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return stream;
+    }
+
+    for (int i = 0; i < used && stream.status() == QDataStream::Ok; ++i) {
+        quint16 bucket = 0;
+        quint64 count = 0;
+        stream >> bucket >> count;
+        if (bucket >= QuantileSketch::BUCKETS) {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            break;
+        }
+        if (sketch.m_buckets.isEmpty())
+            sketch.m_buckets.fill(0, QuantileSketch::BUCKETS);
+        sketch.m_buckets[bucket] += count;
+        sketch.m_count += qint64(count);
+    }
+    return stream;
+}
@@ -0,0 +1,46 @@
+#ifndef QUANTILESKETCH_H
+#define QUANTILESKETCH_H
+
+#include <QList>
+#include <QtGlobal>
+
+class QDataStream;
+
+// Mergeable quantile summary of values in [minValue, maxValue]: a histogram
+// of BUCKETS equal buckets. Sketches over the same range merge by adding
+// their counts, which is associative and commutative, so sketches built on
+// any thread and merged in any order give the same result as one sketch
+// fed every value. Quantiles come from the buckets as described in
+// HistogramQuantile. Buckets stay unallocated until the first value.
+class QuantileSketch
+{
+public:
+    static constexpr int BUCKETS = 256;
+
+    explicit QuantileSketch(double minValue = 0.0, double maxValue = 100.0);
+
+    void add(double value);
+
+    // Adds other's counts; false, and nothing merged, if the ranges differ
+    bool merge(const QuantileSketch &other);
+    void reset();
+
+    double minValue() const { return m_minValue; }
+    double maxValue() const { return m_maxValue; }
+    qint64 count() const { return m_count; }
+
+    // 0 when empty
+    double quantile(double probability) const;
+
+    // Only the buckets in use are written
+    friend QDataStream &operator<<(QDataStream &stream, const QuantileSketch &sketch);
+    friend QDataStream &operator>>(QDataStream &stream, QuantileSketch &sketch);
+
+private:
+    double m_minValue;
+    double m_maxValue;
+    qint64 m_count;
+    QList<quint64> m_buckets;
+};
+
+#endif // QUANTILESKETCH_H
@@ -0,0 +1,165 @@
+#include "reportexporter.h"
+#include "bininterpolator.h"
+#include "chartdatamodel.h"
+#include "chartpainter.h"
+#include "samplelog.h"
+#include "statisticsengine.h"
+#include "workerpool.h"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QImage>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QSvgGenerator>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Everything a thread keeps from one chart to the next
+struct ReportExporter::Worker {
+    ChartPainter chart;
+    QImage image;
+    QPainter painter;
+};
+
+ReportExporter::ReportExporter()
+    : m_format(Png)
+    , m_size(1200, 800)
+    , m_window(AllTimeWindow)
+    , m_threadCount(QThread::idealThreadCount())
+{
+}
+
+int ReportExporter::exportCharts(const QStringList &logDirectories, const QString &outputDirectory)
+{
+    if (logDirectories.isEmpty() || m_size.isEmpty())
+        return 0;
+
+    // Two logs writing the same file would leave one chart silently
+    // missing, so such a set is refused before anything is written
+    const QStringList names = outputNames(logDirectories);
+    QHash<QString, int> owners;
+    for (int i = 0; i < names.size(); ++i) {
+        const QString key = names.at(i).toLower();
+        if (owners.contains(key)) {
+            qWarning() << "ReportExporter:" << logDirectories.at(owners.value(key)) << "and"
+                       << logDirectories.at(i) << "would both be written to" << names.at(i);
+            return -1;
+        }
+        owners.insert(key, i);
+    }
+
+    if (!QDir().mkpath(outputDirectory)) {
+        qWarning() << "ReportExporter: cannot create" << outputDirectory;
+        return 0;
+    }
+
+    // Bins without samples show the sample engine's envelope, as in the
+    // window; a fixed seed keeps the reports reproducible
+    QRandomGenerator generator(1);
+    const BinStore baseline = ChartDataModel::sampleBaseline(m_layout, &generator);
+
+    // Every worker draws with a painter of its own
+    const int threadCount = WorkerPool::workerCount(m_threadCount, int(logDirectories.size()));
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < threadCount; ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->chart.setSize(m_size);
+        worker->chart.setRpmRange(m_layout.minRpm, m_layout.maxRpm);
+        worker->chart.setViewRange(m_layout.minRpm, m_layout.maxRpm);
+        worker->chart.setFuelFlowRange(m_layout.minFuelFlow, m_layout.maxFuelFlow);
+        if (m_format == Png)
+            worker->image = QImage(m_size, QImage::Format_ARGB32_Premultiplied);
+        workers.push_back(std::move(worker));
+    }
+
+    std::atomic<int> written { 0 };
+    WorkerPool::run(int(logDirectories.size()), threadCount, QStringLiteral("ReportExporter"),
+                    [&](int worker, int i) {
+        const QString path = QDir(outputDirectory).filePath(names.at(i) + '.' + suffix(m_format));
+        if (exportChart(*workers.at(worker), baseline, logDirectories.at(i), path))
+            ++written;
+    });
+    return written;
+}
+
+QStringList ReportExporter::outputNames(const QStringList &logDirectories)
+{
+    // Path components of every log, and how many leading ones all their
+    // parent directories share
+    QList<QStringList> paths;
+    qsizetype common = -1;
+    for (const QString &directory : logDirectories) {
+        const QStringList path = QDir::cleanPath(QDir(directory).absolutePath()).split('/', Qt::SkipEmptyParts);
+        qsizetype shared = 0;
+        const QStringList &first = paths.isEmpty() ? path : paths.constFirst();
+        const qsizetype depth = qMin(first.size(), path.size()) - 1;
+        while (shared < depth && first.at(shared) == path.at(shared))
+            ++shared;
+        common = common < 0 ? path.size() - 1 : qMin(common, shared);
+        paths.append(path);
+    }
+
+    // What is left below them tells the logs apart, e.g. boatA/history
+    // and boatB/history become boatA_history and boatB_history
+    QStringList names;
+    for (const QStringList &path : std::as_const(paths))
+        names.append(path.mid(qMax<qsizetype>(0, common)).join('_'));
+    return names;
+}
+
+bool ReportExporter::exportChart(Worker &worker, const BinStore &baseline, const QString &logDirectory,
+                                 const QString &outputPath) const
+{
+    SampleLog log(logDirectory);
+    if (!log.open(SampleLog::ReadOnly) || log.sampleCount() == 0) {
+        qWarning() << "ReportExporter: nothing recorded in" << logDirectory;
+        return false;
+    }
+
+    // Created on this thread and called directly, the engine has learned
+    // the whole log by the time attachHistory() returns
+    StatisticsEngine engine(LOWER_PERCENTILE, UPPER_PERCENTILE);
+    engine.setBaseline(baseline);
+    engine.acquire();
+    engine.attachHistory(&log);
+    const BinStore bins = engine.acquire().bins[m_window];
+
+    // The marker shows the last recorded reading. A new series per chart
+    // also starts its decimation afresh.
+    ChartPainter::Series series;
+    series.bins = bins;
+    log.scan(log.sampleCount() - 1, SampleLog::Rpm | SampleLog::FuelFlow, [&](const SampleLog::Columns &columns) {
+        series.currentRpm = columns.rpm[columns.count - 1];
+        series.currentFuelFlow = columns.fuelFlow[columns.count - 1];
+    });
+    series.isEcoMode = series.currentFuelFlow
+        < BinInterpolator(bins.layout, bins.medianFuelFlow).value(series.currentRpm);
+
+    if (m_format == Svg) {
+        QSvgGenerator svg;
+        svg.setFileName(outputPath);
+        svg.setSize(m_size);
+        svg.setViewBox(QRect(QPoint(0, 0), m_size));
+        svg.setTitle(QFileInfo(outputPath).completeBaseName());
+        if (!worker.painter.begin(&svg)) {
+            qWarning() << "ReportExporter: cannot write" << outputPath;
+            return false;
+        }
+        worker.chart.render(&worker.painter, series);
+        worker.painter.end();
+        return true;
+    }
+
+    worker.painter.begin(&worker.image);
+    worker.chart.render(&worker.painter, series);
+    worker.painter.end();
+    if (!worker.image.save(outputPath, "PNG")) {
+        qWarning() << "ReportExporter: cannot write" << outputPath;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef REPORTEXPORTER_H
+#define REPORTEXPORTER_H
+
+#include <QSize>
+#include <QStringList>
+#include "binstore.h"
+
+// Renders the charts of many recorded boats to image files without a
+// window, e.g. for nightly fleet reports. Each log is learned into bins by
+// its own StatisticsEngine and drawn by ChartPainter, the same code the
+// window paints with. Logs are spread over a pool of worker threads; each
+// keeps its ChartPainter, image buffer and QPainter for every chart it
+// draws.
+class ReportExporter
+{
+public:
+    enum Format {
+        Png,
+        Svg
+    };
+
+    ReportExporter();
+
+    void setFormat(Format format) { m_format = format; }
+    void setSize(const QSize &size) { m_size = size; }
+    void setLayout(const BinLayout &layout) { m_layout = layout; }
+    void setStatisticsWindow(StatisticsWindow window) { m_window = window; }
+
+    // Defaults to QThread::idealThreadCount()
+    void setThreadCount(int count) { m_threadCount = count; }
+
+    // Writes one chart per sample log directory into outputDirectory,
+    // named after the log's path below the directory holding all of them,
+    // e.g. boatA_history.png for fleet/boatA/history. Blocks until all are
+    // done and returns how many were written, or -1 without writing any if
+    // two logs would be written to the same file.
+    int exportCharts(const QStringList &logDirectories, const QString &outputDirectory);
+
+    static QString suffix(Format format) { return format == Svg ? QStringLiteral("svg") : QStringLiteral("png"); }
+
+private:
+    struct Worker;
+
+    static QStringList outputNames(const QStringList &logDirectories);
+
+    bool exportChart(Worker &worker, const BinStore &baseline, const QString &logDirectory,
+                     const QString &outputPath) const;
+
+    static constexpr double LOWER_PERCENTILE = 0.05;    // Same as ChartDataModel's defaults
+    static constexpr double UPPER_PERCENTILE = 0.95;
+
+    Format m_format;
+    QSize m_size;
+    BinLayout m_layout;
+    StatisticsWindow m_window;
+    int m_threadCount;
+};
+
+#endif // REPORTEXPORTER_H
@@ -0,0 +1,324 @@
+#include "samplecodec.h"
+#include <QtAlgorithms>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+inline quint64 lowMask(int bits)
+{
+    return bits >= 64 ? ~quint64(0) : (quint64(1) << bits) - 1;
+}
+
+inline quint64 doubleBits(double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline double bitsDouble(quint64 bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// MSB-first bit stream packed into 64-bit words
+class BitWriter
+{
+public:
+    void write(quint64 value, int bits)
+    {
+        value &= lowMask(bits);
+        const int free = 64 - m_used;
+        if (bits < free) {
+            m_current |= value << (free - bits);
+            m_used += bits;
+        } else {
+            m_current |= value >> (bits - free);
+            m_words.push_back(m_current);
+            m_used = bits - free;
+            m_current = m_used ? value << (64 - m_used) : 0;
+        }
+    }
+
+    void writeBit(bool bit) { write(bit ? 1 : 0, 1); }
+
+    // Flushes the partial word and returns the stream size in bytes
+    quint32 finish()
+    {
+        if (m_used)
+            m_words.push_back(m_current);
+        m_current = 0;
+        m_used = 0;
+        return quint32(m_words.size() * sizeof(quint64));
+    }
+
+    const std::vector<quint64> &words() const { return m_words; }
+
+private:
+    std::vector<quint64> m_words;
+    quint64 m_current = 0;
+    int m_used = 0;
+};
+
+class BitReader
+{
+public:
+    BitReader(const uchar *data, quint32 bytes)
+        : m_words(reinterpret_cast<const quint64 *>(data))
+        , m_count(bytes / sizeof(quint64))
+    {
+    }
+
+    quint64 read(int bits)
+    {
+        if (bits <= m_available) {
+            m_available -= bits;
+            return (m_current >> m_available) & lowMask(bits);
+        }
+
+        const quint64 high = m_current & lowMask(m_available);
+        const int missing = bits - m_available;
+        m_current = m_index < m_count ? m_words[m_index++] : 0;
+        m_available = 64 - missing;
+        const quint64 low = m_current >> m_available;
+        return missing == 64 ? low : (high << missing) | low;
+    }
+
+    bool readBit() { return read(1) != 0; }
+
+private:
+    const quint64 *m_words;
+    quint32 m_count;
+    quint32 m_index = 0;
+    quint64 m_current = 0;
+    int m_available = 0;
+};
+
+inline quint64 zigZag(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+inline qint64 unZigZag(quint64 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+// Delta-of-delta buckets as in the Gorilla paper, with a 64-bit escape for
+// arbitrary gaps between recording sessions
+void encodeTimestamps(BitWriter &writer, const qint64 *timestamps, int count)
+{
+    qint64 previous = timestamps[0];
+    qint64 previousDelta = 0;
+    writer.write(quint64(previous), 64);
+
+    for (int i = 1; i < count; ++i) {
+        const qint64 delta = timestamps[i] - previous;
+        const qint64 deltaOfDelta = delta - previousDelta;
+        const quint64 encoded = zigZag(deltaOfDelta);
+
+        if (deltaOfDelta == 0) {
+            writer.write(0b0, 1);
+        } else if (encoded < (1u << 7)) {
+            writer.write(0b10, 2);
+            writer.write(encoded, 7);
+        } else if (encoded < (1u << 9)) {
+            writer.write(0b110, 3);
+            writer.write(encoded, 9);
+        } else if (encoded < (1u << 12)) {
+            writer.write(0b1110, 4);
+            writer.write(encoded, 12);
+        } else if (encoded < (quint64(1) << 32)) {
+            writer.write(0b11110, 5);
+            writer.write(encoded, 32);
+        } else {
+            writer.write(0b11111, 5);
+            writer.write(encoded, 64);
+        }
+
+        previous = timestamps[i];
+        previousDelta = delta;
+    }
+}
+
+void decodeTimestamps(BitReader &reader, qint64 *timestamps, int count)
+{
+    qint64 previous = qint64(reader.read(64));
+    qint64 previousDelta = 0;
+    timestamps[0] = previous;
+
+    for (int i = 1; i < count; ++i) {
+        qint64 deltaOfDelta = 0;
+        if (reader.readBit()) {
+            int bits;
+            if (!reader.readBit())
+                bits = 7;
+            else if (!reader.readBit())
+                bits = 9;
+            else if (!reader.readBit())
+                bits = 12;
+            else if (!reader.readBit())
+                bits = 32;
+            else
+                bits = 64;
+            deltaOfDelta = unZigZag(reader.read(bits));
+        }
+
+        previousDelta += deltaOfDelta;
+        previous += previousDelta;
+        timestamps[i] = previous;
+    }
+}
+
+void encodeValues(BitWriter &writer, const double *values, int count)
+{
+    quint64 previous = doubleBits(values[0]);
+    writer.write(previous, 64);
+
+    int previousLeading = 65;   // No window yet
+    int previousTrailing = 0;
+
+    for (int i = 1; i < count; ++i) {
+        const quint64 bits = doubleBits(values[i]);
+        const quint64 xored = bits ^ previous;
+        previous = bits;
+
+        if (xored == 0) {
+            writer.write(0b0, 1);
+            continue;
+        }
+
+        const int leading = qMin(int(qCountLeadingZeroBits(xored)), 31);
+        const int trailing = int(qCountTrailingZeroBits(xored));
+
+        if (leading >= previousLeading && trailing >= previousTrailing) {
+            // Fits the previous meaningful-bit window
+            writer.write(0b10, 2);
+            writer.write(xored >> previousTrailing, 64 - previousLeading - previousTrailing);
+        } else {
+            const int meaningful = 64 - leading - trailing;
+            writer.write(0b11, 2);
+            writer.write(quint64(leading), 5);
+            writer.write(quint64(meaningful & 63), 6);    // 64 is stored as 0
+            writer.write(xored >> trailing, meaningful);
+            previousLeading = leading;
+            previousTrailing = trailing;
+        }
+    }
+}
+
+void decodeValues(BitReader &reader, double *values, int count)
+{
+    quint64 previous = reader.read(64);
+    values[0] = bitsDouble(previous);
+
+    int leading = 0;
+    int trailing = 0;
+
+    for (int i = 1; i < count; ++i) {
+        if (reader.readBit()) {
+            if (reader.readBit()) {
+                leading = int(reader.read(5));
+                int meaningful = int(reader.read(6));
+                if (meaningful == 0)
+                    meaningful = 64;
+                trailing = 64 - leading - meaningful;
+            }
+            previous ^= reader.read(64 - leading - trailing) << trailing;
+        }
+        values[i] = bitsDouble(previous);
+    }
+}
+
+template <typename T>
+void valueRange(const T *values, int count, T *minimum, T *maximum)
+{
+    T low = values[0];
+    T high = values[0];
+    for (int i = 1; i < count; ++i) {
+        low = qMin(low, values[i]);
+        high = qMax(high, values[i]);
+    }
+    *minimum = low;
+    *maximum = high;
+}
+
+} // namespace
+
+void SampleCodec::encodeBlock(QByteArray &out, qint64 firstSample,
+                              const qint64 *timestamps, const double *rpm,
+                              const double *fuelFlow, int count)
+{
+    if (count <= 0)
+        return;
+
+    BitWriter timestampWriter;
+    BitWriter rpmWriter;
+    BitWriter fuelFlowWriter;
+    encodeTimestamps(timestampWriter, timestamps, count);
+    encodeValues(rpmWriter, rpm, count);
+    encodeValues(fuelFlowWriter, fuelFlow, count);
+
+    BlockHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = BLOCK_MAGIC;
+    header.sampleCount = quint32(count);
+    header.firstSample = firstSample;
+    valueRange(timestamps, count, &header.minTimestamp, &header.maxTimestamp);
+    valueRange(rpm, count, &header.minRpm, &header.maxRpm);
+    valueRange(fuelFlow, count, &header.minFuelFlow, &header.maxFuelFlow);
+    header.timestampBytes = timestampWriter.finish();
+    header.rpmBytes = rpmWriter.finish();
+    header.fuelFlowBytes = fuelFlowWriter.finish();
+
+    out.reserve(out.size() + blockSize(header));
+    out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.append(reinterpret_cast<const char *>(timestampWriter.words().data()), header.timestampBytes);
+    out.append(reinterpret_cast<const char *>(rpmWriter.words().data()), header.rpmBytes);
+    out.append(reinterpret_cast<const char *>(fuelFlowWriter.words().data()), header.fuelFlowBytes);
+}
+
+const SampleCodec::BlockHeader *SampleCodec::blockHeader(const uchar *data, qint64 size)
+{
+    if (size < qint64(sizeof(BlockHeader)))
+        return nullptr;
+
+    const auto *header = reinterpret_cast<const BlockHeader *>(data);
+    if (header->magic != BLOCK_MAGIC || header->sampleCount == 0
+        || blockSize(*header) > size) {
+        return nullptr;
+    }
+    return header;
+}
+
+qint64 SampleCodec::blockSize(const BlockHeader &header)
+{
+    return qint64(sizeof(BlockHeader)) + header.timestampBytes + header.rpmBytes + header.fuelFlowBytes;
+}
+
+void SampleCodec::decodeBlock(const BlockHeader *header, qint64 *timestamps,
+                              double *rpm, double *fuelFlow)
+{
+    const uchar *payload = reinterpret_cast<const uchar *>(header + 1);
+    const int count = int(header->sampleCount);
+
+    if (timestamps) {
+        BitReader reader(payload, header->timestampBytes);
+        decodeTimestamps(reader, timestamps, count);
+    }
+    payload += header->timestampBytes;
+
+    if (rpm) {
+        BitReader reader(payload, header->rpmBytes);
+        decodeValues(reader, rpm, count);
+    }
+    payload += header->rpmBytes;
+
+    if (fuelFlow) {
+        BitReader reader(payload, header->fuelFlowBytes);
+        decodeValues(reader, fuelFlow, count);
+    }
+}
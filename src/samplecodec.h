@@ -0,0 +1,52 @@
+#ifndef SAMPLECODEC_H
+#define SAMPLECODEC_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+// Compressed block format for sample history. Timestamps are stored as
+// delta-of-delta and rpm / fuel flow as Gorilla-style XOR of consecutive
+// IEEE doubles, each column in its own bit stream so a reader can decode
+// only the columns it needs. Every block starts with a fixed header carrying
+// the value ranges, so scans can skip blocks without decoding them.
+//
+// Blocks are multiples of 8 bytes and are decoded straight from memory,
+// including from a memory-mapped file.
+class SampleCodec
+{
+public:
+    struct BlockHeader {
+        quint32 magic;
+        quint32 sampleCount;
+        qint64 firstSample;         // Index of the first sample in the log
+        qint64 minTimestamp;
+        qint64 maxTimestamp;
+        double minRpm;
+        double maxRpm;
+        double minFuelFlow;
+        double maxFuelFlow;
+        quint32 timestampBytes;
+        quint32 rpmBytes;
+        quint32 fuelFlowBytes;
+        quint32 reserved;
+    };
+
+    static constexpr quint32 BLOCK_MAGIC = 0x4B4C4250; // "PBLK"
+
+    // Appends one encoded block (header and payload) to out
+    static void encodeBlock(QByteArray &out, qint64 firstSample,
+                            const qint64 *timestamps, const double *rpm,
+                            const double *fuelFlow, int count);
+
+    // Returns the header at data if it describes a complete block within
+    // size bytes, otherwise nullptr
+    static const BlockHeader *blockHeader(const uchar *data, qint64 size);
+    static qint64 blockSize(const BlockHeader &header);
+
+    // Decodes a block validated by blockHeader(). Output arrays must hold
+    // header->sampleCount values; pass nullptr to skip a column.
+    static void decodeBlock(const BlockHeader *header, qint64 *timestamps,
+                            double *rpm, double *fuelFlow);
+};
+
+#endif // SAMPLECODEC_H
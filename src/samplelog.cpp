@@ -0,0 +1,507 @@
+#include "samplelog.h"
+#include <QDir>
+#include <QDebug>
+#include <QSaveFile>
+#include <algorithm>
+
+SampleLog::SampleLog(const QString &directory)
+    : m_directory(directory)
+    , m_open(false)
+    , m_readOnly(false)
+    , m_archivedCount(0)
+    , m_archiveMap(nullptr)
+    , m_archiveMappedSize(0)
+    , m_tailMaps { nullptr, nullptr, nullptr }
+    , m_tailCount(0)
+    , m_tailMappedCount(0)
+{
+}
+
+SampleLog::~SampleLog()
+{
+    close();
+}
+
+bool SampleLog::open(OpenMode mode)
+{
+    if (m_open)
+        return true;
+
+    m_readOnly = mode == ReadOnly;
+    if (m_readOnly ? !QDir(m_directory).exists() : !QDir().mkpath(m_directory)) {
+        qWarning() << "SampleLog: cannot open" << m_directory;
+        return false;
+    }
+
+    std::array<qint64, ColumnCount> firstSamples;
+    if (!openArchive()
+        || !openColumn(TimestampColumn, QStringLiteral("timestamps.col"), &firstSamples[TimestampColumn])
+        || !openColumn(RpmColumn, QStringLiteral("rpm.col"), &firstSamples[RpmColumn])
+        || !openColumn(FuelFlowColumn, QStringLiteral("fuelflow.col"), &firstSamples[FuelFlowColumn])) {
+        m_archive.close();
+        for (QFile &file : m_files)
+            file.close();
+        return false;
+    }
+
+    // A crash during compaction can leave rows in the tail that were already
+    // archived, and one while the tail is replaced columns that start at
+    // different samples. Each column is read from where the archive ends;
+    // a crash can also leave columns of different lengths, and only complete
+    // rows count.
+    std::array<qint64, ColumnCount> skips;
+    qint64 count = -1;
+    bool aligned = true;
+    for (int i = 0; i < ColumnCount; ++i) {
+        const qint64 rows = qMax<qint64>(0, m_files[i].size() - HEADER_SIZE) / VALUE_SIZE;
+        skips[i] = qBound<qint64>(0, m_archivedCount - firstSamples[i], rows);
+        count = count < 0 ? rows - skips[i] : qMin(count, rows - skips[i]);
+        aligned = aligned && firstSamples[i] == m_archivedCount;
+    }
+    m_tailCount = count;
+    m_open = true;
+
+    // Readers take the log as it is; repairs are left to the writer
+    if (m_readOnly) {
+        if (!aligned) {
+            qWarning() << "SampleLog: ignoring the unrepaired tail in" << m_directory;
+            m_tailCount = 0;
+        }
+        return true;
+    }
+
+    if (aligned) {
+        for (QFile &file : m_files) {
+            file.resize(HEADER_SIZE + count * VALUE_SIZE);
+            file.seek(file.size());
+        }
+        return compactTail();
+    }
+
+    if (*std::max_element(firstSamples.cbegin(), firstSamples.cend()) > m_archivedCount)
+        qWarning() << "SampleLog: archive ends before the tail in" << m_directory;
+
+    // Rewrite the tail so it continues exactly where the archive ends
+    if (!readTail(skips, count)
+        || !writeTail(m_archivedCount, m_timestampBuffer.data(), m_rpmBuffer.data(),
+                      m_fuelFlowBuffer.data(), count)) {
+        close();
+        return false;
+    }
+
+    return compactTail();
+}
+
+void SampleLog::close()
+{
+    if (!m_open)
+        return;
+
+    unmapTail();
+    unmapArchive();
+    m_archive.close();
+    for (QFile &file : m_files)
+        file.close();
+
+    m_blocks.clear();
+    m_blockOffsets.clear();
+    m_archivedCount = 0;
+    m_tailCount = 0;
+    m_open = false;
+}
+
+QString SampleLog::checkpointPath() const
+{
+    return QDir(m_directory).filePath(QStringLiteral("statistics.ckpt"));
+}
+
+bool SampleLog::append(const TelemetrySample *samples, int count)
+{
+    if (!m_open || m_readOnly || count <= 0)
+        return m_open && !m_readOnly;
+
+    m_timestampBuffer.resize(count);
+    m_rpmBuffer.resize(count);
+    m_fuelFlowBuffer.resize(count);
+    for (int i = 0; i < count; ++i) {
+        m_timestampBuffer[i] = samples[i].timestampMs;
+        m_rpmBuffer[i] = samples[i].rpm;
+        m_fuelFlowBuffer[i] = samples[i].fuelFlow;
+    }
+
+    const qint64 bytes = count * VALUE_SIZE;
+    const bool ok = m_files[TimestampColumn].write(reinterpret_cast<const char *>(m_timestampBuffer.data()), bytes) == bytes
+        && m_files[RpmColumn].write(reinterpret_cast<const char *>(m_rpmBuffer.data()), bytes) == bytes
+        && m_files[FuelFlowColumn].write(reinterpret_cast<const char *>(m_fuelFlowBuffer.data()), bytes) == bytes;
+    if (!ok) {
+        qWarning() << "SampleLog: append failed in" << m_directory;
+        return false;
+    }
+
+    m_tailCount += count;
+    return m_tailCount < BLOCK_SAMPLES || compactTail();
+}
+
+bool SampleLog::flush()
+{
+    bool ok = m_open && !m_readOnly && m_archive.flush();
+    for (QFile &file : m_files)
+        ok = file.flush() && ok;
+    return ok;
+}
+
+void SampleLog::scan(qint64 fromSample, qint64 toSample, int fields,
+                     const std::function<void(const Columns &)> &visitor)
+{
+    if (!m_open)
+        return;
+
+    fromSample = qMax<qint64>(0, fromSample);
+    toSample = qMin(toSample, sampleCount());
+    if (fromSample >= toSample)
+        return;
+
+    // Archived part: start at the block containing fromSample
+    if (fromSample < m_archivedCount && mapArchive()) {
+        auto block = std::upper_bound(m_blocks.cbegin(), m_blocks.cend(), fromSample,
+                                      [](qint64 sample, const SampleCodec::BlockHeader &header) {
+                                          return sample < header.firstSample;
+                                      });
+        qsizetype index = qMax<qsizetype>(0, std::distance(m_blocks.cbegin(), block) - 1);
+
+        for (; index < m_blocks.size() && m_blocks.at(index).firstSample < toSample; ++index) {
+            const auto *header = reinterpret_cast<const SampleCodec::BlockHeader *>(
+                m_archiveMap + m_blockOffsets.at(index));
+            const qint64 count = header->sampleCount;
+            m_timestampBuffer.resize(count);
+            m_rpmBuffer.resize(count);
+            m_fuelFlowBuffer.resize(count);
+
+            SampleCodec::decodeBlock(header,
+                                     fields & Timestamps ? m_timestampBuffer.data() : nullptr,
+                                     fields & Rpm ? m_rpmBuffer.data() : nullptr,
+                                     fields & FuelFlow ? m_fuelFlowBuffer.data() : nullptr);
+
+            const qint64 skip = qMax<qint64>(0, fromSample - header->firstSample);
+            Columns chunk;
+            chunk.timestamps = fields & Timestamps ? m_timestampBuffer.data() + skip : nullptr;
+            chunk.rpm = fields & Rpm ? m_rpmBuffer.data() + skip : nullptr;
+            chunk.fuelFlow = fields & FuelFlow ? m_fuelFlowBuffer.data() + skip : nullptr;
+            chunk.firstSample = header->firstSample + skip;
+            chunk.count = qMin(count, toSample - header->firstSample) - skip;
+            visitor(chunk);
+        }
+    }
+
+    // Raw tail, read in place from the mapped columns
+    const qint64 skip = qMax<qint64>(0, fromSample - m_archivedCount);
+    const qint64 end = toSample - m_archivedCount;
+    if (skip < end && mapTail()) {
+        Columns chunk;
+        chunk.timestamps = reinterpret_cast<const qint64 *>(m_tailMaps[TimestampColumn] + HEADER_SIZE) + skip;
+        chunk.rpm = reinterpret_cast<const double *>(m_tailMaps[RpmColumn] + HEADER_SIZE) + skip;
+        chunk.fuelFlow = reinterpret_cast<const double *>(m_tailMaps[FuelFlowColumn] + HEADER_SIZE) + skip;
+        chunk.firstSample = m_archivedCount + skip;
+        chunk.count = end - skip;
+        visitor(chunk);
+    }
+}
+
+qint64 SampleLog::findTimestamp(qint64 timestampMs)
+{
+    if (!m_open)
+        return 0;
+
+    // The first block that reaches the timestamp holds it; past the last
+    // block only the tail is left
+    const auto block = std::partition_point(m_blocks.cbegin(), m_blocks.cend(),
+                                            [timestampMs](const SampleCodec::BlockHeader &header) {
+                                                return header.maxTimestamp < timestampMs;
+                                            });
+    const qint64 fromSample = block != m_blocks.cend() ? block->firstSample : m_archivedCount;
+    const qint64 toSample = block != m_blocks.cend() ? block->firstSample + block->sampleCount : sampleCount();
+
+    qint64 found = toSample;
+    scan(fromSample, toSample, Timestamps, [&found, timestampMs](const Columns &chunk) {
+        const qint64 *end = chunk.timestamps + chunk.count;
+        const qint64 *timestamp = std::lower_bound(chunk.timestamps, end, timestampMs);
+        if (timestamp != end)
+            found = qMin(found, chunk.firstSample + (timestamp - chunk.timestamps));
+    });
+    return found;
+}
+
+qint64 SampleLog::timestampAt(qint64 sample)
+{
+    qint64 timestamp = -1;
+    scan(sample, sample + 1, Timestamps, [&timestamp](const Columns &chunk) {
+        timestamp = chunk.timestamps[0];
+    });
+    return timestamp;
+}
+
+bool SampleLog::openArchive()
+{
+    m_archive.setFileName(QDir(m_directory).filePath(QStringLiteral("archive.blk")));
+    if (!m_archive.open(m_readOnly ? QIODevice::ReadOnly : QIODevice::ReadWrite)) {
+        qWarning() << "SampleLog: cannot open" << m_archive.fileName() << m_archive.errorString();
+        return false;
+    }
+
+    // Index the block headers; anything after the last intact block is a
+    // torn write and gets cut off
+    m_blocks.clear();
+    m_blockOffsets.clear();
+    m_archivedCount = 0;
+
+    qint64 offset = 0;
+    const qint64 size = m_archive.size();
+    if (size > 0 && mapArchive()) {
+        while (const SampleCodec::BlockHeader *header = SampleCodec::blockHeader(m_archiveMap + offset, size - offset)) {
+            if (header->firstSample != m_archivedCount)
+                break;
+            m_blocks.append(*header);
+            m_blockOffsets.append(offset);
+            m_archivedCount += header->sampleCount;
+            offset += SampleCodec::blockSize(*header);
+        }
+        unmapArchive();
+    }
+
+    if (offset != size && m_readOnly) {
+        qWarning() << "SampleLog: ignoring the damaged end of" << m_archive.fileName();
+        return true;
+    } else if (offset != size) {
+        qWarning() << "SampleLog: truncating damaged archive" << m_archive.fileName();
+        m_archive.resize(offset);
+    }
+    return m_readOnly || m_archive.seek(offset);
+}
+
+bool SampleLog::openColumn(Column column, const QString &fileName, qint64 *firstSample)
+{
+    QFile &file = m_files[column];
+    file.setFileName(QDir(m_directory).filePath(fileName));
+    if (!file.open(m_readOnly ? QIODevice::ReadOnly : QIODevice::ReadWrite)) {
+        qWarning() << "SampleLog: cannot open" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    ColumnHeader header;
+    if (file.size() < HEADER_SIZE && m_readOnly) {
+        *firstSample = m_archivedCount;
+        return true;
+    } else if (file.size() < HEADER_SIZE) {
+        header = { MAGIC, VERSION, quint32(column), 0, m_archivedCount };
+        file.resize(0);
+        if (file.write(reinterpret_cast<const char *>(&header), HEADER_SIZE) != HEADER_SIZE)
+            return false;
+    } else if (file.read(reinterpret_cast<char *>(&header), HEADER_SIZE) != HEADER_SIZE
+               || header.magic != MAGIC || header.version != VERSION
+               || header.column != quint32(column)) {
+        qWarning() << "SampleLog: unrecognised column file" << file.fileName();
+        return false;
+    }
+
+    *firstSample = header.firstSample;
+    return m_readOnly || file.seek(file.size());
+}
+
+bool SampleLog::writeTail(qint64 firstSample, const qint64 *timestamps, const double *rpm,
+                          const double *fuelFlow, qint64 count)
+{
+    unmapTail();
+
+    const std::array<const char *, ColumnCount> values {
+        reinterpret_cast<const char *>(timestamps),
+        reinterpret_cast<const char *>(rpm),
+        reinterpret_cast<const char *>(fuelFlow)
+    };
+
+    // The new columns are written out in full before any of them replaces
+    // its old one, and each replacement is a rename. A crash in between
+    // leaves whole columns of either generation, which open() lines up by
+    // their first sample.
+    std::array<std::unique_ptr<QSaveFile>, ColumnCount> replacements;
+    for (int i = 0; i < ColumnCount; ++i) {
+        replacements[i] = std::make_unique<QSaveFile>(m_files[i].fileName());
+        QSaveFile &file = *replacements[i];
+        const ColumnHeader header = { MAGIC, VERSION, quint32(i), 0, firstSample };
+        const qint64 bytes = count * VALUE_SIZE;
+        if (!file.open(QIODevice::WriteOnly)
+            || file.write(reinterpret_cast<const char *>(&header), HEADER_SIZE) != HEADER_SIZE
+            || (bytes > 0 && file.write(values[i], bytes) != bytes)
+            || !file.flush()) {
+            qWarning() << "SampleLog: cannot rewrite" << m_files[i].fileName() << file.errorString();
+            return false;
+        }
+    }
+
+    // The open columns are closed first, as some platforms do not rename
+    // over open files
+    bool ok = true;
+    for (int i = 0; i < ColumnCount; ++i) {
+        QFile &file = m_files[i];
+        file.close();
+        if (ok && !replacements[i]->commit()) {
+            qWarning() << "SampleLog: cannot replace" << file.fileName() << replacements[i]->errorString();
+            ok = false;
+        }
+        if (!file.open(QIODevice::ReadWrite) || !file.seek(file.size())) {
+            qWarning() << "SampleLog: cannot reopen" << file.fileName() << file.errorString();
+            ok = false;
+        }
+    }
+    if (!ok)
+        return false;
+
+    m_tailCount = count;
+    return true;
+}
+
+bool SampleLog::compactTail()
+{
+    if (m_tailCount < BLOCK_SAMPLES)
+        return true;
+    if (!mapTail())
+        return false;
+
+    const auto *timestamps = reinterpret_cast<const qint64 *>(m_tailMaps[TimestampColumn] + HEADER_SIZE);
+    const auto *rpm = reinterpret_cast<const double *>(m_tailMaps[RpmColumn] + HEADER_SIZE);
+    const auto *fuelFlow = reinterpret_cast<const double *>(m_tailMaps[FuelFlowColumn] + HEADER_SIZE);
+
+    QByteArray encoded;
+    qint64 archived = 0;
+    while (m_tailCount - archived >= BLOCK_SAMPLES) {
+        SampleCodec::encodeBlock(encoded, m_archivedCount + archived, timestamps + archived,
+                                 rpm + archived, fuelFlow + archived, BLOCK_SAMPLES);
+        archived += BLOCK_SAMPLES;
+    }
+
+    // The archive is made durable before the tail gives the samples up, so a
+    // crash in between only leaves duplicates that open() drops
+    const qint64 offset = m_archive.size();
+    if (m_archive.write(encoded) != encoded.size() || !m_archive.flush()) {
+        qWarning() << "SampleLog: cannot append to" << m_archive.fileName();
+        m_archive.resize(offset);
+        m_archive.seek(offset);
+        return false;
+    }
+
+    const auto *data = reinterpret_cast<const uchar *>(encoded.constData());
+    for (qint64 position = 0; position < encoded.size();) {
+        const SampleCodec::BlockHeader *header = SampleCodec::blockHeader(data + position, encoded.size() - position);
+        m_blocks.append(*header);
+        m_blockOffsets.append(offset + position);
+        position += SampleCodec::blockSize(*header);
+    }
+    m_archivedCount += archived;
+
+    return copyTail(archived)
+        && writeTail(m_archivedCount, m_timestampBuffer.data(), m_rpmBuffer.data(),
+                     m_fuelFlowBuffer.data(), m_tailCount - archived);
+}
+
+bool SampleLog::copyTail(qint64 fromRow)
+{
+    m_timestampBuffer.clear();
+    m_rpmBuffer.clear();
+    m_fuelFlowBuffer.clear();
+    if (fromRow >= m_tailCount)
+        return true;
+    if (!mapTail())
+        return false;
+
+    const auto *timestamps = reinterpret_cast<const qint64 *>(m_tailMaps[TimestampColumn] + HEADER_SIZE);
+    const auto *rpm = reinterpret_cast<const double *>(m_tailMaps[RpmColumn] + HEADER_SIZE);
+    const auto *fuelFlow = reinterpret_cast<const double *>(m_tailMaps[FuelFlowColumn] + HEADER_SIZE);
+    m_timestampBuffer.assign(timestamps + fromRow, timestamps + m_tailCount);
+    m_rpmBuffer.assign(rpm + fromRow, rpm + m_tailCount);
+    m_fuelFlowBuffer.assign(fuelFlow + fromRow, fuelFlow + m_tailCount);
+    return true;
+}
+
+bool SampleLog::readTail(const std::array<qint64, ColumnCount> &fromRows, qint64 count)
+{
+    m_timestampBuffer.resize(count);
+    m_rpmBuffer.resize(count);
+    m_fuelFlowBuffer.resize(count);
+    const std::array<char *, ColumnCount> values {
+        reinterpret_cast<char *>(m_timestampBuffer.data()),
+        reinterpret_cast<char *>(m_rpmBuffer.data()),
+        reinterpret_cast<char *>(m_fuelFlowBuffer.data())
+    };
+
+    unmapTail();
+    const qint64 bytes = count * VALUE_SIZE;
+    for (int i = 0; i < ColumnCount; ++i) {
+        QFile &file = m_files[i];
+        if (!file.seek(HEADER_SIZE + fromRows[i] * VALUE_SIZE)
+            || (bytes > 0 && file.read(values[i], bytes) != bytes)) {
+            qWarning() << "SampleLog: cannot read" << file.fileName();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SampleLog::mapTail()
+{
+    if (m_tailMappedCount == m_tailCount && (m_tailCount == 0 || m_tailMaps[0]))
+        return true;
+
+    unmapTail();
+    if (m_tailCount == 0)
+        return true;
+
+    const qint64 size = HEADER_SIZE + m_tailCount * VALUE_SIZE;
+    for (int i = 0; i < ColumnCount; ++i) {
+        m_files[i].flush();
+        m_tailMaps[i] = m_files[i].map(0, size);
+        if (!m_tailMaps[i]) {
+            qWarning() << "SampleLog: cannot map" << m_files[i].fileName();
+            unmapTail();
+            return false;
+        }
+    }
+    m_tailMappedCount = m_tailCount;
+    return true;
+}
+
+bool SampleLog::mapArchive()
+{
+    const qint64 size = m_archive.size();
+    if (m_archiveMap && m_archiveMappedSize == size)
+        return true;
+
+    unmapArchive();
+    if (size == 0)
+        return false;
+
+    m_archive.flush();
+    m_archiveMap = m_archive.map(0, size);
+    if (!m_archiveMap) {
+        qWarning() << "SampleLog: cannot map" << m_archive.fileName();
+        return false;
+    }
+    m_archiveMappedSize = size;
+    return true;
+}
+
+void SampleLog::unmapTail()
+{
+    for (int i = 0; i < ColumnCount; ++i) {
+        if (m_tailMaps[i])
+            m_files[i].unmap(m_tailMaps[i]);
+        m_tailMaps[i] = nullptr;
+    }
+    m_tailMappedCount = 0;
+}
+
+void SampleLog::unmapArchive()
+{
+    if (m_archiveMap)
+        m_archive.unmap(m_archiveMap);
+    m_archiveMap = nullptr;
+    m_archiveMappedSize = 0;
+}
@@ -0,0 +1,144 @@
+#ifndef SAMPLELOG_H
+#define SAMPLELOG_H
+
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <array>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "samplecodec.h"
+#include "telemetrysample.h"
+
+// Append-only on-disk history of engine samples.
+//
+// New samples land in a raw tail: one column file per field (timestamps,
+// rpm, fuel flow) holding a packed native-endian array behind a small
+// header. Every BLOCK_SAMPLES samples the tail is compressed into a
+// SampleCodec block appended to the archive file and the tail starts over.
+// Both files are memory-mapped for reading and scanned column by column.
+class SampleLog
+{
+public:
+    // Read-only view of consecutive samples starting at firstSample. Only
+    // valid inside the scan() visitor that received it.
+    struct Columns {
+        const qint64 *timestamps = nullptr;
+        const double *rpm = nullptr;
+        const double *fuelFlow = nullptr;
+        qint64 firstSample = 0;
+        qint64 count = 0;
+    };
+
+    enum Field {
+        Timestamps = 0x1,
+        Rpm = 0x2,
+        FuelFlow = 0x4,
+        AllFields = Timestamps | Rpm | FuelFlow
+    };
+
+    // A read-only log is neither repaired nor appended to, so any number of
+    // readers can open the same directory, e.g. to replay a trip
+    enum OpenMode {
+        ReadWrite,
+        ReadOnly
+    };
+
+    static constexpr int BLOCK_SAMPLES = 4096;
+
+    explicit SampleLog(const QString &directory);
+    ~SampleLog();
+
+    bool open(OpenMode mode = ReadWrite);
+    void close();
+    bool isOpen() const { return m_open; }
+    bool isReadOnly() const { return m_readOnly; }
+
+    QString directory() const { return m_directory; }
+    QString checkpointPath() const;
+
+    bool append(const TelemetrySample *samples, int count);
+    bool flush();
+    qint64 sampleCount() const { return m_archivedCount + m_tailCount; }
+
+    // Calls visitor for consecutive chunks covering [fromSample, sampleCount()).
+    // Archived blocks are decoded only for the requested fields; the others
+    // are nullptr in those chunks.
+    void scan(qint64 fromSample, int fields,
+              const std::function<void(const Columns &)> &visitor)
+    {
+        scan(fromSample, sampleCount(), fields, visitor);
+    }
+
+    // Same for [fromSample, toSample); blocks past toSample are not decoded
+    void scan(qint64 fromSample, qint64 toSample, int fields,
+              const std::function<void(const Columns &)> &visitor);
+
+    // Index of the first sample at or after timestampMs, or sampleCount().
+    // The block headers serve as a sparse time index, so at most one block
+    // is decoded. Timestamps are assumed to be recorded in order.
+    qint64 findTimestamp(qint64 timestampMs);
+
+    // Timestamp of one sample, or -1 outside the log
+    qint64 timestampAt(qint64 sample);
+
+    // Headers of the archived blocks in log order, for skipping by range
+    const QList<SampleCodec::BlockHeader> &blocks() const { return m_blocks; }
+
+private:
+    enum Column {
+        TimestampColumn,
+        RpmColumn,
+        FuelFlowColumn,
+        ColumnCount
+    };
+
+    struct ColumnHeader {
+        quint32 magic;
+        quint32 version;
+        quint32 column;
+        quint32 reserved;
+        qint64 firstSample;     // Log index of the first value in the tail
+    };
+
+    static constexpr quint32 MAGIC = 0x4C535042; // "BPSL"
+    static constexpr quint32 VERSION = 2;
+    static constexpr qint64 HEADER_SIZE = sizeof(ColumnHeader);
+    static constexpr qint64 VALUE_SIZE = 8;
+
+    bool openArchive();
+    bool openColumn(Column column, const QString &fileName, qint64 *firstSample);
+    bool writeTail(qint64 firstSample, const qint64 *timestamps, const double *rpm,
+                   const double *fuelFlow, qint64 count);
+    bool compactTail();
+    bool copyTail(qint64 fromRow);
+    bool readTail(const std::array<qint64, ColumnCount> &fromRows, qint64 count);
+    bool mapTail();
+    bool mapArchive();
+    void unmapTail();
+    void unmapArchive();
+
+    QString m_directory;
+    bool m_open;
+    bool m_readOnly;
+
+    QFile m_archive;
+    QList<SampleCodec::BlockHeader> m_blocks;
+    QList<qint64> m_blockOffsets;
+    qint64 m_archivedCount;
+    uchar *m_archiveMap;
+    qint64 m_archiveMappedSize;
+
+    std::array<QFile, ColumnCount> m_files;
+    std::array<uchar *, ColumnCount> m_tailMaps;
+    qint64 m_tailCount;
+    qint64 m_tailMappedCount;
+
+    // Reused transpose and decode buffers
+    std::vector<qint64> m_timestampBuffer;
+    std::vector<double> m_rpmBuffer;
+    std::vector<double> m_fuelFlowBuffer;
+};
+
+#endif // SAMPLELOG_H
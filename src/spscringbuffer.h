@@ -0,0 +1,86 @@
+#ifndef SPSCRINGBUFFER_H
+#define SPSCRINGBUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. push() never blocks: when the ring is full it fails and the caller
+// decides what to drop, so a stalled consumer can never stall the producer.
+template <typename T>
+class SpscRingBuffer
+{
+public:
+    explicit SpscRingBuffer(std::size_t capacity)
+        : m_buffer(roundUpToPowerOfTwo(capacity))
+        , m_mask(m_buffer.size() - 1)
+    {
+    }
+
+    SpscRingBuffer(const SpscRingBuffer &) = delete;
+    SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+
+    std::size_t capacity() const { return m_buffer.size(); }
+
+    // Producer side
+    bool push(const T &value)
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_cachedTail == m_buffer.size()) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head - m_cachedTail == m_buffer.size())
+                return false;
+        }
+
+        m_buffer[head & m_mask] = value;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: moves up to maxCount queued items into out and returns
+    // how many were taken
+    std::size_t pop(T *out, std::size_t maxCount)
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        const std::size_t head = m_head.load(std::memory_order_acquire);
+        const std::size_t count = std::min(head - tail, maxCount);
+
+        for (std::size_t i = 0; i < count; ++i)
+            out[i] = m_buffer[(tail + i) & m_mask];
+
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Approximate when called concurrently with push()
+    std::size_t size() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    static std::size_t roundUpToPowerOfTwo(std::size_t value)
+    {
+        std::size_t result = 2;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    static constexpr std::size_t CACHE_LINE = 64;
+
+    std::vector<T> m_buffer;
+    const std::size_t m_mask;
+
+    // Written by the producer; m_cachedTail avoids touching the consumer's
+    // cache line on every push
+    alignas(CACHE_LINE) std::atomic<std::size_t> m_head { 0 };
+    std::size_t m_cachedTail = 0;
+
+    // Written by the consumer
+    alignas(CACHE_LINE) std::atomic<std::size_t> m_tail { 0 };
+};
+
+#endif // SPSCRINGBUFFER_H
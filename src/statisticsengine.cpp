@@ -0,0 +1,390 @@
+#include "statisticsengine.h"
+#include "metrics.h"
+#include "samplelog.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+
+StatisticsEngine::StatisticsEngine(double lowerPercentile, double upperPercentile)
+    : m_latestTimestamp(-1)
+    , m_expiryDue(false)
+    , m_hasChanges(false)
+    , m_lowerPercentile(lowerPercentile)
+    , m_upperPercentile(upperPercentile)
+    , m_sampleLog(nullptr)
+    , m_checkpointedSampleCount(0)
+    , m_replayLog(nullptr)
+    , m_replayPosition(0)
+    , m_version(0)
+    , m_front(0)
+    , m_backFree(true)
+    , m_publishPending(false)
+{
+}
+
+StatisticsSnapshot StatisticsEngine::acquire()
+{
+    const StatisticsSnapshot snapshot = m_slots[m_front.load(std::memory_order_acquire)];
+
+    // Hand the other slot back to the engine. Both flags are sequentially
+    // consistent, so either this side sees the pending publish or the
+    // engine sees the free slot.
+    m_backFree.store(true);
+    if (m_publishPending.load())
+        QMetaObject::invokeMethod(this, &StatisticsEngine::publish, Qt::QueuedConnection);
+
+    return snapshot;
+}
+
+void StatisticsEngine::setBaseline(const BinStore &baseline)
+{
+    const bool relayout = baseline.layout != m_baseline.layout || baseline.size() != m_baseline.size();
+    m_baseline = baseline;
+    m_bins.fill(baseline);
+
+    if (relayout) {
+        DensityGrid density;
+        density.reset(baseline.layout);
+        m_density.fill(density);
+        m_changedRows.fill(false, m_baseline.size());
+        rebuildStatistics();
+    } else {
+        applyAllStatistics();
+    }
+
+    markChanged(0, m_baseline.size() - 1);
+    publish();
+}
+
+void StatisticsEngine::setPercentiles(double lowerPercentile, double upperPercentile)
+{
+    if (qFuzzyCompare(m_lowerPercentile, lowerPercentile)
+        && qFuzzyCompare(m_upperPercentile, upperPercentile)) {
+        return;
+    }
+
+    m_lowerPercentile = lowerPercentile;
+    m_upperPercentile = upperPercentile;
+    rebuildStatistics();
+    markChanged(0, m_baseline.size() - 1);
+    publish();
+}
+
+void StatisticsEngine::attachHistory(SampleLog *log)
+{
+    m_replayLog = nullptr;
+    m_sampleLog = log && log->isOpen() ? log : nullptr;
+    if (!m_sampleLog)
+        return;
+
+    // Start from the last checkpoint and replay only the tail recorded after it
+    ScopedTimer timer(Metrics::ModelReset);
+    resetStatistics();
+    const qint64 restored = loadCheckpoint(m_sampleLog->checkpointPath());
+    replayHistory(restored);
+    applyAllStatistics();
+    m_checkpointedSampleCount = restored;
+
+    markChanged(0, m_baseline.size() - 1);
+    publish();
+}
+
+void StatisticsEngine::ingest(const std::vector<TelemetrySample> &samples)
+{
+    for (const TelemetrySample &sample : samples) {
+        const int row = accumulateSample(sample.timestampMs, sample.rpm, sample.fuelFlow);
+        if (m_replayLog)
+            advanceReplay();
+        if (row >= 0)
+            markChanged(row, row);
+    }
+
+    // Each changed bin is applied once per batch, however many samples it
+    // got. Windows also shrink in bins that saw no new samples.
+    if (m_expiryDue) {
+        applyAllStatistics();
+        markChanged(0, m_baseline.size() - 1);
+    } else {
+        for (int row = 0; row < m_changedRows.size(); ++row) {
+            if (m_changedRows.at(row))
+                applyStatistics(row);
+        }
+    }
+
+    if (m_sampleLog) {
+        m_sampleLog->append(samples.data(), int(samples.size()));
+        if (m_sampleLog->sampleCount() - m_checkpointedSampleCount >= CHECKPOINT_INTERVAL)
+            saveCheckpoint();
+    }
+
+    publish();
+}
+
+void StatisticsEngine::attachReplay(SampleLog *log)
+{
+    m_sampleLog = nullptr;
+    m_replayLog = log && log->isOpen() ? log : nullptr;
+    m_replayPosition = 0;
+    resetStatistics();
+    m_replayCheckpoints.clear();
+    m_replayCheckpoints.append({ m_latestTimestamp, m_binStatistics });
+
+    applyAllStatistics();
+    markChanged(0, m_baseline.size() - 1);
+    publish();
+}
+
+void StatisticsEngine::seekReplay(qint64 sample)
+{
+    if (!m_replayLog)
+        return;
+
+    ScopedTimer timer(Metrics::ModelReset);
+    replayTo(qBound<qint64>(0, sample, m_replayLog->sampleCount()));
+    applyAllStatistics();
+
+    markChanged(0, m_baseline.size() - 1);
+    publish();
+}
+
+bool StatisticsEngine::saveCheckpoint()
+{
+    if (!m_sampleLog)
+        return false;
+
+    // The checkpoint must never cover samples that are not on disk yet
+    m_sampleLog->flush();
+    const qint64 sampleCount = m_sampleLog->sampleCount();
+
+    QSaveFile file(m_sampleLog->checkpointPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "StatisticsEngine: cannot write checkpoint" << file.fileName();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << CHECKPOINT_MAGIC << CHECKPOINT_VERSION << sampleCount
+           << m_baseline.layout.binWidth << m_baseline.layout.minRpm
+           << m_baseline.layout.minFuelFlow << m_baseline.layout.maxFuelFlow
+           << m_lowerPercentile << m_upperPercentile << m_latestTimestamp
+           << qint32(m_binStatistics.size());
+    for (const BinStatistics &statistics : std::as_const(m_binStatistics))
+        stream << statistics;
+
+    if (!file.commit()) {
+        qWarning() << "StatisticsEngine: cannot write checkpoint" << file.fileName();
+        return false;
+    }
+
+    m_checkpointedSampleCount = sampleCount;
+    return true;
+}
+
+void StatisticsEngine::publish()
+{
+    if (!m_hasChanges)
+        return;
+
+    // Announce the pending publish before checking the slot; see acquire()
+    m_publishPending.store(true);
+    if (!m_backFree.load())
+        return;
+
+    StatisticsSnapshot &snapshot = m_slots[1 - m_front.load(std::memory_order_relaxed)];
+    snapshot.version = ++m_version;
+    snapshot.bins = m_bins;
+    snapshot.density = m_density;
+    snapshot.changed.clear();
+    for (int row = 0; row < m_changedRows.size(); ++row) {
+        if (!m_changedRows.at(row))
+            continue;
+
+        int runEnd = row;
+        while (runEnd + 1 < m_changedRows.size() && m_changedRows.at(runEnd + 1))
+            ++runEnd;
+        snapshot.changed.append({ row, runEnd });
+        row = runEnd;
+    }
+    m_changedRows.fill(false, m_baseline.size());
+    m_hasChanges = false;
+
+    m_publishPending.store(false);
+    m_backFree.store(false);
+    m_front.store(1 - m_front.load(std::memory_order_relaxed), std::memory_order_release);
+    emit snapshotReady();
+}
+
+void StatisticsEngine::markChanged(int firstRow, int lastRow)
+{
+    if (m_changedRows.size() != m_baseline.size())
+        m_changedRows.fill(false, m_baseline.size());
+
+    for (int row = qMax(0, firstRow); row <= lastRow && row < m_changedRows.size(); ++row)
+        m_changedRows[row] = true;
+    m_hasChanges = true;
+}
+
+int StatisticsEngine::accumulateSample(qint64 timestampMs, double rpm, double fuelFlow)
+{
+    // Crossing into the next slot of the shortest window expires slots everywhere
+    if (timestampMs > m_latestTimestamp) {
+        const qint64 slotMs = BinStatistics::windowMs(LastHourWindow) / WindowedQuantiles::SLOTS;
+        m_expiryDue = m_expiryDue || m_latestTimestamp < 0 || timestampMs / slotMs != m_latestTimestamp / slotMs;
+        m_latestTimestamp = timestampMs;
+    }
+
+    const int row = m_baseline.layout.binIndex(rpm);
+    if (row < 0 || row >= m_binStatistics.size() || !qIsFinite(fuelFlow))
+        return -1;
+
+    m_binStatistics[row].add(timestampMs, fuelFlow);
+    return row;
+}
+
+void StatisticsEngine::applyStatistics(int row)
+{
+    if (row >= m_binStatistics.size())
+        return;
+
+    // Until a window has samples, or once they have all expired, it shows
+    // the baseline
+    BinStatistics &statistics = m_binStatistics[row];
+    statistics.advance(m_latestTimestamp);
+    for (int window = 0; window < StatisticsWindowCount; ++window) {
+        const auto statisticsWindow = StatisticsWindow(window);
+        const bool learned = statistics.count(statisticsWindow) > 0;
+        BinStore &bins = m_bins[window];
+        bins.minFuelFlow[row] = learned ? statistics.lower(statisticsWindow) : m_baseline.minFuelFlow.at(row);
+        bins.maxFuelFlow[row] = learned ? statistics.upper(statisticsWindow) : m_baseline.maxFuelFlow.at(row);
+        bins.medianFuelFlow[row] = learned ? statistics.median(statisticsWindow) : m_baseline.medianFuelFlow.at(row);
+        m_density[window].rows[row] = statistics.histogram(statisticsWindow);
+    }
+}
+
+void StatisticsEngine::applyAllStatistics()
+{
+    for (int row = 0; row < m_baseline.size(); ++row)
+        applyStatistics(row);
+    m_expiryDue = false;
+}
+
+void StatisticsEngine::resetStatistics()
+{
+    const BinLayout &layout = m_baseline.layout;
+    m_binStatistics.fill(BinStatistics(m_lowerPercentile, m_upperPercentile, layout.minFuelFlow, layout.maxFuelFlow),
+                         m_baseline.size());
+    m_latestTimestamp = -1;
+    m_expiryDue = false;
+}
+
+void StatisticsEngine::rebuildStatistics()
+{
+    ScopedTimer timer(Metrics::ModelReset);
+    resetStatistics();
+    if (m_replayLog) {
+        // Checkpoints of another layout or percentiles are useless
+        const qint64 position = m_replayPosition;
+        m_replayCheckpoints.clear();
+        m_replayCheckpoints.append({ m_latestTimestamp, m_binStatistics });
+        m_replayPosition = 0;
+        replayTo(position);
+    } else {
+        replayHistory(0);
+    }
+
+    applyAllStatistics();
+
+    if (m_sampleLog)
+        saveCheckpoint();
+}
+
+void StatisticsEngine::replayHistory(qint64 fromSample)
+{
+    if (!m_sampleLog)
+        return;
+
+    m_sampleLog->scan(fromSample, SampleLog::AllFields, [this](const SampleLog::Columns &chunk) {
+        for (qint64 i = 0; i < chunk.count; ++i)
+            accumulateSample(chunk.timestamps[i], chunk.rpm[i], chunk.fuelFlow[i]);
+    });
+}
+
+void StatisticsEngine::replayTo(qint64 sample)
+{
+    // Go on from the playback position unless a checkpoint is closer
+    const qint64 checkpoint = qMin<qint64>(sample / CHECKPOINT_INTERVAL, m_replayCheckpoints.size() - 1);
+    if (m_replayPosition > sample || checkpoint * CHECKPOINT_INTERVAL > m_replayPosition) {
+        const ReplayCheckpoint &restored = m_replayCheckpoints.at(checkpoint);
+        m_binStatistics = restored.statistics;
+        m_latestTimestamp = restored.latestTimestamp;
+        m_replayPosition = checkpoint * CHECKPOINT_INTERVAL;
+    }
+
+    m_replayLog->scan(m_replayPosition, sample, SampleLog::AllFields,
+                      [this](const SampleLog::Columns &chunk) {
+        for (qint64 i = 0; i < chunk.count; ++i) {
+            accumulateSample(chunk.timestamps[i], chunk.rpm[i], chunk.fuelFlow[i]);
+            advanceReplay();
+        }
+    });
+}
+
+void StatisticsEngine::advanceReplay()
+{
+    // Checkpoints are taken the first time playback passes them
+    ++m_replayPosition;
+    if (m_replayPosition % CHECKPOINT_INTERVAL == 0
+        && m_replayPosition / CHECKPOINT_INTERVAL == m_replayCheckpoints.size()) {
+        m_replayCheckpoints.append({ m_latestTimestamp, m_binStatistics });
+    }
+}
+
+qint64 StatisticsEngine::loadCheckpoint(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint64 sampleCount = 0;
+    double binWidth = 0.0;
+    double firstRpm = 0.0;
+    double minFuelFlow = 0.0;
+    double maxFuelFlow = 0.0;
+    double lowerPercentile = 0.0;
+    double upperPercentile = 0.0;
+    qint64 latestTimestamp = -1;
+    qint32 binCount = 0;
+    stream >> magic >> version >> sampleCount >> binWidth >> firstRpm >> minFuelFlow >> maxFuelFlow
+           >> lowerPercentile >> upperPercentile >> latestTimestamp >> binCount;
+
+    // Anything that does not match the current bin layout is rebuilt from scratch
+    if (stream.status() != QDataStream::Ok || magic != CHECKPOINT_MAGIC
+        || version != CHECKPOINT_VERSION || binCount != m_binStatistics.size()
+        || !qFuzzyCompare(binWidth, m_baseline.layout.binWidth)
+        || !qFuzzyCompare(1.0 + firstRpm, 1.0 + m_baseline.layout.minRpm)
+        || !qFuzzyCompare(1.0 + minFuelFlow, 1.0 + m_baseline.layout.minFuelFlow)
+        || !qFuzzyCompare(1.0 + maxFuelFlow, 1.0 + m_baseline.layout.maxFuelFlow)
+        || !qFuzzyCompare(lowerPercentile, m_lowerPercentile)
+        || !qFuzzyCompare(upperPercentile, m_upperPercentile)
+        || sampleCount < 0 || sampleCount > m_sampleLog->sampleCount()) {
+        return 0;
+    }
+
+    QList<BinStatistics> statistics(binCount);
+    for (BinStatistics &bin : statistics)
+        stream >> bin;
+
+    if (stream.status() != QDataStream::Ok)
+        return 0;
+
+    m_binStatistics = statistics;
+    m_latestTimestamp = latestTimestamp;
+    return sampleCount;
+}
@@ -0,0 +1,121 @@
+#ifndef STATISTICSENGINE_H
+#define STATISTICSENGINE_H
+
+#include <QObject>
+#include <QList>
+#include <array>
+#include <atomic>
+#include <vector>
+#include "binstatistics.h"
+#include "binstore.h"
+#include "telemetrysample.h"
+
+class SampleLog;
+
+// Immutable result of the statistics engine. Columns are implicitly shared,
+// so copies are cheap and never change underneath their holder.
+struct StatisticsSnapshot {
+    struct RowRange {
+        int first;
+        int last;
+    };
+
+    quint64 version = 0;        // 0 until the engine has published
+
+    // Baseline bins with the learned envelope applied, one table per
+    // StatisticsWindow
+    std::array<BinStore, StatisticsWindowCount> bins;
+
+    // Learned sample density of the bins, per StatisticsWindow
+    std::array<DensityGrid, StatisticsWindowCount> density;
+    QList<RowRange> changed;    // Runs of rows changed since the previous snapshot, in both
+};
+
+// Learns the per-bin fuel-flow envelope on its own thread. Everything except
+// acquire() runs on that thread and is reached through queued calls.
+//
+// Results are published through two snapshot slots: the engine fills the
+// back slot and swaps it to the front with one atomic store, then signals
+// snapshotReady(). The engine only refills the back slot once the reader
+// has acquired the front one, so neither side ever locks or waits; changes
+// made in the meantime are coalesced into the next snapshot.
+class StatisticsEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StatisticsEngine(double lowerPercentile, double upperPercentile);
+
+    // Reader side, for one consumer thread: the latest published snapshot
+    StatisticsSnapshot acquire();
+
+    // New synthetic baseline. A different layout discards the learned
+    // statistics and relearns them from the history.
+    void setBaseline(const BinStore &baseline);
+    void setPercentiles(double lowerPercentile, double upperPercentile);
+
+    // Restores the statistics from the log's last checkpoint and replays
+    // the samples recorded after it. The log is only used from the engine
+    // thread from now on.
+    void attachHistory(SampleLog *log);
+    void ingest(const std::vector<TelemetrySample> &samples);
+    bool saveCheckpoint();
+
+    // Replay instead of live history: the statistics cover the log up to the
+    // playback position, which ingest() advances and seekReplay() moves.
+    // Seeking starts over from the nearest in-memory checkpoint, or goes on
+    // from the current position if that is closer. Nothing is appended.
+    void attachReplay(SampleLog *log);
+    void seekReplay(qint64 sample);
+
+signals:
+    void snapshotReady();
+
+private:
+    void publish();
+    void markChanged(int firstRow, int lastRow);
+    int accumulateSample(qint64 timestampMs, double rpm, double fuelFlow);
+    void applyStatistics(int row);
+    void applyAllStatistics();
+    void resetStatistics();
+    void rebuildStatistics();
+    void replayHistory(qint64 fromSample);
+    void replayTo(qint64 sample);
+    void advanceReplay();
+    qint64 loadCheckpoint(const QString &path);
+
+    static constexpr quint32 CHECKPOINT_MAGIC = 0x4B435042; // "BPCK"
+    static constexpr quint32 CHECKPOINT_VERSION = 3;
+    static constexpr qint64 CHECKPOINT_INTERVAL = 30000;    // Samples between checkpoints
+
+    struct ReplayCheckpoint {
+        qint64 latestTimestamp;
+        QList<BinStatistics> statistics;
+    };
+
+    // Engine thread only
+    BinStore m_baseline;
+    std::array<BinStore, StatisticsWindowCount> m_bins;
+    std::array<DensityGrid, StatisticsWindowCount> m_density;  // Rows share the statistics' histograms
+    QList<BinStatistics> m_binStatistics;
+    qint64 m_latestTimestamp;               // Newest sample seen, the windows' "now"
+    bool m_expiryDue;                       // Windows have moved on since every bin was applied
+    QList<bool> m_changedRows;
+    bool m_hasChanges;
+    double m_lowerPercentile;
+    double m_upperPercentile;
+    SampleLog *m_sampleLog;
+    qint64 m_checkpointedSampleCount;
+    SampleLog *m_replayLog;
+    qint64 m_replayPosition;
+    QList<ReplayCheckpoint> m_replayCheckpoints;        // Every CHECKPOINT_INTERVAL samples
+    quint64 m_version;
+
+    // Shared with the reader
+    StatisticsSnapshot m_slots[2];
+    std::atomic<int> m_front;
+    std::atomic<bool> m_backFree;           // The reader has acquired the front slot
+    std::atomic<bool> m_publishPending;     // Changes wait for the back slot
+};
+
+#endif // STATISTICSENGINE_H
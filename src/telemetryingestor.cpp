@@ -0,0 +1,150 @@
+#include "telemetryingestor.h"
+#include "chartdatamodel.h"
+#include "telemetrysource.h"
+#include "metrics.h"
+#include <QGuiApplication>
+#include <QScreen>
+#include <QThread>
+#include <QDebug>
+
+TelemetryIngestor::TelemetryIngestor(ChartDataModel *model, QObject *parent)
+    : TelemetryIngestor(QList<ChartDataModel *>{ model }, parent)
+{
+}
+
+TelemetryIngestor::TelemetryIngestor(const QList<ChartDataModel *> &models, QObject *parent)
+    : QObject(parent)
+    , m_thread(nullptr)
+    , m_generation(0)
+    , m_stopRequested(false)
+    , m_droppedSamples(0)
+    , m_targetRpm(!models.isEmpty() && models.first() ? models.first()->currentRpm() : 0.0)
+{
+    for (ChartDataModel *model : models) {
+        m_models.append(model);
+        m_rings.push_back(std::make_unique<SpscRingBuffer<TelemetrySample>>(RING_CAPACITY));
+    }
+    m_drainBuffer.resize(m_rings.empty() ? 0 : m_rings.front()->capacity());
+
+    // Drain once per display frame
+    const QScreen *screen = QGuiApplication::primaryScreen();
+    const double refreshRate = screen && screen->refreshRate() > 0 ? screen->refreshRate() : 60.0;
+    m_drainTimer.setTimerType(Qt::PreciseTimer);
+    m_drainTimer.setInterval(qMax(1, qRound(1000.0 / refreshRate)));
+    connect(&m_drainTimer, &QTimer::timeout, this, &TelemetryIngestor::drain);
+}
+
+TelemetryIngestor::~TelemetryIngestor()
+{
+    stop();
+}
+
+void TelemetryIngestor::start(std::unique_ptr<TelemetrySource> source)
+{
+    stop();
+
+    m_source = std::move(source);
+    if (!m_source)
+        return;
+
+    m_source->setTargetRpm(m_targetRpm);
+    m_stopRequested.store(false);
+
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName(QStringLiteral("TelemetryIngestor"));
+    connect(m_thread, &QThread::finished, this, [this, generation = ++m_generation]() {
+        // A run that stop() ended may only get here after the next one has
+        // started, which must keep draining
+        if (generation != m_generation || !m_thread)
+            return;
+
+        // The source may have ended on its own; pick up what it left behind
+        m_drainTimer.stop();
+        drain();
+        emit runningChanged();
+    });
+
+    m_thread->start();
+    m_drainTimer.start();
+    emit runningChanged();
+}
+
+void TelemetryIngestor::stop()
+{
+    if (!m_thread)
+        return;
+
+    m_stopRequested.store(true);
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+    m_source.reset();
+
+    m_drainTimer.stop();
+    drain();
+    emit runningChanged();
+}
+
+bool TelemetryIngestor::isRunning() const
+{
+    return m_thread && m_thread->isRunning();
+}
+
+void TelemetryIngestor::setTargetRpm(double rpm)
+{
+    if (qFuzzyCompare(m_targetRpm, rpm))
+        return;
+
+    m_targetRpm = rpm;
+    if (m_source)
+        m_source->setTargetRpm(rpm);
+    emit targetRpmChanged();
+}
+
+void TelemetryIngestor::run()
+{
+    if (!m_source->open()) {
+        qWarning() << "TelemetryIngestor: could not open telemetry source";
+        return;
+    }
+
+    // A replay's statistics count the samples it delivers to find their
+    // place in the log, so a recorded source must not lose any
+    const bool recorded = m_source->isRecorded();
+
+    TelemetrySample samples[READ_BATCH];
+    while (!m_stopRequested.load(std::memory_order_relaxed)) {
+        const int count = m_source->read(samples, READ_BATCH, READ_TIMEOUT_MS);
+        if (count < 0)
+            break;
+
+        // Live samples never wait for the GUI: if the ring is full the
+        // newest ones go. Recorded ones wait until it has room again.
+        for (int i = 0; i < count; ++i) {
+            if (samples[i].engine < 0 || samples[i].engine >= int(m_rings.size()))
+                continue;
+            SpscRingBuffer<TelemetrySample> &ring = *m_rings[samples[i].engine];
+            while (!ring.push(samples[i])) {
+                if (!recorded) {
+                    m_droppedSamples.fetch_add(1, std::memory_order_relaxed);
+                    Metrics::add(Metrics::SamplesDropped);
+                    break;
+                }
+                if (m_stopRequested.load(std::memory_order_relaxed))
+                    break;
+                QThread::msleep(FULL_RING_WAIT_MS);
+            }
+        }
+    }
+
+    m_source->close();
+}
+
+void TelemetryIngestor::drain()
+{
+    for (std::size_t i = 0; i < m_rings.size(); ++i) {
+        const std::size_t count = m_rings[i]->pop(m_drainBuffer.data(), m_drainBuffer.size());
+        if (count > 0 && m_models.at(int(i)))
+            m_models.at(int(i))->ingestSamples(m_drainBuffer.data(), int(count));
+    }
+}
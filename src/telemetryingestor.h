@@ -0,0 +1,72 @@
+#ifndef TELEMETRYINGESTOR_H
+#define TELEMETRYINGESTOR_H
+
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "spscringbuffer.h"
+#include "telemetrysample.h"
+
+class QThread;
+class ChartDataModel;
+class TelemetrySource;
+
+// Reads a TelemetrySource on a worker thread and hands the samples to the
+// model. The worker only ever pushes into a lock-free ring; the GUI thread
+// drains it once per display frame, so neither side can block the other and
+// no queued signal is posted per sample. A source reading several engines,
+// such as one NMEA gateway, feeds one model per engine: each sample goes to
+// the ring of models[sample.engine].
+class TelemetryIngestor : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool running READ isRunning NOTIFY runningChanged)
+    Q_PROPERTY(double targetRpm READ targetRpm WRITE setTargetRpm NOTIFY targetRpmChanged)
+
+public:
+    explicit TelemetryIngestor(ChartDataModel *model, QObject *parent = nullptr);
+    explicit TelemetryIngestor(const QList<ChartDataModel *> &models, QObject *parent = nullptr);
+    ~TelemetryIngestor() override;
+
+    void start(std::unique_ptr<TelemetrySource> source);
+    void stop();
+
+    bool isRunning() const;
+    double targetRpm() const { return m_targetRpm; }
+    void setTargetRpm(double rpm);
+
+    // Samples of a live source lost because the GUI fell more than a full
+    // ring behind. Recorded sources wait instead, see
+    // TelemetrySource::isRecorded().
+    quint64 droppedSamples() const { return m_droppedSamples.load(std::memory_order_relaxed); }
+
+signals:
+    void runningChanged();
+    void targetRpmChanged();
+
+private:
+    void run();
+    void drain();
+
+    static constexpr int RING_CAPACITY = 4096;
+    static constexpr int READ_BATCH = 64;
+    static constexpr int READ_TIMEOUT_MS = 50;
+    static constexpr int FULL_RING_WAIT_MS = 2;
+
+    QList<QPointer<ChartDataModel>> m_models;
+    std::unique_ptr<TelemetrySource> m_source;
+    QThread *m_thread;
+    quint64 m_generation;               // Counts start() calls, to tell the runs' finished signals apart
+    QTimer m_drainTimer;
+    std::vector<std::unique_ptr<SpscRingBuffer<TelemetrySample>>> m_rings;    // One per model
+    std::vector<TelemetrySample> m_drainBuffer;
+    std::atomic<bool> m_stopRequested;
+    std::atomic<quint64> m_droppedSamples;
+    double m_targetRpm;
+};
+
+#endif // TELEMETRYINGESTOR_H
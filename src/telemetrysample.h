@@ -0,0 +1,16 @@
+#ifndef TELEMETRYSAMPLE_H
+#define TELEMETRYSAMPLE_H
+
+#include <QtGlobal>
+#include <limits>
+
+// One engine reading as delivered by a telemetry source
+struct TelemetrySample {
+    qint64 timestampMs;     // Milliseconds since the Unix epoch
+    double rpm;
+    double fuelFlow;        // L/h
+    double speed = std::numeric_limits<double>::quiet_NaN();   // Knots over ground, NaN when not measured
+    int engine = 0;         // Which of the engines a source reads, see TelemetryIngestor
+};
+
+#endif // TELEMETRYSAMPLE_H
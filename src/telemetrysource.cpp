@@ -0,0 +1,284 @@
+#include "telemetrysource.h"
+#include "metrics.h"
+#include <QDateTime>
+#include <QHostAddress>
+#include <QTcpSocket>
+#include <QThread>
+#include <QUdpSocket>
+#include <cmath>
+
+SimulatedTelemetrySource::SimulatedTelemetrySource(const SimulationProfile &profile, quint64 seed, double speed)
+    : m_profile(profile)
+    , m_seed(seed)
+    , m_speed(qMax(0.0, speed))
+    , m_targetRpm(1500.0)
+{
+}
+
+bool SimulatedTelemetrySource::open()
+{
+    // Live samples are stamped from now on, unless the profile fixes a start
+    SimulationProfile profile = m_profile;
+    if (profile.startTimestampMs == 0)
+        profile.startTimestampMs = QDateTime::currentMSecsSinceEpoch();
+
+    m_simulator = EngineSimulator(m_seed, profile);
+    m_clock.start();
+    return true;
+}
+
+int SimulatedTelemetrySource::read(TelemetrySample *out, int maxCount, int timeoutMs)
+{
+    // Scripted drives ignore the throttle
+    if (!(m_profile.meanLegSeconds > 0.0))
+        m_simulator.setTargetRpm(m_targetRpm.load(std::memory_order_relaxed));
+
+    // Unthrottled: as fast as the reader keeps up
+    if (m_speed == 0.0)
+        return m_simulator.generate(out, maxCount);
+
+    // Simulated time runs speed times as fast as the wall clock
+    auto simulatedNow = [this]() {
+        return m_simulator.profile().startTimestampMs + qint64(m_clock.elapsed() * m_speed);
+    };
+    const qint64 wait = qint64(std::ceil((m_simulator.timestampMs() - simulatedNow()) / m_speed));
+    if (wait > timeoutMs) {
+        QThread::msleep(timeoutMs);
+        return 0;
+    }
+    if (wait > 0)
+        QThread::msleep(wait);
+
+    // Emit every sample that is due, so a late wake-up still keeps the rate
+    const qint64 due = simulatedNow();
+    int count = 0;
+    while (count < maxCount && m_simulator.timestampMs() <= due)
+        count += m_simulator.generate(out + count, 1);
+    return count;
+}
+
+void SimulatedTelemetrySource::setTargetRpm(double rpm)
+{
+    m_targetRpm.store(rpm, std::memory_order_relaxed);
+}
+
+void PlaybackClock::seek(qint64 timestampMs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_originMs = timestampMs;
+    m_timer.start();
+}
+
+void PlaybackClock::play()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_playing)
+        return;
+    m_playing = true;
+    m_timer.start();
+}
+
+void PlaybackClock::pause()
+{
+    QMutexLocker locker(&m_mutex);
+    m_originMs = nowLocked();
+    m_playing = false;
+}
+
+void PlaybackClock::setSpeed(double speed)
+{
+    // Rebased, so the trip time does not jump
+    QMutexLocker locker(&m_mutex);
+    m_originMs = nowLocked();
+    m_timer.start();
+    m_speed = speed;
+}
+
+qint64 PlaybackClock::now() const
+{
+    QMutexLocker locker(&m_mutex);
+    return nowLocked();
+}
+
+double PlaybackClock::speed() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_speed;
+}
+
+bool PlaybackClock::isPlaying() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_playing;
+}
+
+qint64 PlaybackClock::nowLocked() const
+{
+    if (!m_playing || !m_timer.isValid())
+        return m_originMs;
+    return m_originMs + qint64(m_timer.elapsed() * m_speed);
+}
+
+ReplayTelemetrySource::ReplayTelemetrySource(const QString &directory, qint64 fromSample,
+                                             std::shared_ptr<const PlaybackClock> clock)
+    : m_log(directory)
+    , m_clock(std::move(clock))
+    , m_nextSample(fromSample)
+    , m_bufferPosition(0)
+{
+}
+
+bool ReplayTelemetrySource::open()
+{
+    return m_log.open(SampleLog::ReadOnly);
+}
+
+void ReplayTelemetrySource::close()
+{
+    m_log.close();
+}
+
+int ReplayTelemetrySource::read(TelemetrySample *out, int maxCount, int timeoutMs)
+{
+    if (m_bufferPosition == m_buffer.size() && !fill())
+        return -1;
+
+    // Wait for the next sample in trip time, but never longer than asked
+    const qint64 lead = m_buffer[m_bufferPosition].timestampMs - m_clock->now();
+    if (lead > 0) {
+        const double speed = m_clock->speed();
+        const qint64 wait = m_clock->isPlaying() && speed > 0.0
+            ? qint64(std::ceil(lead / speed)) : timeoutMs;
+        QThread::msleep(qMin<qint64>(wait, timeoutMs));
+    }
+
+    const qint64 due = m_clock->now();
+    int count = 0;
+    while (count < maxCount && m_buffer[m_bufferPosition].timestampMs <= due) {
+        out[count++] = m_buffer[m_bufferPosition++];
+        if (m_bufferPosition == m_buffer.size() && !fill())
+            break;
+    }
+    return count;
+}
+
+bool ReplayTelemetrySource::fill()
+{
+    m_buffer.clear();
+    m_bufferPosition = 0;
+    m_log.scan(m_nextSample, m_nextSample + SampleLog::BLOCK_SAMPLES, SampleLog::AllFields,
+               [this](const SampleLog::Columns &chunk) {
+        for (qint64 i = 0; i < chunk.count; ++i)
+            m_buffer.push_back({ chunk.timestamps[i], chunk.rpm[i], chunk.fuelFlow[i] });
+    });
+    m_nextSample += qint64(m_buffer.size());
+    return !m_buffer.empty();
+}
+
+NmeaTelemetrySource::NmeaTelemetrySource(const QUrl &address, int firstInstance, int engineCount)
+    : m_address(address)
+    , m_parser(firstInstance, engineCount)
+    , m_bufferPosition(0)
+    , m_receivedMs(0)
+    , m_rejectedLines(0)
+{
+}
+
+NmeaTelemetrySource::~NmeaTelemetrySource() = default;
+
+bool NmeaTelemetrySource::open()
+{
+    const quint16 port = quint16(m_address.port(NmeaParser::DEFAULT_PORT));
+    if (m_address.scheme() == QLatin1String("udp")) {
+        const QHostAddress host = m_address.host().isEmpty()
+            ? QHostAddress(QHostAddress::AnyIPv4) : QHostAddress(m_address.host());
+        m_udpSocket = std::make_unique<QUdpSocket>();
+        if (!m_udpSocket->bind(host, port, QAbstractSocket::ShareAddress | QAbstractSocket::ReuseAddressHint)) {
+            m_udpSocket.reset();
+            return false;
+        }
+        return true;
+    }
+
+    if (m_address.scheme() == QLatin1String("tcp")) {
+        m_tcpSocket = std::make_unique<QTcpSocket>();
+        m_tcpSocket->connectToHost(m_address.host(), port);
+        if (!m_tcpSocket->waitForConnected(CONNECT_TIMEOUT_MS)) {
+            m_tcpSocket.reset();
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+void NmeaTelemetrySource::close()
+{
+    m_udpSocket.reset();
+    m_tcpSocket.reset();
+}
+
+int NmeaTelemetrySource::read(TelemetrySample *out, int maxCount, int timeoutMs)
+{
+    // Lines left over when out last filled up come first
+    const int buffered = parseBuffered(out, maxCount);
+    if (buffered > 0)
+        return buffered;
+
+    if (!receive(timeoutMs))
+        return m_tcpSocket && m_tcpSocket->state() != QAbstractSocket::ConnectedState ? -1 : 0;
+    return parseBuffered(out, maxCount);
+}
+
+int NmeaTelemetrySource::parseBuffered(TelemetrySample *out, int maxCount)
+{
+    const NmeaParser::Result result = m_parser.parse(m_buffer.constData() + m_bufferPosition,
+                                                     m_buffer.size() - m_bufferPosition,
+                                                     m_receivedMs, out, maxCount);
+    m_bufferPosition += result.consumed;
+
+    const qint64 rejectedLines = m_parser.rejectedLines();
+    if (rejectedLines != m_rejectedLines) {
+        Metrics::add(Metrics::NmeaLinesRejected, rejectedLines - m_rejectedLines);
+        m_rejectedLines = rejectedLines;
+    }
+    return result.samples;
+}
+
+bool NmeaTelemetrySource::receive(int timeoutMs)
+{
+    // Only a partial line is ever carried over, so compacting is cheap and
+    // the buffer soon stops growing
+    if (m_bufferPosition > 0) {
+        m_buffer.remove(0, m_bufferPosition);
+        m_bufferPosition = 0;
+    }
+    const qsizetype carried = m_buffer.size();
+
+    if (m_udpSocket) {
+        if (!m_udpSocket->hasPendingDatagrams() && !m_udpSocket->waitForReadyRead(timeoutMs))
+            return false;
+        while (m_udpSocket->hasPendingDatagrams()) {
+            const qint64 size = qMax<qint64>(0, m_udpSocket->pendingDatagramSize());
+            const qsizetype end = m_buffer.size();
+            m_buffer.resize(end + size);
+            const qint64 read = m_udpSocket->readDatagram(m_buffer.data() + end, size);
+            m_buffer.resize(end + qMax<qint64>(0, read));
+
+            // Datagrams carry whole lines, never one continued in the next
+            if (read > 0 && !m_buffer.endsWith('\n'))
+                m_buffer += '\n';
+        }
+    } else if (m_tcpSocket) {
+        if (m_tcpSocket->bytesAvailable() == 0 && !m_tcpSocket->waitForReadyRead(timeoutMs))
+            return false;
+        const qint64 available = m_tcpSocket->bytesAvailable();
+        const qsizetype end = m_buffer.size();
+        m_buffer.resize(end + available);
+        const qint64 read = m_tcpSocket->read(m_buffer.data() + end, available);
+        m_buffer.resize(end + qMax<qint64>(0, read));
+    }
+
+    m_receivedMs = QDateTime::currentMSecsSinceEpoch();
+    return m_buffer.size() > carried;
+}
@@ -0,0 +1,150 @@
+#ifndef TELEMETRYSOURCE_H
+#define TELEMETRYSOURCE_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QRandomGenerator>
+#include <QString>
+#include <QUrl>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "enginesimulator.h"
+#include "nmeaparser.h"
+#include "samplelog.h"
+#include "telemetrysample.h"
+
+class QTcpSocket;
+class QUdpSocket;
+
+// Producer of engine samples. All methods except setTargetRpm() are called
+// from the ingestion worker thread only.
+class TelemetrySource
+{
+public:
+    virtual ~TelemetrySource() = default;
+
+    virtual bool open() { return true; }
+    virtual void close() {}
+
+    // Waits up to timeoutMs for new samples and writes at most maxCount of
+    // them to out. Returns the number written, or -1 once the source has
+    // nothing more to deliver.
+    virtual int read(TelemetrySample *out, int maxCount, int timeoutMs) = 0;
+
+    // Recorded sources can simply be read later, so the ingestor waits for
+    // room in its ring rather than dropping their samples
+    virtual bool isRecorded() const { return false; }
+
+    // Throttle request from the UI, used by simulated engines. Must be
+    // thread-safe.
+    virtual void setTargetRpm(double rpm) { Q_UNUSED(rpm) }
+};
+
+// Feeds an EngineSimulator at speed times real time, or as fast as it is
+// read with a speed of 0. By default the engine follows the requested RPM
+// with some inertia and reports fuel flow with ±15% noise.
+class SimulatedTelemetrySource : public TelemetrySource
+{
+public:
+    explicit SimulatedTelemetrySource(const SimulationProfile &profile = SimulationProfile(),
+                                      quint64 seed = QRandomGenerator::global()->generate64(),
+                                      double speed = 1.0);
+
+    bool open() override;
+    int read(TelemetrySample *out, int maxCount, int timeoutMs) override;
+    void setTargetRpm(double rpm) override;
+
+private:
+    const SimulationProfile m_profile;
+    const quint64 m_seed;
+    const double m_speed;
+    EngineSimulator m_simulator;
+    QElapsedTimer m_clock;
+    std::atomic<double> m_targetRpm;
+};
+
+// Trip time of a replay, running speed times as fast as the wall clock
+// while playing. One clock is shared by the sources of all engines, so they
+// stay in step through pauses and speed changes. Thread-safe.
+class PlaybackClock
+{
+public:
+    // Jumps to timestampMs, keeping the playing state and speed
+    void seek(qint64 timestampMs);
+    void play();
+    void pause();
+    void setSpeed(double speed);
+
+    qint64 now() const;
+    double speed() const;
+    bool isPlaying() const;
+
+private:
+    qint64 nowLocked() const;
+
+    mutable QMutex m_mutex;
+    QElapsedTimer m_timer;      // Wall time since m_originMs
+    qint64 m_originMs = 0;
+    double m_speed = 1.0;
+    bool m_playing = false;
+};
+
+// Plays a recorded SampleLog back from fromSample, releasing every sample
+// once the shared clock has reached its timestamp. The log is opened
+// read-only, so it can be shared with other readers. Ends with the log.
+class ReplayTelemetrySource : public TelemetrySource
+{
+public:
+    ReplayTelemetrySource(const QString &directory, qint64 fromSample,
+                          std::shared_ptr<const PlaybackClock> clock);
+
+    bool open() override;
+    void close() override;
+    int read(TelemetrySample *out, int maxCount, int timeoutMs) override;
+    bool isRecorded() const override { return true; }
+
+private:
+    bool fill();
+
+    SampleLog m_log;
+    const std::shared_ptr<const PlaybackClock> m_clock;
+    qint64 m_nextSample;
+    std::vector<TelemetrySample> m_buffer;  // Read ahead, one block at a time
+    std::size_t m_bufferPosition;
+};
+
+// Reads engine instances firstInstance to firstInstance + engineCount - 1
+// off an engine gateway streaming NMEA, see NmeaParser: udp://[host]:port
+// binds to the port, tcp://host:port connects to the gateway. One source
+// reads every engine of a gateway, as only one socket bound to a UDP port
+// gets its unicast datagrams; TelemetryIngestor fans the samples out by
+// TelemetrySample::engine. Samples are stamped with the time they were
+// received. A TCP source ends when the gateway disconnects.
+class NmeaTelemetrySource : public TelemetrySource
+{
+public:
+    NmeaTelemetrySource(const QUrl &address, int firstInstance, int engineCount = 1);
+    ~NmeaTelemetrySource() override;
+
+    bool open() override;
+    void close() override;
+    int read(TelemetrySample *out, int maxCount, int timeoutMs) override;
+
+private:
+    int parseBuffered(TelemetrySample *out, int maxCount);
+    bool receive(int timeoutMs);
+
+    static constexpr int CONNECT_TIMEOUT_MS = 5000;
+
+    const QUrl m_address;
+    NmeaParser m_parser;
+    std::unique_ptr<QUdpSocket> m_udpSocket;    // Created on the worker thread
+    std::unique_ptr<QTcpSocket> m_tcpSocket;
+    QByteArray m_buffer;                        // Received, not yet parsed from m_bufferPosition
+    qsizetype m_bufferPosition;
+    qint64 m_receivedMs;
+    qint64 m_rejectedLines;
+};
+
+#endif // TELEMETRYSOURCE_H
@@ -0,0 +1,143 @@
+#include "tripreplay.h"
+#include "chartdatamodel.h"
+#include "samplelog.h"
+#include "telemetryingestor.h"
+#include "telemetrysource.h"
+#include "vesselmodel.h"
+#include <QDebug>
+
+TripReplay::TripReplay(VesselModel *vessel, const QStringList &directories, QObject *parent)
+    : QObject(parent)
+    , m_clock(std::make_shared<PlaybackClock>())
+    , m_startTime(0)
+    , m_endTime(0)
+    , m_stopping(false)
+{
+    // The trip spans every engine's recording
+    qint64 startTime = -1;
+    qint64 endTime = -1;
+    for (int i = 0; i < vessel->engineCount() && i < directories.size(); ++i) {
+        Track track;
+        track.model = vessel->engine(i);
+        track.directory = directories.at(i);
+        track.index = std::make_unique<SampleLog>(track.directory);
+        if (!track.index->open(SampleLog::ReadOnly) || track.index->sampleCount() == 0) {
+            qWarning() << "TripReplay: nothing recorded in" << track.directory;
+            continue;
+        }
+
+        const qint64 first = track.index->timestampAt(0);
+        const qint64 last = track.index->timestampAt(track.index->sampleCount() - 1);
+        startTime = startTime < 0 ? first : qMin(startTime, first);
+        endTime = qMax(endTime, last);
+
+        track.ingestor = std::make_unique<TelemetryIngestor>(track.model);
+        connect(track.ingestor.get(), &TelemetryIngestor::runningChanged, this, &TripReplay::checkFinished);
+        m_tracks.push_back(std::move(track));
+    }
+    m_startTime = qMax<qint64>(0, startTime);
+    m_endTime = qMax(m_startTime, endTime);
+
+    m_positionTimer.setInterval(100);
+    connect(&m_positionTimer, &QTimer::timeout, this, &TripReplay::positionChanged);
+
+    m_clock->seek(m_startTime);
+    restart();
+}
+
+TripReplay::~TripReplay()
+{
+    // Stopping the ingestors here does not end the trip
+    m_stopping = true;
+    m_tracks.clear();
+}
+
+double TripReplay::position() const
+{
+    return double(qBound(m_startTime, m_clock->now(), m_endTime));
+}
+
+double TripReplay::speed() const
+{
+    return m_clock->speed();
+}
+
+void TripReplay::setSpeed(double speed)
+{
+    speed = qBound(MIN_SPEED, speed, MAX_SPEED);
+    if (qFuzzyCompare(m_clock->speed(), speed))
+        return;
+
+    m_clock->setSpeed(speed);
+    emit speedChanged();
+}
+
+bool TripReplay::isPlaying() const
+{
+    return m_clock->isPlaying();
+}
+
+void TripReplay::play()
+{
+    if (isPlaying())
+        return;
+
+    // Playing a finished trip starts it over
+    if (m_clock->now() >= m_endTime)
+        seek(double(m_startTime));
+
+    m_clock->play();
+    m_positionTimer.start();
+    emit playingChanged();
+}
+
+void TripReplay::pause()
+{
+    if (!isPlaying())
+        return;
+
+    m_clock->pause();
+    m_positionTimer.stop();
+    emit playingChanged();
+    emit positionChanged();
+}
+
+void TripReplay::seek(double timestampMs)
+{
+    m_stopping = true;
+    for (Track &track : m_tracks)
+        track.ingestor->stop();
+
+    m_clock->seek(qBound(m_startTime, qint64(timestampMs), m_endTime));
+    restart();
+    m_stopping = false;
+    emit positionChanged();
+}
+
+void TripReplay::restart()
+{
+    // The ingestors are stopped and drained, so each seek is queued behind
+    // the last sample played before it
+    const qint64 timestamp = m_clock->now();
+    for (Track &track : m_tracks) {
+        const qint64 sample = track.index->findTimestamp(timestamp);
+        if (track.model)
+            track.model->seekReplay(sample);
+        track.ingestor->start(std::make_unique<ReplayTelemetrySource>(track.directory, sample, m_clock));
+    }
+}
+
+void TripReplay::checkFinished()
+{
+    if (m_stopping)
+        return;
+
+    for (const Track &track : m_tracks) {
+        if (track.ingestor->isRunning())
+            return;
+    }
+
+    // Every recording has played to its end
+    m_clock->seek(m_endTime);
+    pause();
+}
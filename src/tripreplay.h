@@ -0,0 +1,78 @@
+#ifndef TRIPREPLAY_H
+#define TRIPREPLAY_H
+
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QTimer>
+#include <memory>
+#include <vector>
+
+class ChartDataModel;
+class PlaybackClock;
+class SampleLog;
+class TelemetryIngestor;
+class VesselModel;
+
+// Plays a recorded trip back through the vessel's models at 1x to 100x.
+// Each engine's log is read by a ReplayTelemetrySource on its own ingestor,
+// all paced by one PlaybackClock. Seeking looks the timestamp up in every
+// log's block index and moves the statistics there, see
+// ChartDataModel::seekReplay(); the models must already be attached to
+// their logs with attachReplay().
+class TripReplay : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(double startTime READ startTime CONSTANT)
+    Q_PROPERTY(double endTime READ endTime CONSTANT)
+    Q_PROPERTY(double position READ position NOTIFY positionChanged)
+    Q_PROPERTY(double speed READ speed WRITE setSpeed NOTIFY speedChanged)
+    Q_PROPERTY(bool playing READ isPlaying NOTIFY playingChanged)
+
+public:
+    static constexpr double MIN_SPEED = 1.0;
+    static constexpr double MAX_SPEED = 100.0;
+
+    // directories[i] holds the recording of engine i. Starts paused at the
+    // beginning of the trip.
+    TripReplay(VesselModel *vessel, const QStringList &directories, QObject *parent = nullptr);
+    ~TripReplay() override;
+
+    // Trip times in milliseconds since the Unix epoch
+    double startTime() const { return double(m_startTime); }
+    double endTime() const { return double(m_endTime); }
+    double position() const;
+
+    double speed() const;
+    void setSpeed(double speed);
+    bool isPlaying() const;
+
+    Q_INVOKABLE void play();
+    Q_INVOKABLE void pause();
+    Q_INVOKABLE void seek(double timestampMs);
+
+signals:
+    void positionChanged();
+    void speedChanged();
+    void playingChanged();
+
+private:
+    struct Track {
+        QPointer<ChartDataModel> model;
+        QString directory;
+        std::unique_ptr<SampleLog> index;   // Read-only, for timestamp lookups
+        std::unique_ptr<TelemetryIngestor> ingestor;
+    };
+
+    void restart();
+    void checkFinished();
+
+    std::vector<Track> m_tracks;
+    std::shared_ptr<PlaybackClock> m_clock;
+    QTimer m_positionTimer;
+    qint64 m_startTime;
+    qint64 m_endTime;
+    bool m_stopping;                    // Ingestors are stopped on purpose
+};
+
+#endif // TRIPREPLAY_H
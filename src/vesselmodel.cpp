@@ -0,0 +1,247 @@
+#include "vesselmodel.h"
+#include "bininterpolator.h"
+#include "chartdatamodel.h"
+
+VesselModel::VesselModel(int engineCount, QObject *parent)
+    : QObject(parent)
+    , m_totalDataVersion(0)
+    , m_totalRpm(0.0)
+    , m_totalFuelFlow(0.0)
+    , m_isTotalEcoMode(false)
+    , m_totalSpeed(0.0)
+    , m_remainingFuel(0.0)
+    , m_fuelPerNauticalMile(0.0)
+    , m_optimalRow(-1)
+    , m_optimalFuelPerNauticalMile(0.0)
+{
+    for (int i = 0; i < qMax(1, engineCount); ++i) {
+        auto *engine = new ChartDataModel(this);
+        m_engines.append(engine);
+
+        connect(engine, &QAbstractItemModel::modelReset, this, &VesselModel::rebuildTotal);
+        connect(engine, &QAbstractItemModel::dataChanged, this,
+                [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+            updateTotal(topLeft.row(), bottomRight.row());
+        });
+        connect(engine, &ChartDataModel::densityChanged, this, &VesselModel::updateTotalDensity);
+        connect(engine, &ChartDataModel::currentRpmChanged, this, &VesselModel::updateTotalLiveState);
+        connect(engine, &ChartDataModel::currentFuelFlowChanged, this, &VesselModel::updateTotalLiveState);
+        connect(engine, &ChartDataModel::currentSpeedChanged, this, &VesselModel::updateTotalLiveState);
+    }
+
+    rebuildTotal();
+}
+
+ChartDataModel *VesselModel::engine(int index) const
+{
+    return index >= 0 && index < m_engines.size() ? m_engines.at(index) : nullptr;
+}
+
+bool VesselModel::enginesShareLayout() const
+{
+    const BinStore first = m_engines.first()->bins();
+    for (const ChartDataModel *engine : m_engines) {
+        const BinStore bins = engine->bins();
+        if (bins.layout != first.layout || bins.size() != first.size())
+            return false;
+    }
+    return !first.isEmpty();
+}
+
+void VesselModel::rebuildTotal()
+{
+    // Engines are reset one after another, so the total stays empty until
+    // they agree on a layout again
+    m_total = BinStore();
+    m_totalDensity = DensityGrid();
+    if (enginesShareLayout()) {
+        m_total.reset(m_engines.first()->bins().layout);
+        sumRows(0, m_total.size() - 1);
+        m_totalDensity.reset(m_total.layout);
+        sumDensityRows(0, m_totalDensity.size() - 1);
+
+        // Speeds were measured against the old bins
+        if (m_cruise.layout() != m_total.layout)
+            m_cruise.reset(m_total.layout);
+        updateCruiseFuelFlow(0, m_total.size() - 1);
+    }
+
+    ++m_totalDataVersion;
+    emit totalReset();
+    updateTotalLiveState();
+}
+
+void VesselModel::updateTotal(int firstRow, int lastRow)
+{
+    // A layout change that kept the bin count arrives as a data change
+    const bool shared = enginesShareLayout();
+    if (!shared || m_total.layout != m_engines.first()->bins().layout
+        || m_total.size() != m_engines.first()->rowCount()) {
+        if (shared || !m_total.isEmpty())
+            rebuildTotal();
+        return;
+    }
+
+    firstRow = qMax(0, firstRow);
+    lastRow = qMin(m_total.size() - 1, lastRow);
+    if (lastRow < firstRow)
+        return;
+
+    sumRows(firstRow, lastRow);
+    updateCruiseFuelFlow(firstRow, lastRow);
+    ++m_totalDataVersion;
+    emit totalBinsChanged(firstRow, lastRow);
+
+    // New medians can change the verdict and the economy of a reading that
+    // stands still, e.g. after a window switch or with a replay paused
+    updateTotalLiveState();
+}
+
+void VesselModel::sumRows(int firstRow, int lastRow)
+{
+    for (int row = firstRow; row <= lastRow; ++row) {
+        m_total.minFuelFlow[row] = 0.0;
+        m_total.maxFuelFlow[row] = 0.0;
+        m_total.medianFuelFlow[row] = 0.0;
+        m_total.currentFuelFlow[row] = 0.0;
+    }
+
+    for (const ChartDataModel *engine : std::as_const(m_engines)) {
+        const BinStore bins = engine->bins();
+        for (int row = firstRow; row <= lastRow; ++row) {
+            m_total.minFuelFlow[row] += bins.minFuelFlow.at(row);
+            m_total.maxFuelFlow[row] += bins.maxFuelFlow.at(row);
+            m_total.medianFuelFlow[row] += bins.medianFuelFlow.at(row);
+            m_total.currentFuelFlow[row] += bins.currentFuelFlow.at(row);
+        }
+    }
+}
+
+void VesselModel::updateTotalDensity(int firstRow, int lastRow)
+{
+    // While the layouts differ the next rebuild sums everything anyway
+    if (m_totalDensity.isEmpty())
+        return;
+
+    firstRow = qMax(0, firstRow);
+    lastRow = qMin(m_totalDensity.size() - 1, lastRow);
+    if (lastRow < firstRow)
+        return;
+
+    sumDensityRows(firstRow, lastRow);
+    emit totalDensityChanged(firstRow, lastRow);
+}
+
+void VesselModel::sumDensityRows(int firstRow, int lastRow)
+{
+    for (int row = firstRow; row <= lastRow; ++row)
+        m_totalDensity.rows[row].clear();
+
+    // Rows stay empty until an engine has samples in them, as in every grid
+    for (const ChartDataModel *engine : std::as_const(m_engines)) {
+        const DensityGrid density = engine->density();
+        if (density.layout != m_totalDensity.layout || density.size() != m_totalDensity.size())
+            continue;
+
+        for (int row = firstRow; row <= lastRow; ++row) {
+            const QList<quint32> &counts = density.rows.at(row);
+            if (counts.size() != DensityGrid::BUCKETS)
+                continue;
+
+            QList<quint32> &total = m_totalDensity.rows[row];
+            if (total.isEmpty())
+                total.fill(0, DensityGrid::BUCKETS);
+            for (int bucket = 0; bucket < DensityGrid::BUCKETS; ++bucket)
+                total[bucket] += counts.at(bucket);
+        }
+    }
+}
+
+void VesselModel::updateTotalLiveState()
+{
+    double rpm = 0.0;
+    double fuelFlow = 0.0;
+    double speed = 0.0;
+    for (const ChartDataModel *engine : std::as_const(m_engines)) {
+        rpm += engine->currentRpm();
+        fuelFlow += engine->currentFuelFlow();
+        speed += engine->currentSpeed();
+    }
+    rpm /= m_engines.size();
+    speed /= m_engines.size();
+
+    // The engines' readings arrive one by one, so the vessel's speed counts
+    // once per change rather than once per sample
+    if (!m_total.isEmpty() && (!qFuzzyCompare(m_totalRpm, rpm) || !qFuzzyCompare(m_totalSpeed, speed)))
+        m_cruise.addSpeed(rpm, speed);
+    m_totalSpeed = speed;
+
+    // Same classification as a single engine, against the summed medians
+    const double median = BinInterpolator(m_total.layout, m_total.medianFuelFlow).value(rpm);
+    const bool isEco = !m_total.isEmpty() && fuelFlow < median;
+
+    if (!qFuzzyCompare(m_totalRpm, rpm) || !qFuzzyCompare(m_totalFuelFlow, fuelFlow)
+        || m_isTotalEcoMode != isEco) {
+        m_totalRpm = rpm;
+        m_totalFuelFlow = fuelFlow;
+        m_isTotalEcoMode = isEco;
+        emit totalLiveStateChanged();
+    }
+    updateEconomy();
+}
+
+void VesselModel::setRemainingFuel(double litres)
+{
+    litres = qMax(0.0, litres);
+    if (qFuzzyCompare(m_remainingFuel, litres))
+        return;
+
+    m_remainingFuel = litres;
+    for (ChartDataModel *engine : std::as_const(m_engines))
+        engine->setRemainingFuel(litres / m_engines.size());
+    emit remainingFuelChanged();
+    emit economyChanged();
+}
+
+double VesselModel::range() const
+{
+    return m_fuelPerNauticalMile > 0.0 ? m_remainingFuel / m_fuelPerNauticalMile : 0.0;
+}
+
+double VesselModel::optimalRpm() const
+{
+    return m_optimalRow >= 0 ? m_total.rpm.at(m_optimalRow) : 0.0;
+}
+
+double VesselModel::optimalRange() const
+{
+    return m_optimalFuelPerNauticalMile > 0.0 ? m_remainingFuel / m_optimalFuelPerNauticalMile : 0.0;
+}
+
+void VesselModel::updateEconomy()
+{
+    const double fuelPerNauticalMile = m_totalSpeed >= CruiseEstimator::MIN_SPEED
+        ? m_totalFuelFlow / m_totalSpeed : 0.0;
+    const int optimalRow = m_total.isEmpty() ? -1 : m_cruise.optimalRow();
+    const double optimalFuelPerNauticalMile = optimalRow >= 0
+        ? m_cruise.fuelPerNauticalMile(optimalRow) : 0.0;
+
+    if (qFuzzyCompare(m_fuelPerNauticalMile, fuelPerNauticalMile) && m_optimalRow == optimalRow
+        && qFuzzyCompare(m_optimalFuelPerNauticalMile, optimalFuelPerNauticalMile)) {
+        return;
+    }
+
+    m_fuelPerNauticalMile = fuelPerNauticalMile;
+    m_optimalRow = optimalRow;
+    m_optimalFuelPerNauticalMile = optimalFuelPerNauticalMile;
+    emit economyChanged();
+}
+
+void VesselModel::updateCruiseFuelFlow(int firstRow, int lastRow)
+{
+    if (m_cruise.layout() != m_total.layout)
+        return;
+
+    for (int row = qMax(0, firstRow); row <= lastRow && row < m_total.size(); ++row)
+        m_cruise.setFuelFlow(row, m_total.medianFuelFlow.at(row));
+}
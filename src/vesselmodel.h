@@ -0,0 +1,97 @@
+#ifndef VESSELMODEL_H
+#define VESSELMODEL_H
+
+#include <QObject>
+#include <QList>
+#include "binstore.h"
+#include "cruiseestimator.h"
+
+class ChartDataModel;
+
+// The engines of one vessel, each a ChartDataModel with its own bins,
+// statistics and live reading, plus their combined total. The total sums
+// every bin's envelope, median and sample density over the engines, and its
+// live reading is the summed fuel flow at the engines' mean RPM and speed.
+class VesselModel : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int engineCount READ engineCount CONSTANT)
+    Q_PROPERTY(double totalRpm READ totalRpm NOTIFY totalLiveStateChanged)
+    Q_PROPERTY(double totalFuelFlow READ totalFuelFlow NOTIFY totalLiveStateChanged)
+    Q_PROPERTY(bool isTotalEcoMode READ isTotalEcoMode NOTIFY totalLiveStateChanged)
+    Q_PROPERTY(double remainingFuel READ remainingFuel WRITE setRemainingFuel NOTIFY remainingFuelChanged)
+    Q_PROPERTY(double fuelPerNauticalMile READ fuelPerNauticalMile NOTIFY economyChanged)
+    Q_PROPERTY(double range READ range NOTIFY economyChanged)
+    Q_PROPERTY(double optimalRpm READ optimalRpm NOTIFY economyChanged)
+    Q_PROPERTY(double optimalFuelPerNauticalMile READ optimalFuelPerNauticalMile NOTIFY economyChanged)
+    Q_PROPERTY(double optimalRange READ optimalRange NOTIFY economyChanged)
+
+public:
+    explicit VesselModel(int engineCount = 1, QObject *parent = nullptr);
+
+    int engineCount() const { return int(m_engines.size()); }
+    Q_INVOKABLE ChartDataModel *engine(int index) const;
+    const QList<ChartDataModel *> &engines() const { return m_engines; }
+
+    // Empty while the engines do not share one bin layout
+    BinStore totalBins() const { return m_total; }
+    quint64 totalDataVersion() const { return m_totalDataVersion; }
+
+    // Every engine's sample counts added up, each of its selected window.
+    // Empty together with totalBins().
+    DensityGrid totalDensity() const { return m_totalDensity; }
+
+    double totalRpm() const { return m_totalRpm; }
+    double totalFuelFlow() const { return m_totalFuelFlow; }
+    bool isTotalEcoMode() const { return m_isTotalEcoMode; }
+
+    // Litres left in the vessel's tank. Each engine is given an equal
+    // share for its own range.
+    double remainingFuel() const { return m_remainingFuel; }
+    void setRemainingFuel(double litres);
+
+    // The vessel's economy, as ChartDataModel's for one engine: the summed
+    // fuel flow over the speed made, now and at optimalRpm(), with the
+    // range on the whole tank. The bins' economy follows the summed
+    // medians. Each is 0 while unknown.
+    double fuelPerNauticalMile() const { return m_fuelPerNauticalMile; }
+    double range() const;
+    double optimalRpm() const;
+    double optimalFuelPerNauticalMile() const { return m_optimalFuelPerNauticalMile; }
+    double optimalRange() const;
+
+signals:
+    void totalReset();
+    void totalBinsChanged(int firstRow, int lastRow);
+    void totalDensityChanged(int firstRow, int lastRow);
+    void totalLiveStateChanged();
+    void remainingFuelChanged();
+    void economyChanged();
+
+private:
+    void rebuildTotal();
+    void updateTotal(int firstRow, int lastRow);
+    void sumRows(int firstRow, int lastRow);
+    void updateTotalDensity(int firstRow, int lastRow);
+    void sumDensityRows(int firstRow, int lastRow);
+    void updateTotalLiveState();
+    void updateEconomy();
+    void updateCruiseFuelFlow(int firstRow, int lastRow);
+    bool enginesShareLayout() const;
+
+    QList<ChartDataModel *> m_engines;
+    BinStore m_total;
+    DensityGrid m_totalDensity;
+    quint64 m_totalDataVersion;
+    double m_totalRpm;
+    double m_totalFuelFlow;
+    bool m_isTotalEcoMode;
+    double m_totalSpeed;
+    double m_remainingFuel;
+    CruiseEstimator m_cruise;               // Follows the summed medians
+    double m_fuelPerNauticalMile;
+    int m_optimalRow;
+    double m_optimalFuelPerNauticalMile;
+};
+
+#endif // VESSELMODEL_H
@@ -0,0 +1,97 @@
+#include "windowedquantiles.h"
+#include "histogramquantile.h"
+#include <QDataStream>
+
+WindowedQuantiles::WindowedQuantiles(qint64 windowMs, double minValue, double maxValue)
+    : m_slotMs(qMax<qint64>(1, windowMs / SLOTS))
+    , m_minValue(minValue)
+    , m_maxValue(qMax(maxValue, minValue + 1e-9))
+{
+    reset();
+}
+
+void WindowedQuantiles::add(qint64 timestampMs, double value)
+{
+    if (!qIsFinite(value))
+        return;
+
+    const qint64 slot = slotIndex(timestampMs);
+    if (m_newestSlot >= 0 && slot <= m_newestSlot - SLOTS)
+        return;
+    advance(timestampMs);
+
+    const int bucket = HistogramQuantile::bucket(value, m_minValue, m_maxValue, BUCKETS);
+    QList<quint32> &histogram = m_slots[slot % SLOTS];
+    if (histogram.isEmpty())
+        histogram.fill(0, BUCKETS);
+    if (m_total.isEmpty())
+        m_total.fill(0, BUCKETS);
+
+    ++histogram[bucket];
+    ++m_total[bucket];
+    ++m_count;
+}
+
+void WindowedQuantiles::advance(qint64 timestampMs)
+{
+    const qint64 slot = slotIndex(timestampMs);
+    if (slot <= m_newestSlot)
+        return;
+
+    // A gap longer than the window empties it in one go, so expiry never
+    // costs more than SLOTS steps
+    if (m_newestSlot >= 0 && slot - m_newestSlot < SLOTS) {
+        for (qint64 expired = m_newestSlot + 1; expired <= slot; ++expired)
+            expire(expired);
+    } else if (m_count > 0) {
+        reset();
+    }
+    m_newestSlot = slot;
+}
+
+void WindowedQuantiles::reset()
+{
+    m_newestSlot = -1;
+    m_count = 0;
+    m_total.clear();
+    m_slots = QList<QList<quint32>>(SLOTS);
+}
+
+double WindowedQuantiles::quantile(double probability) const
+{
+    return HistogramQuantile::quantile(m_total.constData(), BUCKETS, m_count, m_minValue, m_maxValue,
+                                       probability);
+}
+
+void WindowedQuantiles::expire(qint64 slot)
+{
+    // The ring entry still holds the slot that lies SLOTS before this one
+    QList<quint32> &histogram = m_slots[slot % SLOTS];
+    if (histogram.isEmpty())
+        return;
+
+    for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+        m_total[bucket] -= histogram.at(bucket);
+        m_count -= histogram.at(bucket);
+    }
+    histogram.clear();
+}
+
+QDataStream &operator<<(QDataStream &stream, const WindowedQuantiles &quantiles)
+{
+    return stream << quantiles.m_slotMs << quantiles.m_minValue << quantiles.m_maxValue
+                  << quantiles.m_newestSlot << quantiles.m_count << quantiles.m_total << quantiles.m_slots;
+}
+
+QDataStream &operator>>(QDataStream &stream, WindowedQuantiles &quantiles)
+{
+    stream >> quantiles.m_slotMs >> quantiles.m_minValue >> quantiles.m_maxValue
+           >> quantiles.m_newestSlot >> quantiles.m_count >> quantiles.m_total >> quantiles.m_slots;
+    bool valid = quantiles.m_slotMs > 0 && quantiles.m_slots.size() == WindowedQuantiles::SLOTS
+        && (quantiles.m_total.isEmpty() || quantiles.m_total.size() == WindowedQuantiles::BUCKETS);
+    for (const QList<quint32> &histogram : std::as_const(quantiles.m_slots))
+        valid = valid && (histogram.isEmpty() || histogram.size() == WindowedQuantiles::BUCKETS);
+    if (!valid)
+        stream.setStatus(QDataStream::ReadCorruptData);
+    return stream;
+}
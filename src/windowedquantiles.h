@@ -0,0 +1,60 @@
+#ifndef WINDOWEDQUANTILES_H
+#define WINDOWEDQUANTILES_H
+
+#include <QList>
+#include <QtGlobal>
+
+class QDataStream;
+
+// Quantiles of the values seen within a sliding time window, such as the
+// last hour. The window is split into SLOTS time slots, each a histogram of
+// BUCKETS buckets over [minValue, maxValue], and a running total holds their
+// sum. add() is O(1); as time moves on, whole slots expire by being
+// subtracted from the total, so expiry is O(1) amortized per sample and
+// memory stays fixed however many samples arrive. Slots stay unallocated
+// until they receive a sample.
+//
+// Quantiles come from the total as described in HistogramQuantile. The
+// window itself is exact to one slot.
+class WindowedQuantiles
+{
+public:
+    static constexpr int SLOTS = 24;
+    static constexpr int BUCKETS = 128;
+
+    explicit WindowedQuantiles(qint64 windowMs = 3600000, double minValue = 0.0, double maxValue = 100.0);
+
+    // Samples older than the window are ignored
+    void add(qint64 timestampMs, double value);
+
+    // Expires every slot that has left the window at timestampMs. Time
+    // never moves backwards.
+    void advance(qint64 timestampMs);
+    void reset();
+
+    qint64 windowMs() const { return m_slotMs * SLOTS; }
+    qint64 count() const { return m_count; }
+
+    // 0 when the window is empty
+    double quantile(double probability) const;
+
+    // Samples per bucket in the window; empty until the first sample
+    const QList<quint32> &histogram() const { return m_total; }
+
+    friend QDataStream &operator<<(QDataStream &stream, const WindowedQuantiles &quantiles);
+    friend QDataStream &operator>>(QDataStream &stream, WindowedQuantiles &quantiles);
+
+private:
+    qint64 slotIndex(qint64 timestampMs) const { return qMax<qint64>(0, timestampMs) / m_slotMs; }
+    void expire(qint64 slot);
+
+    qint64 m_slotMs;
+    double m_minValue;
+    double m_maxValue;
+    qint64 m_newestSlot;                // Slot index of the newest sample, -1 before the first
+    qint64 m_count;
+    QList<quint32> m_total;             // Sum of the slot histograms
+    QList<QList<quint32>> m_slots;      // Ring of histograms, by slot index modulo SLOTS
+};
+
+#endif // WINDOWEDQUANTILES_H
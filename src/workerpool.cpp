@@ -0,0 +1,30 @@
+#include "workerpool.h"
+#include <QThreadPool>
+#include <atomic>
+
+int WorkerPool::workerCount(int threadCount, int itemCount)
+{
+    return qBound(1, threadCount, qMax(1, itemCount));
+}
+
+void WorkerPool::run(int itemCount, int threadCount, const QString &name,
+                     const std::function<void(int worker, int item)> &work)
+{
+    std::atomic<int> nextItem { 0 };
+    auto drain = [&](int worker) {
+        for (int item = nextItem++; item < itemCount; item = nextItem++)
+            work(worker, item);
+    };
+
+    // A pool of its own, so the items never wait behind unrelated work in
+    // the global one
+    const int workers = workerCount(threadCount, itemCount);
+    QThreadPool pool;
+    pool.setObjectName(name);
+    pool.setMaxThreadCount(qMax(1, workers - 1));
+    for (int worker = 1; worker < workers; ++worker)
+        pool.start([&drain, worker]() { drain(worker); });
+
+    drain(0);
+    pool.waitForDone();
+}
@@ -0,0 +1,23 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <QString>
+#include <functional>
+
+// Spreads itemCount independent items over up to threadCount threads of a
+// QThreadPool, the calling thread being one of them. Each thread takes the
+// next item as soon as it is done with one, so uneven items still balance.
+// work(worker, item) learns which thread it runs on, 0 to
+// workerCount() - 1, so per-thread state needs no locking.
+class WorkerPool
+{
+public:
+    // Threads run() uses for itemCount items, at least 1
+    static int workerCount(int threadCount, int itemCount);
+
+    // Returns once every item is done
+    static void run(int itemCount, int threadCount, const QString &name,
+                    const std::function<void(int worker, int item)> &work);
+};
+
+#endif // WORKERPOOL_H
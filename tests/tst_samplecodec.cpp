@@ -0,0 +1,441 @@
+#include <QDir>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTest>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "samplecodec.h"
+#include "samplelog.h"
+
+class SampleCodecTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void skipsColumns();
+    void rejectsDamagedBlocks();
+    void throughput();
+    void logCompactsFullBlocks();
+    void logReopensAfterCrashDuringCompaction();
+    void logReopensAfterCrashDuringTailRewrite();
+    void logIgnoresTornWrites();
+};
+
+namespace {
+
+struct Trace {
+    std::vector<qint64> timestamps;
+    std::vector<double> rpm;
+    std::vector<double> fuelFlow;
+
+    int size() const { return int(timestamps.size()); }
+
+    void append(qint64 timestamp, double rpmValue, double fuelFlowValue)
+    {
+        timestamps.push_back(timestamp);
+        rpm.push_back(rpmValue);
+        fuelFlow.push_back(fuelFlowValue);
+    }
+
+    TelemetrySample sample(int i) const { return { timestamps[i], rpm[i], fuelFlow[i] }; }
+};
+
+// 50 Hz with jitter and slowly varying engine speed, as recorded
+Trace smoothTrace(int count, quint32 seed = 7)
+{
+    Trace trace;
+    QRandomGenerator generator(seed);
+    qint64 timestamp = 1700000000000;
+    double rpm = 1500.0;
+    for (int i = 0; i < count; ++i) {
+        timestamp += 20 + generator.bounded(3) - 1;
+        rpm += (generator.generateDouble() - 0.5) * 20.0;
+        trace.append(timestamp, rpm, rpm / 100.0 * (0.85 + generator.generateDouble() * 0.3));
+    }
+    return trace;
+}
+
+QByteArray encode(const Trace &trace, qint64 firstSample = 0)
+{
+    QByteArray block;
+    SampleCodec::encodeBlock(block, firstSample, trace.timestamps.data(), trace.rpm.data(),
+                             trace.fuelFlow.data(), trace.size());
+    return block;
+}
+
+const SampleCodec::BlockHeader *header(const QByteArray &block)
+{
+    return SampleCodec::blockHeader(reinterpret_cast<const uchar *>(block.constData()), block.size());
+}
+
+// Compares bit patterns, so that NaN payloads and the sign of zero count
+bool sameBits(const std::vector<double> &a, const std::vector<double> &b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0;
+}
+
+Trace readLog(SampleLog &log)
+{
+    Trace trace;
+    log.scan(0, SampleLog::AllFields, [&trace](const SampleLog::Columns &chunk) {
+        for (qint64 i = 0; i < chunk.count; ++i)
+            trace.append(chunk.timestamps[i], chunk.rpm[i], chunk.fuelFlow[i]);
+    });
+    return trace;
+}
+
+bool appendTrace(SampleLog &log, const Trace &trace, int from, int to)
+{
+    std::vector<TelemetrySample> samples;
+    for (int i = from; i < to; ++i)
+        samples.push_back(trace.sample(i));
+    return log.append(samples.data(), int(samples.size()));
+}
+
+bool appendRaw(const QString &path, const void *data, qint64 size)
+{
+    QFile file(path);
+    return file.open(QIODevice::Append) && file.write(static_cast<const char *>(data), size) == size;
+}
+
+} // namespace
+
+void SampleCodecTest::roundTrip_data()
+{
+    QTest::addColumn<int>("kind");
+    QTest::newRow("smooth") << 0;
+    QTest::newRow("single sample") << 1;
+    QTest::newRow("session gaps") << 2;
+    QTest::newRow("full-width xor") << 3;
+    QTest::newRow("non-finite") << 4;
+    QTest::newRow("random") << 5;
+}
+
+void SampleCodecTest::roundTrip()
+{
+    QFETCH(int, kind);
+
+    constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+    constexpr double infinity = std::numeric_limits<double>::infinity();
+
+    Trace trace;
+    switch (kind) {
+    case 0:
+        trace = smoothTrace(SampleLog::BLOCK_SAMPLES);
+        break;
+    case 1:
+        trace.append(1700000000000, 1500.0, 12.5);
+        break;
+    case 2:
+        // Days and years between sessions, and a clock set back, need the
+        // 64-bit delta-of-delta escape
+        trace.append(1700000000000, 800.0, 3.0);
+        trace.append(1700000000020, 800.0, 3.0);
+        trace.append(1700000000020 + 3 * 86400000LL, 810.0, 3.1);
+        trace.append(1700000000040 + 3 * 86400000LL, 810.0, 3.1);
+        trace.append(1700000000040 + 3 * 86400000LL + (qint64(1) << 40), 820.0, 3.2);
+        trace.append(1000, 830.0, 3.3);
+        trace.append(1020, 830.0, 3.3);
+        trace.append(std::numeric_limits<qint32>::max() * qint64(1000), 840.0, 3.4);
+        break;
+    case 3:
+        // Values differing in both the top and the bottom bit store all 64
+        // meaningful bits, which the 6-bit length field holds as 0
+        trace.append(0, 1.0, 1.0);
+        trace.append(1, -1.0 - std::numeric_limits<double>::epsilon(), -std::numeric_limits<double>::denorm_min());
+        trace.append(2, 1.0, 1.0);
+        trace.append(3, -std::numeric_limits<double>::max(), std::numeric_limits<double>::min());
+        trace.append(4, 0.0, -0.0);
+        break;
+    case 4:
+        trace.append(0, nan, 10.0);
+        trace.append(20, infinity, nan);
+        trace.append(40, -infinity, -nan);
+        trace.append(60, 1500.0, infinity);
+        trace.append(80, nan, nan);
+        break;
+    case 5: {
+        QRandomGenerator generator(11);
+        for (int i = 0; i < 1000; ++i) {
+            double rpm;
+            double fuelFlow;
+            const quint64 rpmBits = generator.generate64();
+            const quint64 fuelFlowBits = generator.generate64();
+            std::memcpy(&rpm, &rpmBits, sizeof(rpm));
+            std::memcpy(&fuelFlow, &fuelFlowBits, sizeof(fuelFlow));
+            trace.append(qint64(generator.generate64() >> 2), rpm, fuelFlow);
+        }
+        break;
+    }
+    }
+
+    const QByteArray block = encode(trace, 42);
+    QCOMPARE(block.size() % 8, 0);
+    const SampleCodec::BlockHeader *decodedHeader = header(block);
+    QVERIFY(decodedHeader);
+    QCOMPARE(decodedHeader->sampleCount, quint32(trace.size()));
+    QCOMPARE(decodedHeader->firstSample, qint64(42));
+    QCOMPARE(SampleCodec::blockSize(*decodedHeader), qint64(block.size()));
+
+    Trace decoded;
+    decoded.timestamps.resize(trace.size());
+    decoded.rpm.resize(trace.size());
+    decoded.fuelFlow.resize(trace.size());
+    SampleCodec::decodeBlock(decodedHeader, decoded.timestamps.data(), decoded.rpm.data(), decoded.fuelFlow.data());
+    QVERIFY(decoded.timestamps == trace.timestamps);
+    QVERIFY(sameBits(decoded.rpm, trace.rpm));
+    QVERIFY(sameBits(decoded.fuelFlow, trace.fuelFlow));
+}
+
+void SampleCodecTest::skipsColumns()
+{
+    const Trace trace = smoothTrace(1000);
+    const QByteArray block = encode(trace);
+
+    std::vector<double> fuelFlow(trace.size());
+    SampleCodec::decodeBlock(header(block), nullptr, nullptr, fuelFlow.data());
+    QVERIFY(sameBits(fuelFlow, trace.fuelFlow));
+
+    std::vector<double> rpm(trace.size());
+    SampleCodec::decodeBlock(header(block), nullptr, rpm.data(), nullptr);
+    QVERIFY(sameBits(rpm, trace.rpm));
+}
+
+void SampleCodecTest::rejectsDamagedBlocks()
+{
+    const QByteArray block = encode(smoothTrace(100));
+    QVERIFY(header(block));
+
+    // Torn anywhere, the block is not taken
+    QVERIFY(!header(block.left(block.size() - 8)));
+    QVERIFY(!header(block.left(int(sizeof(SampleCodec::BlockHeader)) - 1)));
+
+    QByteArray badMagic = block;
+    badMagic[0] = char(badMagic[0] ^ 0xff);
+    QVERIFY(!header(badMagic));
+
+    QByteArray empty = block;
+    std::memset(empty.data() + offsetof(SampleCodec::BlockHeader, sampleCount), 0, sizeof(quint32));
+    QVERIFY(!header(empty));
+}
+
+void SampleCodecTest::throughput()
+{
+    const Trace trace = smoothTrace(SampleLog::BLOCK_SAMPLES);
+    Trace decoded;
+    decoded.timestamps.resize(trace.size());
+    decoded.rpm.resize(trace.size());
+    decoded.fuelFlow.resize(trace.size());
+
+    // Even with noisy values a recorded trace takes less than the 24 raw
+    // bytes per sample
+    QByteArray block = encode(trace);
+    QVERIFY2(block.size() < trace.size() * 24, qPrintable(QString::number(block.size())));
+
+    QBENCHMARK {
+        block.clear();
+        SampleCodec::encodeBlock(block, 0, trace.timestamps.data(), trace.rpm.data(),
+                                 trace.fuelFlow.data(), trace.size());
+        SampleCodec::decodeBlock(header(block), decoded.timestamps.data(), decoded.rpm.data(),
+                                 decoded.fuelFlow.data());
+    }
+    QVERIFY(sameBits(decoded.rpm, trace.rpm));
+}
+
+void SampleCodecTest::logCompactsFullBlocks()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    const Trace trace = smoothTrace(2 * SampleLog::BLOCK_SAMPLES + 100);
+
+    {
+        SampleLog log(directory.path());
+        QVERIFY(log.open());
+
+        // One short of a block stays raw; the sample completing it is archived
+        QVERIFY(appendTrace(log, trace, 0, SampleLog::BLOCK_SAMPLES - 1));
+        QCOMPARE(log.blocks().size(), 0);
+        QVERIFY(appendTrace(log, trace, SampleLog::BLOCK_SAMPLES - 1, SampleLog::BLOCK_SAMPLES));
+        QCOMPARE(log.blocks().size(), 1);
+
+        QVERIFY(appendTrace(log, trace, SampleLog::BLOCK_SAMPLES, trace.size()));
+        QCOMPARE(log.blocks().size(), 2);
+        QCOMPARE(log.blocks().at(1).firstSample, qint64(SampleLog::BLOCK_SAMPLES));
+        QCOMPARE(log.sampleCount(), qint64(trace.size()));
+
+        const Trace read = readLog(log);
+        QVERIFY(read.timestamps == trace.timestamps);
+        QVERIFY(sameBits(read.rpm, trace.rpm));
+        QVERIFY(sameBits(read.fuelFlow, trace.fuelFlow));
+        QVERIFY(log.flush());
+    }
+
+    SampleLog log(directory.path());
+    QVERIFY(log.open(SampleLog::ReadOnly));
+    QCOMPARE(log.sampleCount(), qint64(trace.size()));
+    QCOMPARE(log.findTimestamp(trace.timestamps[5000]), qint64(5000));
+    QCOMPARE(log.timestampAt(trace.size() - 1), trace.timestamps.back());
+    QVERIFY(readLog(log).timestamps == trace.timestamps);
+}
+
+void SampleCodecTest::logReopensAfterCrashDuringCompaction()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    const QDir dir(directory.path());
+    const QStringList columns { "timestamps.col", "rpm.col", "fuelflow.col" };
+    const Trace trace = smoothTrace(SampleLog::BLOCK_SAMPLES + 3);
+
+    // The raw tail as it is just before compaction
+    {
+        SampleLog log(directory.path());
+        QVERIFY(log.open());
+        QVERIFY(appendTrace(log, trace, 0, SampleLog::BLOCK_SAMPLES - 1));
+        QVERIFY(log.flush());
+    }
+    for (const QString &column : columns)
+        QVERIFY(QFile::copy(dir.filePath(column), dir.filePath(column + ".saved")));
+
+    {
+        SampleLog log(directory.path());
+        QVERIFY(log.open());
+        QVERIFY(appendTrace(log, trace, SampleLog::BLOCK_SAMPLES - 1, trace.size()));
+        QCOMPARE(log.blocks().size(), 1);
+        QVERIFY(log.flush());
+    }
+
+    // Crash after the archive was written but before the tail gave its
+    // samples up: the tail still holds everything from sample 0
+    for (const QString &column : columns) {
+        QVERIFY(QFile::remove(dir.filePath(column)));
+        QVERIFY(QFile::rename(dir.filePath(column + ".saved"), dir.filePath(column)));
+    }
+    const int from = SampleLog::BLOCK_SAMPLES - 1;
+    const qint64 bytes = (trace.size() - from) * qint64(sizeof(double));
+    QVERIFY(appendRaw(dir.filePath("timestamps.col"), trace.timestamps.data() + from, bytes));
+    QVERIFY(appendRaw(dir.filePath("rpm.col"), trace.rpm.data() + from, bytes));
+    QVERIFY(appendRaw(dir.filePath("fuelflow.col"), trace.fuelFlow.data() + from, bytes));
+
+    // And part of a row that was being appended
+    const double partial = 1.0;
+    QVERIFY(appendRaw(dir.filePath("rpm.col"), &partial, sizeof(partial)));
+    QVERIFY(appendRaw(dir.filePath("fuelflow.col"), &partial, 4));
+
+    {
+        SampleLog log(directory.path());
+        QVERIFY(log.open());
+        QCOMPARE(log.blocks().size(), 1);
+        QCOMPARE(log.sampleCount(), qint64(trace.size()));
+        const Trace read = readLog(log);
+        QVERIFY(read.timestamps == trace.timestamps);
+        QVERIFY(sameBits(read.rpm, trace.rpm));
+        QVERIFY(sameBits(read.fuelFlow, trace.fuelFlow));
+
+        // Appending goes on right after the repaired tail
+        const TelemetrySample next { trace.timestamps.back() + 20, 1600.0, 16.0 };
+        QVERIFY(log.append(&next, 1));
+        QCOMPARE(log.sampleCount(), qint64(trace.size() + 1));
+        QCOMPARE(log.timestampAt(trace.size()), next.timestampMs);
+    }
+}
+
+void SampleCodecTest::logReopensAfterCrashDuringTailRewrite()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    const QDir dir(directory.path());
+    const QStringList columns { "rpm.col", "fuelflow.col" };
+    const Trace trace = smoothTrace(SampleLog::BLOCK_SAMPLES + 3);
+    const int from = SampleLog::BLOCK_SAMPLES - 1;
+
+    {
+        SampleLog log(directory.path());
+        QVERIFY(log.open());
+        QVERIFY(appendTrace(log, trace, 0, from));
+        QVERIFY(log.flush());
+    }
+    for (const QString &column : columns)
+        QVERIFY(QFile::copy(dir.filePath(column), dir.filePath(column + ".saved")));
+
+    {
+        SampleLog log(directory.path());
+        QVERIFY(log.open());
+        QVERIFY(appendTrace(log, trace, from, trace.size()));
+        QCOMPARE(log.blocks().size(), 1);
+        QVERIFY(log.flush());
+    }
+
+    // Crash after the compacted timestamps replaced their column, before
+    // the others did: those still hold everything from sample 0
+    const qint64 bytes = (trace.size() - from) * qint64(sizeof(double));
+    for (const QString &column : columns) {
+        QVERIFY(QFile::remove(dir.filePath(column)));
+        QVERIFY(QFile::rename(dir.filePath(column + ".saved"), dir.filePath(column)));
+    }
+    QVERIFY(appendRaw(dir.filePath("rpm.col"), trace.rpm.data() + from, bytes));
+    QVERIFY(appendRaw(dir.filePath("fuelflow.col"), trace.fuelFlow.data() + from, bytes));
+
+    // Readers leave the repair to the writer
+    {
+        SampleLog reader(directory.path());
+        QVERIFY(reader.open(SampleLog::ReadOnly));
+        QCOMPARE(reader.sampleCount(), qint64(SampleLog::BLOCK_SAMPLES));
+    }
+
+    SampleLog log(directory.path());
+    QVERIFY(log.open());
+    QCOMPARE(log.blocks().size(), 1);
+    QCOMPARE(log.sampleCount(), qint64(trace.size()));
+    const Trace read = readLog(log);
+    QVERIFY(read.timestamps == trace.timestamps);
+    QVERIFY(sameBits(read.rpm, trace.rpm));
+    QVERIFY(sameBits(read.fuelFlow, trace.fuelFlow));
+}
+
+void SampleCodecTest::logIgnoresTornWrites()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    const QDir dir(directory.path());
+    const Trace trace = smoothTrace(2 * SampleLog::BLOCK_SAMPLES);
+
+    {
+        SampleLog log(directory.path());
+        QVERIFY(log.open());
+        QVERIFY(appendTrace(log, trace, 0, trace.size()));
+        QCOMPARE(log.blocks().size(), 2);
+        QVERIFY(log.flush());
+    }
+
+    // The second block was torn; only the first one survives
+    QFile archive(dir.filePath("archive.blk"));
+    QVERIFY(archive.resize(archive.size() - 8));
+
+    {
+        SampleLog reader(directory.path());
+        QVERIFY(reader.open(SampleLog::ReadOnly));
+        QCOMPARE(reader.sampleCount(), qint64(SampleLog::BLOCK_SAMPLES));
+    }
+
+    SampleLog log(directory.path());
+    QVERIFY(log.open());
+    QCOMPARE(log.blocks().size(), 1);
+    QCOMPARE(log.sampleCount(), qint64(SampleLog::BLOCK_SAMPLES));
+    const Trace read = readLog(log);
+    QVERIFY(std::equal(read.timestamps.begin(), read.timestamps.end(), trace.timestamps.begin()));
+
+    // The cut-off archive is appended to again
+    QVERIFY(appendTrace(log, trace, SampleLog::BLOCK_SAMPLES, trace.size()));
+    QCOMPARE(log.blocks().size(), 2);
+    QVERIFY(readLog(log).timestamps == trace.timestamps);
+}
+
+QTEST_MAIN(SampleCodecTest)
+
+#include "tst_samplecodec.moc"
@@ -0,0 +1,124 @@
+#include <QTemporaryDir>
+#include <QTest>
+#include <QThread>
+#include <vector>
+#include "chartdatamodel.h"
+#include "samplelog.h"
+#include "tripreplay.h"
+#include "vesselmodel.h"
+
+class TripReplayTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void seekKeepsFeedingTheModel();
+    void stalledGuiLosesNoSamples();
+};
+
+namespace {
+
+// Samples learned into the selected window
+qint64 learnedSamples(const ChartDataModel &model)
+{
+    qint64 total = 0;
+    for (const QList<quint32> &row : model.density().rows) {
+        for (quint32 count : row)
+            total += count;
+    }
+    return total;
+}
+
+} // namespace
+
+void TripReplayTest::seekKeepsFeedingTheModel()
+{
+    // A minute at 50 Hz whose RPM tells the trip time: 2000 + 50 per second
+    constexpr qint64 startMs = 1700000000000;
+    constexpr int count = 60 * 50;
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    {
+        std::vector<TelemetrySample> samples(count);
+        for (int i = 0; i < count; ++i)
+            samples[i] = { startMs + i * 20, 2000.0 + i * 20 * 0.05, 20.0 };
+        SampleLog log(directory.path());
+        QVERIFY(log.open());
+        QVERIFY(log.append(samples.data(), count));
+        QVERIFY(log.flush());
+    }
+
+    // Declared before the vessel, whose statistics thread uses it
+    SampleLog replayLog(directory.path());
+    QVERIFY(replayLog.open(SampleLog::ReadOnly));
+
+    VesselModel vessel(1);
+    ChartDataModel *model = vessel.engine(0);
+    model->generateSampleData();
+    model->attachReplay(&replayLog);
+
+    TripReplay replay(&vessel, { directory.path() });
+    replay.play();
+    QTRY_VERIFY(model->currentRpm() >= 2000.0 && model->currentRpm() < 2500.0);
+
+    // Half a minute in; playback has to go on from there rather than stall
+    replay.seek(double(startMs + 30000));
+    QTRY_VERIFY_WITH_TIMEOUT(model->currentRpm() >= 3500.0, 3000);
+    const double rpm = model->currentRpm();
+    QTRY_VERIFY_WITH_TIMEOUT(model->currentRpm() > rpm, 3000);
+
+    // Playing a finished trip starts it over, through the same seek
+    replay.seek(double(startMs + 60000));
+    replay.pause();
+    replay.play();
+    QTRY_VERIFY_WITH_TIMEOUT(model->currentRpm() < 2500.0, 3000);
+    const double restartRpm = model->currentRpm();
+    QTRY_VERIFY_WITH_TIMEOUT(model->currentRpm() > restartRpm, 3000);
+}
+
+void TripReplayTest::stalledGuiLosesNoSamples()
+{
+    // Six and a half minutes at 50 Hz, four seconds at 100x
+    constexpr qint64 startMs = 1700000000000;
+    constexpr int count = 390 * 50;
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    {
+        std::vector<TelemetrySample> samples(count);
+        for (int i = 0; i < count; ++i)
+            samples[i] = { startMs + i * 20, 1000.0 + (i % 4000), 20.0 };
+        SampleLog log(directory.path());
+        QVERIFY(log.open());
+        QVERIFY(log.append(samples.data(), count));
+        QVERIFY(log.flush());
+    }
+
+    SampleLog replayLog(directory.path());
+    QVERIFY(replayLog.open(SampleLog::ReadOnly));
+
+    VesselModel vessel(1);
+    ChartDataModel *model = vessel.engine(0);
+    model->generateSampleData();
+    model->attachReplay(&replayLog);
+
+    TripReplay replay(&vessel, { directory.path() });
+    replay.setSpeed(TripReplay::MAX_SPEED);
+    replay.play();
+
+    // Nothing drains the rings meanwhile; two seconds at 100x are more than
+    // twice what a ring holds
+    QThread::msleep(2000);
+    QTRY_VERIFY_WITH_TIMEOUT(!replay.isPlaying(), 10000);
+    model->waitForStatistics();
+    QCOMPARE(learnedSamples(*model), qint64(count));
+
+    // The replay position has to match the log, or the seek would count
+    // part of it twice
+    model->seekReplay(count);
+    model->waitForStatistics();
+    QCOMPARE(learnedSamples(*model), qint64(count));
+}
+
+QTEST_MAIN(TripReplayTest)
+
+#include "tst_tripreplay.moc"
@@ -0,0 +1,76 @@
+#include <QTest>
+#include <vector>
+#include "chartdatamodel.h"
+#include "vesselmodel.h"
+
+class VesselModelTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void windowSwitchUpdatesTotalEcoMode();
+    void economyCoversWholeVessel();
+};
+
+void VesselModelTest::windowSwitchUpdatesTotalEcoMode()
+{
+    VesselModel vessel(1);
+    ChartDataModel *model = vessel.engine(0);
+    model->generateSampleData();
+
+    // Two days ago the engine burnt 40 L/h at 3000 RPM, in the last hour
+    // only 10. The current reading of 25 L/h is economical against the
+    // all-time median only.
+    constexpr qint64 nowMs = 1700000000000;
+    constexpr qint64 twoDaysMs = 2 * 24 * 3600 * 1000LL;
+    std::vector<TelemetrySample> samples;
+    for (int i = 0; i < 300; ++i)
+        samples.push_back({ nowMs - twoDaysMs + i * 20, 3000.0, 40.0 });
+    for (int i = 0; i < 100; ++i)
+        samples.push_back({ nowMs - 60000 + i * 20, 3000.0, 10.0 });
+    samples.push_back({ nowMs, 3000.0, 25.0 });
+    model->ingestSamples(samples.data(), int(samples.size()));
+    model->waitForStatistics();
+
+    QCOMPARE(model->statisticsWindow(), int(AllTimeWindow));
+    QVERIFY(model->isEcoMode());
+    QVERIFY(vessel.isTotalEcoMode());
+
+    // The reading stays the same; only the medians it is judged by change
+    model->setStatisticsWindow(LastHourWindow);
+    QVERIFY(!model->isEcoMode());
+    QVERIFY(!vessel.isTotalEcoMode());
+
+    model->setStatisticsWindow(AllTimeWindow);
+    QVERIFY(vessel.isTotalEcoMode());
+}
+
+void VesselModelTest::economyCoversWholeVessel()
+{
+    VesselModel vessel(2);
+    for (ChartDataModel *model : vessel.engines()) {
+        model->generateSampleData();
+
+        std::vector<TelemetrySample> samples;
+        for (int i = 0; i < 100; ++i)
+            samples.push_back({ 1700000000000 + i * 20, 3000.0, 20.0, 10.0 });
+        model->ingestSamples(samples.data(), int(samples.size()));
+        model->waitForStatistics();
+    }
+
+    // Both engines' fuel over the boat's speed, with the range on the
+    // whole tank while each engine keeps its share
+    vessel.setRemainingFuel(400.0);
+    QCOMPARE(vessel.engine(0)->remainingFuel(), 200.0);
+    QCOMPARE(vessel.engine(1)->remainingFuel(), 200.0);
+    QCOMPARE(vessel.fuelPerNauticalMile(), 4.0);
+    QCOMPARE(vessel.range(), 100.0);
+
+    QVERIFY(vessel.optimalRpm() > 0.0);
+    QVERIFY(vessel.optimalFuelPerNauticalMile() > 0.0);
+    QCOMPARE(vessel.optimalRange(), 400.0 / vessel.optimalFuelPerNauticalMile());
+}
+
+QTEST_MAIN(VesselModelTest)
+
+#include "tst_vesselmodel.moc"